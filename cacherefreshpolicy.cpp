@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "cacherefreshpolicy.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSettings>
+
+CacheRefreshPolicy::CacheRefreshPolicy()
+{
+
+}
+
+void CacheRefreshPolicy::load(QSettings &settings)
+{
+    settings.beginGroup("CacheRefresh");
+    m_minimumInterval = qMax<qint64>(60, settings.value("minimumInterval", m_minimumInterval).toLongLong());
+    m_maximumInterval = qMax(m_minimumInterval, settings.value("maximumInterval", m_maximumInterval).toLongLong());
+    m_interval = qBound(m_minimumInterval, settings.value("interval", m_interval).toLongLong(), m_maximumInterval);
+    m_maximumMetadataAge = settings.value("maximumMetadataAge", m_maximumMetadataAge).toLongLong();
+    m_retryInterval = qMax<qint64>(10, settings.value("retryInterval", m_retryInterval).toLongLong());
+    m_jitter = qBound(0.0, settings.value("jitter", m_jitter).toDouble(), 0.5);
+    m_listsDirectory = settings.value("listsDirectory", m_listsDirectory).toString();
+    settings.endGroup();
+}
+
+QString CacheRefreshPolicy::listsDirectory() const
+{
+    return m_listsDirectory;
+}
+
+QDateTime CacheRefreshPolicy::metadataTimestamp() const
+{
+    // apt renames freshly downloaded lists into the lists directory, which updates its mtime.
+    // Lists which didn't change on the server are not touched, so also consider our last refresh.
+    QDateTime timestamp = QFileInfo(m_listsDirectory).lastModified();
+    if (m_lastSuccess.isValid() && (!timestamp.isValid() || m_lastSuccess > timestamp)) {
+        timestamp = m_lastSuccess;
+    }
+    return timestamp;
+}
+
+qint64 CacheRefreshPolicy::metadataAge() const
+{
+    QDateTime timestamp = metadataTimestamp();
+    if (!timestamp.isValid()) {
+        return -1;
+    }
+    return timestamp.secsTo(QDateTime::currentDateTime());
+}
+
+bool CacheRefreshPolicy::forceRefresh() const
+{
+    qint64 age = metadataAge();
+    return age < 0 || age > m_maximumMetadataAge;
+}
+
+qint64 CacheRefreshPolicy::interval() const
+{
+    return m_interval;
+}
+
+qint64 CacheRefreshPolicy::nextDelay() const
+{
+    if (m_failures > 0) {
+        // 5 min, 10 min, 20 min... but never later than a regular refresh
+        qint64 backoff = m_retryInterval << qMin(m_failures - 1, 16);
+        return qMin(backoff, m_interval) * 1000;
+    }
+    return static_cast<qint64>(m_interval * (1.0 + m_jitter * deviceJitterFactor())) * 1000;
+}
+
+void CacheRefreshPolicy::refreshSucceeded(bool newUpdates)
+{
+    m_failures = 0;
+    m_lastSuccess = QDateTime::currentDateTime();
+    if (newUpdates) {
+        m_interval = qMax(m_minimumInterval, m_interval / 2);
+    } else {
+        m_interval = qMin(m_maximumInterval, m_interval * 3 / 2);
+    }
+}
+
+void CacheRefreshPolicy::refreshFailed()
+{
+    m_failures++;
+}
+
+double CacheRefreshPolicy::deviceJitterFactor()
+{
+    // A stable value in [-1, 1] per device
+    static double factor = 2;
+    if (factor > 1) {
+        QFile machineIdFile("/etc/machine-id");
+        QByteArray machineId;
+        if (machineIdFile.open(QFile::ReadOnly)) {
+            machineId = machineIdFile.readAll().trimmed();
+        }
+        factor = machineId.isEmpty() ? 0 : (qHash(machineId) % 2001) / 1000.0 - 1;
+    }
+    return factor;
+}
@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef CACHEREFRESHPOLICY_H
+#define CACHEREFRESHPOLICY_H
+
+#include <QDateTime>
+#include <QString>
+
+class QSettings;
+
+// Decides when and how the package metadata is refreshed.
+//
+// The interval adapts to how often updates show up: it shrinks after a refresh brought in new updates
+// and grows while nothing changes, within the configured bounds. Failed refreshes are retried with
+// exponential backoff. Each device gets a stable offset within the jitter range, so devices which
+// booted at the same time don't hit the mirrors at the same time. A forced (full re-download)
+// refresh is only requested once the metadata is older than the configured maximum age.
+class CacheRefreshPolicy
+{
+public:
+    CacheRefreshPolicy();
+
+    void load(QSettings &settings);
+
+    QString listsDirectory() const;
+    QDateTime metadataTimestamp() const;
+    qint64 metadataAge() const; // seconds, -1 if unknown
+    bool forceRefresh() const;
+
+    qint64 interval() const; // seconds, without jitter and backoff
+    qint64 nextDelay() const; // ms until the next refresh should run
+
+    void refreshSucceeded(bool newUpdates);
+    void refreshFailed();
+
+private:
+    static double deviceJitterFactor();
+
+    QString m_listsDirectory = "/var/lib/apt/lists";
+
+    qint64 m_minimumInterval = 60 * 60;
+    qint64 m_maximumInterval = 24 * 60 * 60;
+    qint64 m_interval = 6 * 60 * 60;
+    qint64 m_maximumMetadataAge = 24 * 60 * 60;
+    qint64 m_retryInterval = 5 * 60;
+    double m_jitter = 0.1;
+
+    QDateTime m_lastSuccess;
+    int m_failures = 0;
+};
+
+#endif // CACHEREFRESHPOLICY_H
@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "debcontrolreader.h"
+
+#include <cstring>
+
+DebControlReader::DebControlReader(const QString &fileName):
+    m_file(fileName)
+{
+
+}
+
+bool DebControlReader::open()
+{
+    if (!m_file.open(QFile::ReadOnly)) {
+        return false;
+    }
+    m_size = m_file.size();
+    if (m_size == 0) {
+        return true;
+    }
+    uchar *data = m_file.map(0, m_size);
+    if (data) {
+        m_data = reinterpret_cast<const char*>(data);
+    } else {
+        // Not mappable, e.g. on some special file systems
+        m_buffer = m_file.readAll();
+        m_data = m_buffer.constData();
+        m_size = m_buffer.size();
+    }
+    return true;
+}
+
+QString DebControlReader::errorString() const
+{
+    return m_file.errorString();
+}
+
+bool DebControlReader::readStanza()
+{
+    // Skip blank lines between stanzas
+    while (m_position < m_size && m_data[m_position] == '\n') {
+        m_position++;
+    }
+    if (m_position >= m_size) {
+        m_stanza = nullptr;
+        m_stanzaLength = 0;
+        return false;
+    }
+
+    const char *start = m_data + m_position;
+    qint64 end = m_position;
+    while (end < m_size) {
+        const char *newline = static_cast<const char*>(memchr(m_data + end, '\n', m_size - end));
+        if (!newline) {
+            end = m_size;
+            break;
+        }
+        end = newline - m_data + 1;
+        if (end >= m_size || m_data[end] == '\n') {
+            // Exclude the newline ending the last line
+            end--;
+            break;
+        }
+    }
+    m_stanza = start;
+    m_stanzaLength = static_cast<int>(m_data + end - start);
+    m_position = end;
+    return true;
+}
+
+QByteArray DebControlReader::stanza() const
+{
+    return QByteArray::fromRawData(m_stanza, m_stanzaLength);
+}
+
+QByteArray DebControlReader::value(const char *field) const
+{
+    const int fieldLength = static_cast<int>(strlen(field));
+    const char *line = m_stanza;
+    const char *end = m_stanza + m_stanzaLength;
+    while (line && line < end) {
+        const char *lineEnd = static_cast<const char*>(memchr(line, '\n', end - line));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+        if (lineEnd - line > fieldLength && line[fieldLength] == ':' && strncmp(line, field, fieldLength) == 0) {
+            return QByteArray(line + fieldLength + 1, static_cast<int>(lineEnd - line - fieldLength - 1)).trimmed();
+        }
+        line = lineEnd + 1;
+    }
+    return QByteArray();
+}
@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef DEBCONTROLREADER_H
+#define DEBCONTROLREADER_H
+
+#include <QByteArray>
+#include <QFile>
+
+// Sequential reader for Debian control files such as /var/lib/dpkg/status or the apt Packages lists.
+//
+// The file is memory mapped and stanzas are handed out as views on the mapping, so scanning a
+// status file of a few MB doesn't copy it. Views are only valid while the reader exists.
+class DebControlReader
+{
+public:
+    explicit DebControlReader(const QString &fileName);
+
+    bool open();
+    QString errorString() const;
+
+    // Advances to the next stanza. Returns false at the end of the file.
+    bool readStanza();
+
+    // The raw text of the current stanza, without the separating blank line
+    QByteArray stanza() const;
+    // The value of a field of the current stanza (first line only, trimmed), empty if not present
+    QByteArray value(const char *field) const;
+
+private:
+    QFile m_file;
+    QByteArray m_buffer;
+    const char *m_data = nullptr;
+    qint64 m_size = 0;
+    qint64 m_position = 0;
+
+    const char *m_stanza = nullptr;
+    int m_stanzaLength = 0;
+};
+
+#endif // DEBCONTROLREADER_H
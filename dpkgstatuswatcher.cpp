@@ -0,0 +1,230 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "dpkgstatuswatcher.h"
+#include "debcontrolreader.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QTimer>
+
+#include "loggingcategories.h"
+
+DpkgStatusWatcher::DpkgStatusWatcher(const QString &statusFileName, const QString &listsDirectory, QObject *parent):
+    QObject(parent),
+    m_statusFileName(statusFileName),
+    m_listsDirectory(listsDirectory)
+{
+    m_watcher = new QFileSystemWatcher(this);
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged, this, &DpkgStatusWatcher::onDirectoryChanged);
+
+    // dpkg and apt touch these many times per run. Wait for them to settle.
+    m_statusTimer = new QTimer(this);
+    m_statusTimer->setSingleShot(true);
+    m_statusTimer->setInterval(2000);
+    connect(m_statusTimer, &QTimer::timeout, this, &DpkgStatusWatcher::scanStatus);
+
+    m_listsTimer = new QTimer(this);
+    m_listsTimer->setSingleShot(true);
+    m_listsTimer->setInterval(2000);
+    connect(m_listsTimer, &QTimer::timeout, this, &DpkgStatusWatcher::scanLists);
+}
+
+void DpkgStatusWatcher::setFilter(const PackageNameFilter &filter)
+{
+    m_filter = filter;
+}
+
+bool DpkgStatusWatcher::start()
+{
+    QString statusDirectory = QFileInfo(m_statusFileName).absolutePath();
+    if (!m_watcher->addPath(statusDirectory)) {
+        qCWarning(dcPlatformUpdate()) << "Cannot watch" << statusDirectory << "for package changes";
+        return false;
+    }
+    if (!m_watcher->addPath(m_listsDirectory)) {
+        qCWarning(dcPlatformUpdate()) << "Cannot watch" << m_listsDirectory << "for package list changes";
+    }
+
+    bool ok;
+    m_stanzaHashes = readStatus(&ok);
+    QFileInfo statusInfo(m_statusFileName);
+    m_statusModified = statusInfo.lastModified();
+    m_statusSize = statusInfo.size();
+    m_listsState = readListsState();
+    qCDebug(dcPlatformUpdate()) << "Watching" << m_statusFileName << "with" << m_stanzaHashes.count() << "managed packages";
+    return ok;
+}
+
+bool DpkgStatusWatcher::suspended() const
+{
+    return m_suspended;
+}
+
+void DpkgStatusWatcher::setSuspended(bool suspended)
+{
+    if (m_suspended == suspended) {
+        return;
+    }
+    m_suspended = suspended;
+    m_statusTimer->stop();
+    m_listsTimer->stop();
+    if (suspended) {
+        qCDebug(dcPlatformUpdate()) << "Ignoring changes of" << m_statusFileName;
+        return;
+    }
+
+    bool ok;
+    QHash<QString, uint> stanzaHashes = readStatus(&ok);
+    if (ok) {
+        m_stanzaHashes.swap(stanzaHashes);
+    }
+    QFileInfo statusInfo(m_statusFileName);
+    m_statusModified = statusInfo.lastModified();
+    m_statusSize = statusInfo.size();
+    m_listsState = readListsState();
+    qCDebug(dcPlatformUpdate()) << "Watching" << m_statusFileName << "again";
+}
+
+void DpkgStatusWatcher::suspendLists()
+{
+    if (m_listsSuspensions++ == 0) {
+        m_listsTimer->stop();
+    }
+}
+
+void DpkgStatusWatcher::resumeLists()
+{
+    if (m_listsSuspensions == 0 || --m_listsSuspensions > 0) {
+        return;
+    }
+    // Events of the refresh might still be queued. They're compared against this state and dropped.
+    m_listsState = readListsState();
+}
+
+bool DpkgStatusWatcher::statusUnchanged() const
+{
+    bool ok;
+    QHash<QString, uint> stanzaHashes = readStatus(&ok);
+    return ok && stanzaHashes == m_stanzaHashes;
+}
+
+void DpkgStatusWatcher::onDirectoryChanged(const QString &path)
+{
+    if (m_suspended) {
+        return;
+    }
+    if (path == m_listsDirectory) {
+        if (m_listsSuspensions == 0) {
+            m_listsTimer->start();
+        }
+        return;
+    }
+
+    // Lock and journal files in the dpkg directory change all the time
+    QFileInfo statusInfo(m_statusFileName);
+    if (statusInfo.lastModified() == m_statusModified && statusInfo.size() == m_statusSize) {
+        return;
+    }
+    m_statusTimer->start();
+}
+
+void DpkgStatusWatcher::scanStatus()
+{
+    QFileInfo statusInfo(m_statusFileName);
+    m_statusModified = statusInfo.lastModified();
+    m_statusSize = statusInfo.size();
+
+    bool ok;
+    QHash<QString, uint> stanzaHashes = readStatus(&ok);
+    if (!ok) {
+        return;
+    }
+
+    QStringList changed;
+    for (QHash<QString, uint>::const_iterator it = stanzaHashes.constBegin(); it != stanzaHashes.constEnd(); ++it) {
+        QHash<QString, uint>::const_iterator previous = m_stanzaHashes.constFind(it.key());
+        if (previous == m_stanzaHashes.constEnd() || previous.value() != it.value()) {
+            changed.append(it.key());
+        }
+    }
+    for (QHash<QString, uint>::const_iterator it = m_stanzaHashes.constBegin(); it != m_stanzaHashes.constEnd(); ++it) {
+        if (!stanzaHashes.contains(it.key())) {
+            changed.append(it.key());
+        }
+    }
+    m_stanzaHashes.swap(stanzaHashes);
+
+    if (!changed.isEmpty()) {
+        qCDebug(dcPlatformUpdate()) << "dpkg status changed for" << changed;
+        emit packagesChanged(changed);
+    }
+}
+
+void DpkgStatusWatcher::scanLists()
+{
+    uint listsState = readListsState();
+    if (listsState == m_listsState) {
+        return;
+    }
+    m_listsState = listsState;
+    qCDebug(dcPlatformUpdate()) << "Package lists in" << m_listsDirectory << "changed";
+    emit listsChanged();
+}
+
+QHash<QString, uint> DpkgStatusWatcher::readStatus(bool *ok) const
+{
+    QHash<QString, uint> stanzaHashes;
+    DebControlReader reader(m_statusFileName);
+    if (!reader.open()) {
+        qCWarning(dcPlatformUpdate()) << "Cannot read" << m_statusFileName << reader.errorString();
+        *ok = false;
+        return stanzaHashes;
+    }
+    while (reader.readStanza()) {
+        QByteArray name = reader.value("Package");
+        // Package names are plain ASCII
+        QString packageName = QString::fromLatin1(name);
+        if (!m_filter.matches(packageName)) {
+            continue;
+        }
+        // A package can have a stanza per architecture
+        uint hash = qHash(reader.stanza());
+        stanzaHashes[packageName] ^= hash;
+    }
+    *ok = true;
+    return stanzaHashes;
+}
+
+uint DpkgStatusWatcher::readListsState() const
+{
+    // apt replaces the index files, names, sizes and modification times are enough to notice that
+    uint state = 0;
+    foreach (const QFileInfo &info, QDir(m_listsDirectory).entryInfoList(QDir::Files)) {
+        state += qHash(info.fileName()) ^ qHash(info.size()) ^ qHash(info.lastModified().toMSecsSinceEpoch());
+    }
+    return state;
+}
@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef DPKGSTATUSWATCHER_H
+#define DPKGSTATUSWATCHER_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+
+#include "packagenamefilter.h"
+
+class QFileSystemWatcher;
+class QTimer;
+
+// Watches the dpkg status file and the apt lists directory for changes made outside of PackageKit.
+//
+// dpkg replaces the status file on every change, so the directory is watched and the file is
+// only rescanned if it actually changed. A hash of every managed package's stanza is kept to tell
+// exactly which packages changed. Changes of the lists affect candidates of arbitrary packages
+// and are only reported as a whole, and only if a file in the directory actually differs from
+// the last known state.
+class DpkgStatusWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DpkgStatusWatcher(const QString &statusFileName, const QString &listsDirectory, QObject *parent = nullptr);
+
+    void setFilter(const PackageNameFilter &filter);
+    bool start();
+
+    // While suspended, changes are ignored. Resuming takes the current status as the new baseline
+    // without reporting anything, e.g. after our own updates, which refresh the packages themselves.
+    bool suspended() const;
+    void setSuspended(bool suspended);
+
+    // Ignores changes of the lists while our own cache refreshes run. Calls nest, the state after the
+    // last resumeLists() is the new baseline.
+    void suspendLists();
+    void resumeLists();
+
+    // True if the managed packages in the status file are still as of the last scan
+    bool statusUnchanged() const;
+
+signals:
+    void packagesChanged(const QStringList &packageNames);
+    void listsChanged();
+
+private slots:
+    void onDirectoryChanged(const QString &path);
+    void scanStatus();
+    void scanLists();
+
+private:
+    QHash<QString, uint> readStatus(bool *ok) const;
+    uint readListsState() const;
+
+    QString m_statusFileName;
+    QString m_listsDirectory;
+    PackageNameFilter m_filter;
+
+    QFileSystemWatcher *m_watcher = nullptr;
+    QTimer *m_statusTimer = nullptr;
+    QTimer *m_listsTimer = nullptr;
+    bool m_suspended = false;
+    int m_listsSuspensions = 0;
+
+    QDateTime m_statusModified;
+    qint64 m_statusSize = -1;
+    QHash<QString, uint> m_stanzaHashes; // <packageName, hash>
+    uint m_listsState = 0;
+};
+
+#endif // DPKGSTATUSWATCHER_H
@@ -0,0 +1,289 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "nativepackagereader.h"
+#include "debcontrolreader.h"
+
+#include <QDir>
+#include <QProcess>
+
+#include <cstring>
+
+#include "loggingcategories.h"
+
+namespace {
+
+// Ordering of non-digit characters in dpkg: '~' sorts before everything, even the end of the string,
+// letters sort before all other characters.
+int order(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return 0;
+    } else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+        return c;
+    } else if (c == '~') {
+        return -1;
+    } else if (c) {
+        return c + 256;
+    }
+    return 0;
+}
+
+bool isDigit(const char *p, const char *end)
+{
+    return p < end && *p >= '0' && *p <= '9';
+}
+
+// Compares alternating non-digit and digit parts, see deb-version(7)
+int compareParts(const char *a, const char *aEnd, const char *b, const char *bEnd)
+{
+    while (a < aEnd || b < bEnd) {
+        while ((a < aEnd && !isDigit(a, aEnd)) || (b < bEnd && !isDigit(b, bEnd))) {
+            int ac = a < aEnd ? order(*a) : 0;
+            int bc = b < bEnd ? order(*b) : 0;
+            if (ac != bc) {
+                return ac - bc;
+            }
+            a++;
+            b++;
+        }
+        while (a < aEnd && *a == '0') {
+            a++;
+        }
+        while (b < bEnd && *b == '0') {
+            b++;
+        }
+        int firstDiff = 0;
+        while (isDigit(a, aEnd) && isDigit(b, bEnd)) {
+            if (!firstDiff) {
+                firstDiff = *a - *b;
+            }
+            a++;
+            b++;
+        }
+        if (isDigit(a, aEnd)) {
+            return 1;
+        }
+        if (isDigit(b, bEnd)) {
+            return -1;
+        }
+        if (firstDiff) {
+            return firstDiff;
+        }
+    }
+    return 0;
+}
+
+class Version {
+public:
+    explicit Version(const QByteArray &version) {
+        const char *begin = version.constData();
+        const char *end = begin + version.size();
+        upstream = begin;
+        const char *colon = static_cast<const char*>(memchr(begin, ':', version.size()));
+        if (colon) {
+            epoch = QByteArray::fromRawData(begin, static_cast<int>(colon - begin)).toLong();
+            upstream = colon + 1;
+        }
+        upstreamEnd = end;
+        revision = end;
+        for (const char *p = end; p > upstream; p--) {
+            if (p[-1] == '-') {
+                upstreamEnd = p - 1;
+                revision = p;
+                break;
+            }
+        }
+        revisionEnd = end;
+    }
+
+    long epoch = 0;
+    const char *upstream = nullptr;
+    const char *upstreamEnd = nullptr;
+    const char *revision = nullptr;
+    const char *revisionEnd = nullptr;
+};
+
+bool isDevelopmentPackage(const QString &packageName, const QByteArray &section)
+{
+    // Matches what PackageKit's not-devel filter excludes, by name and by section. The section may have
+    // an archive area prefix, e.g. "contrib/devel".
+    if (packageName.endsWith("-dev") || packageName.endsWith("-dbg") || packageName.endsWith("-dbgsym")) {
+        return true;
+    }
+    QByteArray name = section.mid(section.lastIndexOf('/') + 1);
+    return name == "devel" || name == "libdevel";
+}
+
+}
+
+NativePackageReader::NativePackageReader(const QString &statusFileName, const QString &listsDirectory):
+    m_statusFileName(statusFileName),
+    m_listsDirectory(listsDirectory)
+{
+
+}
+
+void NativePackageReader::setFilter(const PackageNameFilter &filter)
+{
+    m_filter = filter;
+}
+
+bool NativePackageReader::read(QHash<QString, Package> *packages, PackageStringPool *pool)
+{
+    QHash<QString, Entry> entries;
+    if (!readStatus(&entries)) {
+        return false;
+    }
+
+    QDir lists(m_listsDirectory);
+    foreach (const QString &fileName, lists.entryList({"*_Packages"}, QDir::Files)) {
+        readList(lists.absoluteFilePath(fileName), &entries);
+    }
+
+    for (QHash<QString, Entry>::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        const Entry &entry = it.value();
+        QString packageName = pool->intern(it.key());
+        Package package(packageName, packageName);
+        package.setSummary(QString::fromUtf8(entry.summary));
+        if (!entry.installedVersion.isEmpty()) {
+            package.setInstalledVersion(pool->intern(QString::fromLatin1(entry.installedVersion)));
+            package.setCanRemove(true);
+        }
+        if (!entry.candidateVersion.isEmpty() && (entry.installedVersion.isEmpty() || compareVersions(entry.candidateVersion, entry.installedVersion) > 0)) {
+            package.setCandidateVersion(pool->intern(QString::fromLatin1(entry.candidateVersion)));
+            package.setUpdateAvailable(!entry.installedVersion.isEmpty());
+        } else {
+            package.setCandidateVersion(package.installedVersion());
+        }
+        packages->insert(packageName, package);
+    }
+    return true;
+}
+
+QString NativePackageReader::errorString() const
+{
+    return m_errorString;
+}
+
+int NativePackageReader::compareVersions(const QByteArray &a, const QByteArray &b)
+{
+    Version versionA(a);
+    Version versionB(b);
+    if (versionA.epoch != versionB.epoch) {
+        return versionA.epoch < versionB.epoch ? -1 : 1;
+    }
+    int result = compareParts(versionA.upstream, versionA.upstreamEnd, versionB.upstream, versionB.upstreamEnd);
+    if (result != 0) {
+        return result;
+    }
+    return compareParts(versionA.revision, versionA.revisionEnd, versionB.revision, versionB.revisionEnd);
+}
+
+bool NativePackageReader::isManaged(const QString &packageName, const QByteArray &section) const
+{
+    return m_filter.matches(packageName) && !isDevelopmentPackage(packageName, section);
+}
+
+QByteArray NativePackageReader::readNativeArch() const
+{
+    // dpkg always has the native architecture. The status file is sorted by name, so this doesn't read far.
+    DebControlReader reader(m_statusFileName);
+    if (reader.open()) {
+        while (reader.readStanza()) {
+            if (reader.value("Package") == "dpkg") {
+                return reader.value("Architecture");
+            }
+        }
+    }
+    QProcess dpkg;
+    dpkg.start("dpkg", {"--print-architecture"});
+    if (dpkg.waitForFinished(1000) && dpkg.exitStatus() == QProcess::NormalExit && dpkg.exitCode() == 0) {
+        return dpkg.readAllStandardOutput().trimmed();
+    }
+    return QByteArray();
+}
+
+bool NativePackageReader::readStatus(QHash<QString, Entry> *entries)
+{
+    DebControlReader reader(m_statusFileName);
+    if (!reader.open()) {
+        m_errorString = reader.errorString();
+        return false;
+    }
+    // Needed before the first package, a foreign one may come before the native one
+    m_nativeArch = readNativeArch();
+    if (m_nativeArch.isEmpty()) {
+        qCWarning(dcPlatformUpdate()) << "Cannot determine the native architecture from" << m_statusFileName << "or dpkg - considering candidates of all architectures";
+    }
+    while (reader.readStanza()) {
+        QString packageName = QString::fromLatin1(reader.value("Package"));
+        if (!isManaged(packageName, reader.value("Section"))) {
+            continue;
+        }
+        // "want flag status", we only care about installed ones
+        if (!reader.value("Status").endsWith(" installed")) {
+            continue;
+        }
+        // With multiarch a package can be installed for several architectures. Prefer the native one.
+        QByteArray arch = reader.value("Architecture");
+        QHash<QString, Entry>::iterator it = entries->find(packageName);
+        if (it != entries->end() && (m_nativeArch.isEmpty() || it->installedArch == m_nativeArch || it->installedArch == "all")) {
+            continue;
+        }
+        Entry &entry = (*entries)[packageName];
+        entry.installedVersion = reader.value("Version");
+        entry.installedArch = arch;
+        entry.summary = reader.value("Description");
+    }
+    return true;
+}
+
+void NativePackageReader::readList(const QString &fileName, QHash<QString, Entry> *entries)
+{
+    DebControlReader reader(fileName);
+    if (!reader.open()) {
+        qCWarning(dcPlatformUpdate()) << "Cannot read" << fileName << reader.errorString();
+        return;
+    }
+    while (reader.readStanza()) {
+        QString packageName = QString::fromLatin1(reader.value("Package"));
+        if (!isManaged(packageName, reader.value("Section"))) {
+            continue;
+        }
+        QByteArray arch = reader.value("Architecture");
+        if (!m_nativeArch.isEmpty() && arch != m_nativeArch && arch != "all") {
+            continue;
+        }
+        QByteArray version = reader.value("Version");
+        Entry &entry = (*entries)[packageName];
+        if (entry.candidateVersion.isEmpty() || compareVersions(version, entry.candidateVersion) > 0) {
+            entry.candidateVersion = version;
+            if (entry.installedVersion.isEmpty()) {
+                entry.summary = reader.value("Description");
+            }
+        }
+    }
+}
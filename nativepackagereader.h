@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef NATIVEPACKAGEREADER_H
+#define NATIVEPACKAGEREADER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+#include "packagenamefilter.h"
+#include "packageid.h"
+
+#include "platform/package.h"
+
+// Builds the read-only package view straight from /var/lib/dpkg/status and the apt Packages lists.
+//
+// Reading these files is a matter of milliseconds, while the same view from PackageKit has to wait for
+// the daemon and its backend to start. Each file is memory mapped and streamed once. Installed versions
+// come from the status file, the candidate is the highest version of the native architecture (or "all")
+// found in the lists. Unlike apt this doesn't consider pinning or phased updates, and lists apt stores
+// compressed (Acquire::GzipIndexes) are skipped, so the view is refined by the next PackageKit refresh.
+class NativePackageReader
+{
+public:
+    explicit NativePackageReader(const QString &statusFileName, const QString &listsDirectory);
+
+    void setFilter(const PackageNameFilter &filter);
+
+    // Fills packages with the managed packages, keyed by name. Strings are interned into pool.
+    bool read(QHash<QString, Package> *packages, PackageStringPool *pool);
+    QString errorString() const;
+
+    // Debian version comparison (epoch, upstream version, revision) as done by dpkg.
+    // Returns <0, 0 or >0 if a is lower than, equal to or higher than b.
+    static int compareVersions(const QByteArray &a, const QByteArray &b);
+
+private:
+    class Entry {
+    public:
+        QByteArray installedVersion;
+        QByteArray installedArch;
+        QByteArray candidateVersion;
+        QByteArray summary;
+    };
+
+    bool isManaged(const QString &packageName, const QByteArray &section) const;
+    QByteArray readNativeArch() const;
+    bool readStatus(QHash<QString, Entry> *entries);
+    void readList(const QString &fileName, QHash<QString, Entry> *entries);
+
+    QString m_statusFileName;
+    QString m_listsDirectory;
+    PackageNameFilter m_filter;
+    QByteArray m_nativeArch;
+    QString m_errorString;
+};
+
+#endif // NATIVEPACKAGEREADER_H
@@ -0,0 +1,50 @@
+# Sources of the plugin, shared with the benchmark harness and tests which build them directly.
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/cacherefreshpolicy.cpp \
+    $$PWD/debcontrolreader.cpp \
+    $$PWD/dpkgstatuswatcher.cpp \
+    $$PWD/nativepackagereader.cpp \
+    $$PWD/packagechangeset.cpp \
+    $$PWD/packagedetailscache.cpp \
+    $$PWD/packageid.cpp \
+    $$PWD/packagenamefilter.cpp \
+    $$PWD/packagesnapshot.cpp \
+    $$PWD/packagestore.cpp \
+    $$PWD/refreshscheduler.cpp \
+    $$PWD/repositorychannelmatcher.cpp \
+    $$PWD/repositoryfilemanager.cpp \
+    $$PWD/repositorystore.cpp \
+    $$PWD/transactiongraph.cpp \
+    $$PWD/transactionregistry.cpp \
+    $$PWD/updatecontrollerpackagekit.cpp \
+    $$PWD/updateprogress.cpp \
+    $$PWD/updateretrypolicy.cpp \
+    $$PWD/updatescheduler.cpp \
+    $$PWD/updatetracer.cpp
+
+HEADERS += \
+    $$PWD/cacherefreshpolicy.h \
+    $$PWD/debcontrolreader.h \
+    $$PWD/dpkgstatuswatcher.h \
+    $$PWD/nativepackagereader.h \
+    $$PWD/packagechangeset.h \
+    $$PWD/packagedetailscache.h \
+    $$PWD/packageid.h \
+    $$PWD/packagenamefilter.h \
+    $$PWD/packagesnapshot.h \
+    $$PWD/packagestore.h \
+    $$PWD/refreshscheduler.h \
+    $$PWD/repositorychannelmatcher.h \
+    $$PWD/repositoryfilemanager.h \
+    $$PWD/repositorystore.h \
+    $$PWD/simulatedupdate.h \
+    $$PWD/transactiongraph.h \
+    $$PWD/transactionregistry.h \
+    $$PWD/updatecontrollerpackagekit.h \
+    $$PWD/updateprogress.h \
+    $$PWD/updateretrypolicy.h \
+    $$PWD/updatescheduler.h \
+    $$PWD/updatetracer.h
@@ -42,11 +42,7 @@ QMAKE_CXXFLAGS *= -g
 CONFIG += plugin link_pkgconfig
 PKGCONFIG += nymea
 
-SOURCES += \
-    updatecontrollerpackagekit.cpp
-
-HEADERS += \
-    updatecontrollerpackagekit.h
+include(nymea-update-plugin-packagekit.pri)
 
 target.path = $$[QT_INSTALL_LIBS]/nymea/platform/
 INSTALLS += target
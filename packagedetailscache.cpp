@@ -0,0 +1,154 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "packagedetailscache.h"
+#include "transactiongraph.h"
+#include "transactionregistry.h"
+
+#include <Daemon>
+#include <Details>
+#include <QSharedPointer>
+
+#include "loggingcategories.h"
+
+PackageDetailsCache::PackageDetailsCache(QObject *parent):
+    QObject(parent)
+{
+    m_cache.setMaxCost(256);
+
+    m_batchTimer = new QTimer(this);
+    m_batchTimer->setSingleShot(true);
+    m_batchTimer->setInterval(50);
+    connect(m_batchTimer, &QTimer::timeout, this, &PackageDetailsCache::flush);
+}
+
+int PackageDetailsCache::capacity() const
+{
+    return m_cache.maxCost();
+}
+
+void PackageDetailsCache::setCapacity(int capacity)
+{
+    m_cache.setMaxCost(qMax(1, capacity));
+}
+
+bool PackageDetailsCache::contains(const QString &packageId) const
+{
+    return m_cache.contains(packageId);
+}
+
+QVariantMap PackageDetailsCache::details(const QString &packageId) const
+{
+    QVariantMap *details = m_cache.object(packageId);
+    return details ? *details : QVariantMap();
+}
+
+void PackageDetailsCache::fetch(const QString &packageId, bool update)
+{
+    if (m_cache.contains(packageId) || m_inFlight.contains(packageId)) {
+        return;
+    }
+    m_pending.insert(packageId);
+    if (update) {
+        m_pendingUpdates.insert(packageId);
+    }
+    if (!m_batchTimer->isActive()) {
+        m_batchTimer->start();
+    }
+}
+
+void PackageDetailsCache::flush()
+{
+    if (m_pending.isEmpty()) {
+        return;
+    }
+    QStringList packageIds = m_pending.values();
+    QStringList updateIds = m_pendingUpdates.values();
+    m_pending.clear();
+    m_pendingUpdates.clear();
+    foreach (const QString &packageId, packageIds) {
+        m_inFlight.insert(packageId);
+    }
+    qCDebug(dcPlatformUpdate()) << "Fetching details of" << packageIds.count() << "packages," << updateIds.count() << "of them updates";
+
+    QSharedPointer<QHash<QString, QVariantMap>> results(new QHash<QString, QVariantMap>());
+
+    TransactionGraph *graph = new TransactionGraph("details", this);
+    connect(graph, &TransactionGraph::transactionStarted, this, &PackageDetailsCache::transactionStarted);
+
+    graph->addStep("details", [graph, packageIds, results]() -> PackageKit::Transaction* {
+        PackageKit::Transaction *getDetails = PackageKit::Daemon::getDetails(packageIds);
+        connect(getDetails, &PackageKit::Transaction::details, graph, [results](const PackageKit::Details &details){
+            QVariantMap &entry = (*results)[details.packageId()];
+            for (QVariantMap::const_iterator it = details.constBegin(); it != details.constEnd(); ++it) {
+                entry.insert(it.key(), it.value());
+            }
+        });
+        return getDetails;
+    });
+
+    graph->addStep("updateDetails", [graph, updateIds, results]() -> PackageKit::Transaction* {
+        if (updateIds.isEmpty()) {
+            return nullptr;
+        }
+        PackageKit::Transaction *getUpdatesDetails = PackageKit::Daemon::getUpdatesDetails(updateIds);
+        connect(getUpdatesDetails, &PackageKit::Transaction::updateDetail, graph, [results](const QString &packageID, const QStringList &updates, const QStringList &obsoletes,
+                const QStringList &vendorUrls, const QStringList &bugzillaUrls, const QStringList &cveUrls, PackageKit::Transaction::Restart restart,
+                const QString &updateText, const QString &changelog, PackageKit::Transaction::UpdateState state, const QDateTime &issued, const QDateTime &updated){
+            Q_UNUSED(updates)
+            Q_UNUSED(obsoletes)
+            QVariantMap &entry = (*results)[packageID];
+            entry.insert("vendorUrls", vendorUrls);
+            entry.insert("bugzillaUrls", bugzillaUrls);
+            entry.insert("cveUrls", cveUrls);
+            entry.insert("restart", TransactionRegistry::enumToString("Restart", restart));
+            entry.insert("updateText", updateText);
+            entry.insert("changelog", changelog);
+            entry.insert("updateState", TransactionRegistry::enumToString("UpdateState", state));
+            entry.insert("issued", issued);
+            entry.insert("updated", updated);
+        });
+        return getUpdatesDetails;
+    });
+
+    connect(graph, &TransactionGraph::finished, this, [this, packageIds, results](){
+        foreach (const QString &packageId, packageIds) {
+            m_inFlight.remove(packageId);
+            if (!results->contains(packageId)) {
+                emit detailsReady(packageId, QVariantMap());
+                continue;
+            }
+            QVariantMap details = results->value(packageId);
+            m_cache.insert(packageId, new QVariantMap(details));
+            emit detailsReady(packageId, details);
+        }
+        // Requests for packages which were in flight while they came in
+        if (!m_pending.isEmpty()) {
+            m_batchTimer->start();
+        }
+    });
+
+    graph->start();
+}
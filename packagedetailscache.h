@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef PACKAGEDETAILSCACHE_H
+#define PACKAGEDETAILSCACHE_H
+
+#include <QCache>
+#include <QObject>
+#include <QSet>
+#include <QTimer>
+#include <QVariantMap>
+
+#include <Transaction>
+
+// Fetches package details on demand and keeps them in a bounded LRU cache.
+//
+// Requests arriving within a short interval are fetched together with a single getDetails, plus a
+// single getUpdatesDetails for updates. Entries are keyed by the versioned package ID, so new
+// versions are fetched again and details of old versions simply age out.
+class PackageDetailsCache : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PackageDetailsCache(QObject *parent = nullptr);
+
+    int capacity() const;
+    void setCapacity(int capacity);
+
+    bool contains(const QString &packageId) const;
+    // Empty if not cached
+    QVariantMap details(const QString &packageId) const;
+
+    // Queues packageId for the next batch unless cached or already being fetched.
+    // update also fetches the update details (changelog, update text, restart, CVE and bug URLs...).
+    void fetch(const QString &packageId, bool update);
+
+signals:
+    // details is empty if they couldn't be fetched
+    void detailsReady(const QString &packageId, const QVariantMap &details);
+    void transactionStarted(PackageKit::Transaction *transaction, const QString &step);
+
+private slots:
+    void flush();
+
+private:
+    QCache<QString, QVariantMap> m_cache;
+    QTimer *m_batchTimer = nullptr;
+    QSet<QString> m_pending;
+    QSet<QString> m_pendingUpdates;
+    QSet<QString> m_inFlight;
+};
+
+#endif // PACKAGEDETAILSCACHE_H
@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "packageid.h"
+
+PackageId::PackageId(const QString &packageId):
+    m_packageId(packageId)
+{
+    const QChar *data = m_packageId.constData();
+    const int length = m_packageId.length();
+
+    int field = FieldName;
+    int start = 0;
+    for (int i = 0; i < length && field < FieldData; i++) {
+        if (data[i] == QLatin1Char(';')) {
+            m_offsets[field] = start;
+            m_lengths[field] = i - start;
+            start = i + 1;
+            field++;
+        }
+    }
+    if (field != FieldData) {
+        return;
+    }
+    m_offsets[FieldData] = start;
+    m_lengths[FieldData] = length - start;
+    m_valid = m_lengths[FieldName] > 0;
+}
+
+bool PackageId::isValid() const
+{
+    return m_valid;
+}
+
+QString PackageId::packageId() const
+{
+    return m_packageId;
+}
+
+QStringView PackageId::name() const
+{
+    return field(FieldName);
+}
+
+QStringView PackageId::version() const
+{
+    return field(FieldVersion);
+}
+
+QStringView PackageId::arch() const
+{
+    return field(FieldArch);
+}
+
+QStringView PackageId::data() const
+{
+    return field(FieldData);
+}
+
+QStringView PackageId::field(Field field) const
+{
+    if (!m_valid) {
+        return QStringView();
+    }
+    return QStringView(m_packageId).mid(m_offsets[field], m_lengths[field]);
+}
+
+QString PackageStringPool::intern(QStringView string)
+{
+    if (string.isEmpty()) {
+        return QString();
+    }
+    QHash<QStringView, QString>::const_iterator it = m_strings.constFind(string);
+    if (it != m_strings.constEnd()) {
+        return it.value();
+    }
+    QString value = string.toString();
+    m_strings.insert(QStringView(value), value);
+    return value;
+}
+
+QString PackageStringPool::intern(const QString &string)
+{
+    if (string.isEmpty()) {
+        return QString();
+    }
+    QHash<QStringView, QString>::const_iterator it = m_strings.constFind(QStringView(string));
+    if (it != m_strings.constEnd()) {
+        return it.value();
+    }
+    m_strings.insert(QStringView(string), string);
+    return string;
+}
+
+int PackageStringPool::count() const
+{
+    return m_strings.count();
+}
+
+void PackageStringPool::clear()
+{
+    m_strings.clear();
+}
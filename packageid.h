@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef PACKAGEID_H
+#define PACKAGEID_H
+
+#include <QHash>
+#include <QString>
+#include <QStringView>
+
+// A PackageKit package ID ("name;version;arch;data"), split once into views on the original string.
+// Unlike PackageKit::Daemon::packageName() and friends this does not allocate per field.
+class PackageId
+{
+public:
+    explicit PackageId(const QString &packageId);
+
+    bool isValid() const;
+    QString packageId() const;
+
+    QStringView name() const;
+    QStringView version() const;
+    QStringView arch() const;
+    QStringView data() const;
+
+private:
+    enum Field {
+        FieldName,
+        FieldVersion,
+        FieldArch,
+        FieldData
+    };
+    QStringView field(Field field) const;
+
+    QString m_packageId;
+    bool m_valid = false;
+    int m_offsets[4] = {0, 0, 0, 0};
+    int m_lengths[4] = {0, 0, 0, 0};
+};
+
+// Hands out one shared QString per distinct value, so the same package names, versions, arches
+// and repository data streamed by every refresh share their storage. Lookups of already known
+// values don't allocate.
+class PackageStringPool
+{
+public:
+    QString intern(QStringView string);
+    // Adopts the storage of string if the value isn't known yet instead of copying it
+    QString intern(const QString &string);
+
+    int count() const;
+    void clear();
+
+private:
+    // The keys are views on the values
+    QHash<QStringView, QString> m_strings;
+};
+
+#endif // PACKAGEID_H
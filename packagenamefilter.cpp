@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "packagenamefilter.h"
+
+#include <QSettings>
+
+PackageNameFilter::PackageNameFilter():
+    PackageNameFilter({"nymea"}, {"dbgsym"})
+{
+
+}
+
+PackageNameFilter::PackageNameFilter(const QStringList &includePatterns, const QStringList &excludePatterns):
+    m_includePatterns(includePatterns),
+    m_excludePatterns(excludePatterns)
+{
+    m_includePatterns.removeAll(QString());
+    m_includePatterns.removeDuplicates();
+    m_excludePatterns.removeAll(QString());
+    m_excludePatterns.removeDuplicates();
+
+    foreach (const QString &pattern, m_includePatterns) {
+        m_includeMatchers.append(QStringMatcher(pattern));
+    }
+    foreach (const QString &pattern, m_excludePatterns) {
+        m_excludeMatchers.append(QStringMatcher(pattern));
+    }
+}
+
+PackageNameFilter PackageNameFilter::fromSettings(QSettings &settings)
+{
+    PackageNameFilter defaultFilter;
+    settings.beginGroup("PackageFilter");
+    QStringList includePatterns = settings.value("includePatterns", defaultFilter.includePatterns()).toStringList();
+    QStringList excludePatterns = settings.value("excludePatterns", defaultFilter.excludePatterns()).toStringList();
+    settings.endGroup();
+    return PackageNameFilter(includePatterns, excludePatterns);
+}
+
+QStringList PackageNameFilter::includePatterns() const
+{
+    return m_includePatterns;
+}
+
+QStringList PackageNameFilter::excludePatterns() const
+{
+    return m_excludePatterns;
+}
+
+QStringList PackageNameFilter::searchTerms() const
+{
+    return m_includePatterns;
+}
+
+bool PackageNameFilter::isIncluded(QStringView packageName) const
+{
+    return containsAny(m_includeMatchers, packageName);
+}
+
+bool PackageNameFilter::isExcluded(QStringView packageName) const
+{
+    return containsAny(m_excludeMatchers, packageName);
+}
+
+bool PackageNameFilter::matches(QStringView packageName) const
+{
+    return isIncluded(packageName) && !isExcluded(packageName);
+}
+
+bool PackageNameFilter::containsAny(const QVector<QStringMatcher> &matchers, QStringView packageName)
+{
+    foreach (const QStringMatcher &matcher, matchers) {
+        if (matcher.indexIn(packageName.data(), packageName.size()) >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
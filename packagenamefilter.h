@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef PACKAGENAMEFILTER_H
+#define PACKAGENAMEFILTER_H
+
+#include <QStringList>
+#include <QStringMatcher>
+#include <QStringView>
+#include <QVector>
+
+class QSettings;
+
+// Decides which packages are managed by this plugin.
+// Include patterns are plain substrings (as in the former hardcoded "nymea" check) and are also
+// handed to PackageKit as search terms so the backend only streams candidates back to us.
+// Exclude patterns are substrings which drop a package even if it matched an include pattern.
+class PackageNameFilter
+{
+public:
+    PackageNameFilter();
+    PackageNameFilter(const QStringList &includePatterns, const QStringList &excludePatterns);
+
+    static PackageNameFilter fromSettings(QSettings &settings);
+
+    QStringList includePatterns() const;
+    QStringList excludePatterns() const;
+
+    // The terms to be passed to PackageKit::Daemon::searchNames(). Backends AND the terms of a single
+    // search (a package has to match all of them), so each term needs a search of its own.
+    QStringList searchTerms() const;
+
+    bool isIncluded(QStringView packageName) const;
+    bool isExcluded(QStringView packageName) const;
+    bool matches(QStringView packageName) const;
+
+private:
+    static bool containsAny(const QVector<QStringMatcher> &matchers, QStringView packageName);
+
+    QStringList m_includePatterns;
+    QStringList m_excludePatterns;
+    QVector<QStringMatcher> m_includeMatchers;
+    QVector<QStringMatcher> m_excludeMatchers;
+};
+
+#endif // PACKAGENAMEFILTER_H
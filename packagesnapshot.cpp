@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "packagesnapshot.h"
+#include "loggingcategories.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QCryptographicHash>
+
+const quint32 PackageSnapshot::s_magic = 0x4e55504b; // "NUPK"
+const quint32 PackageSnapshot::s_formatVersion = 1;
+
+static const int headerSize = 3 * sizeof(quint32) + 20;
+
+bool PackageSnapshot::save(const QString &fileName, const QList<Package> &packages, const QList<Repository> &repositories)
+{
+    QByteArray payload;
+    QDataStream payloadStream(&payload, QIODevice::WriteOnly);
+    payloadStream.setVersion(QDataStream::Qt_5_6);
+
+    payloadStream << static_cast<quint32>(packages.count());
+    foreach (const Package &package, packages) {
+        payloadStream << package.packageId()
+                      << package.displayName()
+                      << package.summary()
+                      << package.installedVersion()
+                      << package.candidateVersion()
+                      << package.updateAvailable()
+                      << package.canRemove();
+    }
+    payloadStream << static_cast<quint32>(repositories.count());
+    foreach (const Repository &repository, repositories) {
+        payloadStream << repository.id()
+                      << repository.displayName()
+                      << repository.enabled();
+    }
+
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly)) {
+        qCWarning(dcPlatformUpdate()) << "Failed to open package snapshot" << fileName << "for writing:" << file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream << s_magic << s_formatVersion << static_cast<quint32>(payload.size());
+    stream.writeRawData(QCryptographicHash::hash(payload, QCryptographicHash::Sha1).constData(), 20);
+    stream.writeRawData(payload.constData(), payload.size());
+
+    if (stream.status() != QDataStream::Ok || !file.commit()) {
+        qCWarning(dcPlatformUpdate()) << "Failed to write package snapshot" << fileName << ":" << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool PackageSnapshot::load(const QString &fileName, QList<Package> *packages, QList<Repository> *repositories)
+{
+    QFile file(fileName);
+    if (!file.exists()) {
+        return false;
+    }
+    if (!file.open(QFile::ReadOnly) || file.size() < headerSize) {
+        qCWarning(dcPlatformUpdate()) << "Package snapshot" << fileName << "is not readable. Ignoring it.";
+        return false;
+    }
+
+    uchar *data = file.map(0, file.size());
+    if (!data) {
+        qCWarning(dcPlatformUpdate()) << "Failed to map package snapshot" << fileName << ":" << file.errorString();
+        return false;
+    }
+    QByteArray mapped = QByteArray::fromRawData(reinterpret_cast<const char*>(data), static_cast<int>(file.size()));
+
+    QDataStream headerStream(mapped);
+    quint32 magic = 0, formatVersion = 0, payloadSize = 0;
+    headerStream >> magic >> formatVersion >> payloadSize;
+    if (magic != s_magic || formatVersion != s_formatVersion || payloadSize != static_cast<quint32>(mapped.size() - headerSize)) {
+        qCWarning(dcPlatformUpdate()) << "Package snapshot" << fileName << "has an unknown format or size. Ignoring it.";
+        file.unmap(data);
+        return false;
+    }
+
+    QByteArray payload = QByteArray::fromRawData(mapped.constData() + headerSize, payloadSize);
+    if (QCryptographicHash::hash(payload, QCryptographicHash::Sha1) != mapped.mid(headerSize - 20, 20)) {
+        qCWarning(dcPlatformUpdate()) << "Package snapshot" << fileName << "has a bad checksum. Ignoring it.";
+        file.unmap(data);
+        return false;
+    }
+
+    QDataStream payloadStream(payload);
+    payloadStream.setVersion(QDataStream::Qt_5_6);
+
+    quint32 packageCount = 0;
+    payloadStream >> packageCount;
+    for (quint32 i = 0; i < packageCount && payloadStream.status() == QDataStream::Ok; i++) {
+        QString packageId, displayName, summary, installedVersion, candidateVersion;
+        bool updateAvailable = false, canRemove = false;
+        payloadStream >> packageId >> displayName >> summary >> installedVersion >> candidateVersion >> updateAvailable >> canRemove;
+        Package package(packageId, displayName);
+        package.setSummary(summary);
+        package.setInstalledVersion(installedVersion);
+        package.setCandidateVersion(candidateVersion);
+        package.setUpdateAvailable(updateAvailable);
+        package.setCanRemove(canRemove);
+        packages->append(package);
+    }
+
+    quint32 repositoryCount = 0;
+    payloadStream >> repositoryCount;
+    for (quint32 i = 0; i < repositoryCount && payloadStream.status() == QDataStream::Ok; i++) {
+        QString id, displayName;
+        bool enabled = false;
+        payloadStream >> id >> displayName >> enabled;
+        repositories->append(Repository(id, displayName, enabled));
+    }
+
+    bool ok = payloadStream.status() == QDataStream::Ok;
+    file.unmap(data);
+    if (!ok) {
+        qCWarning(dcPlatformUpdate()) << "Package snapshot" << fileName << "is truncated. Ignoring it.";
+        packages->clear();
+        repositories->clear();
+    }
+    return ok;
+}
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef PACKAGESNAPSHOT_H
+#define PACKAGESNAPSHOT_H
+
+#include <QList>
+#include <QString>
+
+#include "platform/package.h"
+#include "platform/repository.h"
+
+// On-disk snapshot of the last known package and repository state.
+//
+// Changelogs are deliberately left out. They are only known for packages with an update, are
+// fetched again after the first refresh anyway and would make up most of the file.
+//
+// Layout (all integers big endian):
+//   quint32 magic | quint32 format version | quint32 payload length | 20 bytes SHA-1 of payload | payload
+//
+// The file is memory mapped on load and the checksum verified before anything is parsed, so a
+// truncated or otherwise corrupted snapshot is rejected instead of producing bogus packages.
+class PackageSnapshot
+{
+public:
+    static bool save(const QString &fileName, const QList<Package> &packages, const QList<Repository> &repositories);
+    static bool load(const QString &fileName, QList<Package> *packages, QList<Repository> *repositories);
+
+private:
+    static const quint32 s_magic;
+    static const quint32 s_formatVersion;
+};
+
+#endif // PACKAGESNAPSHOT_H
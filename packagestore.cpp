@@ -0,0 +1,330 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "packagestore.h"
+
+PackageStore::PackageStore()
+{
+
+}
+
+quint64 PackageStore::generation() const
+{
+    return m_generation;
+}
+
+int PackageStore::count() const
+{
+    return m_packageIds.count();
+}
+
+bool PackageStore::contains(const QString &packageId) const
+{
+    return m_rows.contains(packageId);
+}
+
+Package PackageStore::package(const QString &packageId) const
+{
+    int row = m_rows.value(packageId, -1);
+    if (row < 0) {
+        return Package();
+    }
+    return packageAt(row);
+}
+
+QList<Package> PackageStore::packages() const
+{
+    if (!m_snapshotValid) {
+        QList<Package> packages;
+        packages.reserve(m_packageIds.count());
+        for (int row = 0; row < m_packageIds.count(); row++) {
+            packages.append(packageAt(row));
+        }
+        m_snapshot = packages;
+        m_snapshotValid = true;
+    }
+    return m_snapshot;
+}
+
+QList<Package> PackageStore::updatablePackages() const
+{
+    return packagesAt(m_updatable);
+}
+
+QList<Package> PackageStore::removablePackages() const
+{
+    return packagesAt(m_removable);
+}
+
+QList<Package> PackageStore::installedPackages() const
+{
+    return packagesAt(m_installed);
+}
+
+bool PackageStore::insert(const Package &package)
+{
+    int row = m_rows.value(package.packageId(), -1);
+    if (row < 0) {
+        append(package);
+    } else {
+        Package merged = package;
+        keepChangelog(row, &merged);
+        if (rowEquals(row, merged)) {
+            return false;
+        }
+        setRow(row, merged);
+    }
+    commit();
+    return true;
+}
+
+bool PackageStore::remove(const QString &packageId)
+{
+    int row = m_rows.value(packageId, -1);
+    if (row < 0) {
+        return false;
+    }
+    removeRow(row);
+    commit();
+    return true;
+}
+
+void PackageStore::clear()
+{
+    m_rows.clear();
+    m_packageIds.clear();
+    m_displayNames.clear();
+    m_summaries.clear();
+    m_installedVersions.clear();
+    m_candidateVersions.clear();
+    m_changelogs.clear();
+    m_flags.clear();
+    m_updatable.clear();
+    m_removable.clear();
+    m_installed.clear();
+    m_strings.clear();
+
+    m_generation++;
+    m_snapshot.clear();
+    m_snapshotValid = true;
+}
+
+PackageChangeset PackageStore::apply(QHash<QString, Package> &incoming)
+{
+    PackageChangeset changeset;
+
+    QVector<bool> seen(m_packageIds.count(), false);
+    for (QHash<QString, Package>::const_iterator it = incoming.constBegin(); it != incoming.constEnd(); ++it) {
+        int row = m_rows.value(it.key(), -1);
+        if (row < 0) {
+            append(it.value());
+            changeset.added.append(it.value());
+            continue;
+        }
+        seen[row] = true;
+        Package package = it.value();
+        keepChangelog(row, &package);
+        if (!rowEquals(row, package)) {
+            setRow(row, package);
+            changeset.changed.append(package);
+        }
+    }
+
+    // Remove from the back, rows before the removed one are not moved
+    for (int row = seen.count() - 1; row >= 0; row--) {
+        if (!seen.at(row)) {
+            changeset.removed.append(m_packageIds.at(row));
+            removeRow(row);
+        }
+    }
+
+    incoming.clear();
+    compactStrings();
+    if (!changeset.isEmpty()) {
+        commit();
+    }
+    return changeset;
+}
+
+PackageStringPool &PackageStore::stringPool()
+{
+    return m_strings;
+}
+
+quint8 PackageStore::flags(const Package &package)
+{
+    quint8 flags = 0;
+    if (package.updateAvailable()) {
+        flags |= FlagUpdateAvailable;
+    }
+    if (package.canRemove()) {
+        flags |= FlagCanRemove;
+    }
+    if (!package.installedVersion().isEmpty()) {
+        flags |= FlagInstalled;
+    }
+    return flags;
+}
+
+bool PackageStore::rowEquals(int row, const Package &package) const
+{
+    return m_flags.at(row) == flags(package)
+            && m_installedVersions.at(row) == package.installedVersion()
+            && m_candidateVersions.at(row) == package.candidateVersion()
+            && m_summaries.at(row) == package.summary()
+            && m_displayNames.at(row) == package.displayName()
+            && m_changelogs.at(row) == package.changelog();
+}
+
+void PackageStore::keepChangelog(int row, Package *package) const
+{
+    // Refreshes don't fetch changelogs. They stay valid as long as the candidate doesn't change.
+    if (package->changelog().isEmpty() && m_candidateVersions.at(row) == package->candidateVersion()) {
+        package->setChangelog(m_changelogs.at(row));
+    }
+}
+
+Package PackageStore::packageAt(int row) const
+{
+    Package package(m_packageIds.at(row), m_displayNames.at(row));
+    package.setSummary(m_summaries.at(row));
+    package.setInstalledVersion(m_installedVersions.at(row));
+    package.setCandidateVersion(m_candidateVersions.at(row));
+    package.setChangelog(m_changelogs.at(row));
+    package.setUpdateAvailable(m_flags.at(row) & FlagUpdateAvailable);
+    package.setCanRemove(m_flags.at(row) & FlagCanRemove);
+    return package;
+}
+
+void PackageStore::append(const Package &package)
+{
+    int row = m_packageIds.count();
+    QString packageId = m_strings.intern(package.packageId());
+    m_rows.insert(packageId, row);
+    m_packageIds.append(packageId);
+    m_displayNames.append(QString());
+    m_summaries.append(QString());
+    m_installedVersions.append(QString());
+    m_candidateVersions.append(QString());
+    m_changelogs.append(QString());
+    m_flags.append(0);
+    setRow(row, package);
+}
+
+void PackageStore::setRow(int row, const Package &package)
+{
+    m_displayNames[row] = m_strings.intern(package.displayName());
+    m_summaries[row] = m_strings.intern(package.summary());
+    m_installedVersions[row] = m_strings.intern(package.installedVersion());
+    m_candidateVersions[row] = m_strings.intern(package.candidateVersion());
+    // Unique per package and version, interning wouldn't share anything
+    m_changelogs[row] = package.changelog();
+
+    setIndices(row, m_flags.at(row), false);
+    m_flags[row] = flags(package);
+    setIndices(row, m_flags.at(row), true);
+}
+
+void PackageStore::removeRow(int row)
+{
+    int last = m_packageIds.count() - 1;
+    setIndices(row, m_flags.at(row), false);
+    m_rows.remove(m_packageIds.at(row));
+
+    // Move the last row into the gap
+    if (row != last) {
+        setIndices(last, m_flags.at(last), false);
+        m_packageIds[row] = m_packageIds.at(last);
+        m_displayNames[row] = m_displayNames.at(last);
+        m_summaries[row] = m_summaries.at(last);
+        m_installedVersions[row] = m_installedVersions.at(last);
+        m_candidateVersions[row] = m_candidateVersions.at(last);
+        m_changelogs[row] = m_changelogs.at(last);
+        m_flags[row] = m_flags.at(last);
+        m_rows[m_packageIds.at(row)] = row;
+        setIndices(row, m_flags.at(row), true);
+    }
+
+    m_packageIds.removeLast();
+    m_displayNames.removeLast();
+    m_summaries.removeLast();
+    m_installedVersions.removeLast();
+    m_candidateVersions.removeLast();
+    m_changelogs.removeLast();
+    m_flags.removeLast();
+}
+
+void PackageStore::setIndices(int row, quint8 flags, bool set)
+{
+    if (flags & FlagUpdateAvailable) {
+        set ? (void)m_updatable.insert(row) : (void)m_updatable.remove(row);
+    }
+    if (flags & FlagCanRemove) {
+        set ? (void)m_removable.insert(row) : (void)m_removable.remove(row);
+    }
+    if (flags & FlagInstalled) {
+        set ? (void)m_installed.insert(row) : (void)m_installed.remove(row);
+    }
+}
+
+QList<Package> PackageStore::packagesAt(const QSet<int> &rows) const
+{
+    QList<Package> packages;
+    packages.reserve(rows.count());
+    foreach (int row, rows) {
+        packages.append(packageAt(row));
+    }
+    return packages;
+}
+
+void PackageStore::compactStrings()
+{
+    // Old versions and summaries pile up in the pool over time. Rebuild it once it's mostly garbage.
+    if (m_strings.count() < 64 || m_strings.count() < m_packageIds.count() * 5 * 2) {
+        return;
+    }
+    m_strings.clear();
+    for (int row = 0; row < m_packageIds.count(); row++) {
+        m_packageIds[row] = m_strings.intern(m_packageIds.at(row));
+        m_displayNames[row] = m_strings.intern(m_displayNames.at(row));
+        m_summaries[row] = m_strings.intern(m_summaries.at(row));
+        m_installedVersions[row] = m_strings.intern(m_installedVersions.at(row));
+        m_candidateVersions[row] = m_strings.intern(m_candidateVersions.at(row));
+    }
+
+    // The row keys have to share the pooled IDs too, or every ID stays allocated twice
+    m_rows.clear();
+    m_rows.reserve(m_packageIds.count());
+    for (int row = 0; row < m_packageIds.count(); row++) {
+        m_rows.insert(m_packageIds.at(row), row);
+    }
+}
+
+void PackageStore::commit()
+{
+    m_generation++;
+    m_snapshotValid = false;
+    m_snapshot.clear();
+}
@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef PACKAGESTORE_H
+#define PACKAGESTORE_H
+
+#include <QHash>
+#include <QSet>
+#include <QVector>
+
+#include "platform/package.h"
+#include "packagechangeset.h"
+#include "packageid.h"
+
+// Compact storage of the managed packages.
+//
+// Packages are stored column wise with all strings except changelogs interned, and the boolean flags
+// packed into one byte per package. Secondary indices for updatable, removable and installed packages
+// are kept up to date on every modification, so filtered queries only touch the matching packages.
+// A changelog is kept as long as the candidate version stays the same, refreshes don't carry one.
+//
+// Every modification bumps the generation. packages() returns a shared, immutable snapshot which is
+// only rebuilt after the store has changed.
+class PackageStore
+{
+public:
+    PackageStore();
+
+    quint64 generation() const;
+
+    int count() const;
+    bool contains(const QString &packageId) const;
+    Package package(const QString &packageId) const;
+
+    QList<Package> packages() const;
+    QList<Package> updatablePackages() const;
+    QList<Package> removablePackages() const;
+    QList<Package> installedPackages() const;
+
+    // Adds the package or replaces the one with the same ID. Returns false if nothing changed.
+    bool insert(const Package &package);
+    bool remove(const QString &packageId);
+    void clear();
+
+    // Replaces the whole content with incoming and returns what changed. Leaves incoming empty.
+    PackageChangeset apply(QHash<QString, Package> &incoming);
+
+    PackageStringPool &stringPool();
+
+private:
+    enum Flag {
+        FlagUpdateAvailable = 0x01,
+        FlagCanRemove = 0x02,
+        FlagInstalled = 0x04
+    };
+
+    static quint8 flags(const Package &package);
+    bool rowEquals(int row, const Package &package) const;
+    void keepChangelog(int row, Package *package) const;
+    Package packageAt(int row) const;
+    void append(const Package &package);
+    void setRow(int row, const Package &package);
+    void removeRow(int row);
+    void setIndices(int row, quint8 flags, bool set);
+    QList<Package> packagesAt(const QSet<int> &rows) const;
+    void compactStrings();
+    void commit();
+
+    PackageStringPool m_strings;
+    QHash<QString, int> m_rows; // <packageId, row>
+
+    QVector<QString> m_packageIds;
+    QVector<QString> m_displayNames;
+    QVector<QString> m_summaries;
+    QVector<QString> m_installedVersions;
+    QVector<QString> m_candidateVersions;
+    QVector<QString> m_changelogs;
+    QVector<quint8> m_flags;
+
+    QSet<int> m_updatable;
+    QSet<int> m_removable;
+    QSet<int> m_installed;
+
+    quint64 m_generation = 0;
+    mutable QList<Package> m_snapshot;
+    mutable bool m_snapshotValid = true;
+};
+
+#endif // PACKAGESTORE_H
@@ -0,0 +1,154 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "refreshscheduler.h"
+#include "loggingcategories.h"
+
+#include <QMetaEnum>
+
+RefreshScheduler::RefreshScheduler(QObject *parent):
+    QObject(parent)
+{
+    m_debounceTimer = new QTimer(this);
+    m_debounceTimer->setSingleShot(true);
+    m_debounceTimer->setInterval(500);
+    connect(m_debounceTimer, &QTimer::timeout, this, &RefreshScheduler::startRefresh);
+}
+
+int RefreshScheduler::debounceInterval() const
+{
+    return m_debounceTimer->interval();
+}
+
+void RefreshScheduler::setDebounceInterval(int debounceInterval)
+{
+    m_debounceTimer->setInterval(debounceInterval);
+}
+
+bool RefreshScheduler::refreshRunning() const
+{
+    return m_running;
+}
+
+quint64 RefreshScheduler::generation() const
+{
+    return m_generation;
+}
+
+void RefreshScheduler::schedule(Trigger trigger)
+{
+    m_fullRefreshPending = true;
+    count(trigger);
+}
+
+void RefreshScheduler::schedulePackages(const QStringList &packageNames)
+{
+    foreach (const QString &packageName, packageNames) {
+        m_pendingPackages.insert(packageName);
+    }
+    count(TriggerPackagesChanged);
+}
+
+void RefreshScheduler::count(Trigger trigger)
+{
+    TriggerStatistics &statistics = m_statistics[trigger];
+    statistics.requested++;
+    statistics.lastRequested = QDateTime::currentDateTime();
+
+    if (m_running) {
+        if (m_dirty) {
+            statistics.coalesced++;
+        }
+        qCDebug(dcPlatformUpdate()) << "Refresh requested by" << trigger << "while another one is running. Scheduling a follow-up refresh.";
+        m_dirty = true;
+        return;
+    }
+
+    if (m_debounceTimer->isActive()) {
+        statistics.coalesced++;
+    }
+    // Restarting the timer debounces bursts of triggers into one refresh
+    m_debounceTimer->start();
+}
+
+void RefreshScheduler::refreshFinished()
+{
+    if (!m_running) {
+        return;
+    }
+    m_running = false;
+
+    if (m_dirty) {
+        m_dirty = false;
+        qCDebug(dcPlatformUpdate()) << "State changed during the last refresh. Starting follow-up refresh.";
+        m_debounceTimer->start();
+    }
+}
+
+QVariantMap RefreshScheduler::statistics() const
+{
+    QMetaEnum triggerEnum = QMetaEnum::fromType<Trigger>();
+    QVariantMap ret;
+    ret.insert("refreshCount", m_refreshCount);
+    ret.insert("packagesRefreshCount", m_packagesRefreshCount);
+    QVariantMap triggers;
+    foreach (int trigger, m_statistics.keys()) {
+        TriggerStatistics statistics = m_statistics.value(trigger);
+        QVariantMap entry;
+        entry.insert("requested", statistics.requested);
+        entry.insert("coalesced", statistics.coalesced);
+        entry.insert("lastRequested", statistics.lastRequested);
+        triggers.insert(triggerEnum.valueToKey(trigger), entry);
+    }
+    ret.insert("triggers", triggers);
+    return ret;
+}
+
+void RefreshScheduler::startRefresh()
+{
+    if (m_running) {
+        m_dirty = true;
+        return;
+    }
+    if (!m_fullRefreshPending && m_pendingPackages.isEmpty()) {
+        return;
+    }
+    m_running = true;
+
+    if (m_fullRefreshPending) {
+        // Reads all packages anyway
+        m_fullRefreshPending = false;
+        m_pendingPackages.clear();
+        m_refreshCount++;
+        m_generation++;
+        emit refreshRequested();
+        return;
+    }
+
+    QStringList packageNames = m_pendingPackages.values();
+    m_pendingPackages.clear();
+    m_packagesRefreshCount++;
+    emit packagesRefreshRequested(packageNames);
+}
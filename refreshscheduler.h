@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef REFRESHSCHEDULER_H
+#define REFRESHSCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QDateTime>
+#include <QVariantMap>
+
+// Coalesces refresh triggers into single-flight refresh runs.
+//
+// Triggers are debounced, so a burst of notifications results in one refresh. While a refresh is
+// running, further triggers only mark the state dirty and exactly one follow-up refresh is started
+// once the running one reports refreshFinished().
+//
+// Refreshes of individual packages go through the same queue, so they never run concurrently with
+// a full refresh. A pending full refresh covers all pending package refreshes.
+class RefreshScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    enum Trigger {
+        TriggerDaemonStarted,
+        TriggerUpdatesChanged,
+        TriggerCacheRefreshed,
+        TriggerRepositoriesChanged,
+        TriggerUpdateFinished,
+        TriggerListsChanged,
+        TriggerPackagesChanged
+    };
+    Q_ENUM(Trigger)
+
+    explicit RefreshScheduler(QObject *parent = nullptr);
+
+    int debounceInterval() const;
+    void setDebounceInterval(int debounceInterval);
+
+    bool refreshRunning() const;
+    // Increases whenever a full refresh is started
+    quint64 generation() const;
+
+    void schedule(Trigger trigger);
+    // Refreshes only the given packages, unless a full refresh is due anyway
+    void schedulePackages(const QStringList &packageNames);
+    // Has to be called after refreshRequested() and packagesRefreshRequested() alike
+    void refreshFinished();
+
+    QVariantMap statistics() const;
+
+signals:
+    void refreshRequested();
+    void packagesRefreshRequested(const QStringList &packageNames);
+
+private slots:
+    void startRefresh();
+
+private:
+    class TriggerStatistics {
+    public:
+        // How often the trigger fired
+        quint32 requested = 0;
+        // How often it was absorbed by an already pending or running refresh
+        quint32 coalesced = 0;
+        QDateTime lastRequested;
+    };
+
+    void count(Trigger trigger);
+
+    QTimer *m_debounceTimer = nullptr;
+    bool m_running = false;
+    bool m_dirty = false;
+    bool m_fullRefreshPending = false;
+    QSet<QString> m_pendingPackages;
+    quint32 m_refreshCount = 0;
+    quint32 m_packagesRefreshCount = 0;
+    quint64 m_generation = 0;
+    QHash<int, TriggerStatistics> m_statistics;
+};
+
+#endif // REFRESHSCHEDULER_H
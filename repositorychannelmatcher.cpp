@@ -0,0 +1,175 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "repositorychannelmatcher.h"
+
+#include <QSettings>
+
+#include "loggingcategories.h"
+
+RepositoryChannelMatcher::RepositoryChannelMatcher():
+    RepositoryChannelMatcher(defaultChannels())
+{
+
+}
+
+RepositoryChannelMatcher::RepositoryChannelMatcher(const QList<RepositoryChannel> &channels)
+{
+    QStringList alternatives;
+    foreach (const RepositoryChannel &channel, channels) {
+        if (channel.id.isEmpty()) {
+            continue;
+        }
+        QRegularExpression regExp(channel.pattern);
+        if (!regExp.isValid() || channel.pattern.isEmpty()) {
+            qCWarning(dcPlatformUpdate()) << "Ignoring repository channel" << channel.id << "with invalid pattern" << channel.pattern;
+            continue;
+        }
+        // The channel groups are the only named ones, a name used twice would make the combined expression invalid
+        QStringList namedGroups = regExp.namedCaptureGroups();
+        namedGroups.removeAll(QString());
+        if (!namedGroups.isEmpty()) {
+            qCWarning(dcPlatformUpdate()) << "Ignoring repository channel" << channel.id << "with named groups" << namedGroups << "in pattern" << channel.pattern;
+            continue;
+        }
+        alternatives.append(QString("(?<c%1>%2)").arg(m_channels.count()).arg(channel.pattern));
+        m_channels.append(channel);
+    }
+    if (m_channels.isEmpty()) {
+        return;
+    }
+
+    m_regExp.setPattern(alternatives.join('|'));
+    m_regExp.optimize();
+    if (!m_regExp.isValid()) {
+        // Individually valid patterns can still clash, e.g. with numbered back references
+        qCWarning(dcPlatformUpdate()) << "Repository channel patterns can't be combined:" << m_regExp.errorString();
+        m_channels.clear();
+        return;
+    }
+
+    QStringList groupNames = m_regExp.namedCaptureGroups();
+    for (int i = 0; i < m_channels.count(); i++) {
+        m_groups.append(groupNames.indexOf(QString("c%1").arg(i)));
+    }
+}
+
+RepositoryChannelMatcher RepositoryChannelMatcher::fromSettings(QSettings &settings)
+{
+    QList<RepositoryChannel> defaults = defaultChannels();
+    QStringList defaultIds;
+    foreach (const RepositoryChannel &channel, defaults) {
+        defaultIds.append(channel.id);
+    }
+
+    QStringList ids = settings.value("RepositoryChannels/channels", defaultIds).toStringList();
+    QList<RepositoryChannel> channels;
+    foreach (const QString &id, ids) {
+        RepositoryChannel channel;
+        channel.id = id.trimmed();
+        foreach (const RepositoryChannel &defaultChannel, defaults) {
+            if (defaultChannel.id == channel.id) {
+                channel = defaultChannel;
+            }
+        }
+        settings.beginGroup("RepositoryChannel_" + channel.id);
+        channel.pattern = settings.value("pattern", channel.pattern).toString();
+        channel.displayName = settings.value("displayName", channel.displayName.isEmpty() ? channel.id : channel.displayName).toString();
+        channel.virtualSource = settings.value("virtualSource", channel.virtualSource).toString();
+        settings.endGroup();
+        channels.append(channel);
+    }
+    return RepositoryChannelMatcher(channels);
+}
+
+QList<RepositoryChannel> RepositoryChannelMatcher::channels() const
+{
+    return m_channels;
+}
+
+RepositoryChannel RepositoryChannelMatcher::channel(int index) const
+{
+    return m_channels.value(index);
+}
+
+int RepositoryChannelMatcher::match(const QString &repositoryId) const
+{
+    if (m_channels.isEmpty() || repositoryId.contains(QLatin1String("deb-src"))) {
+        return -1;
+    }
+    QRegularExpressionMatch match = m_regExp.match(repositoryId);
+    if (!match.hasMatch()) {
+        return -1;
+    }
+    for (int i = 0; i < m_groups.count(); i++) {
+        if (match.capturedStart(m_groups.at(i)) >= 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+QString RepositoryChannelMatcher::virtualRepositoryId(int index) const
+{
+    if (index < 0 || index >= m_channels.count() || m_channels.at(index).virtualSource.isEmpty()) {
+        return QString();
+    }
+    return "virtual_" + m_channels.at(index).id;
+}
+
+int RepositoryChannelMatcher::virtualRepositoryChannel(const QString &repositoryId) const
+{
+    for (int i = 0; i < m_channels.count(); i++) {
+        if (!m_channels.at(i).virtualSource.isEmpty() && repositoryId == "virtual_" + m_channels.at(i).id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+QString RepositoryChannelMatcher::virtualSource(int index, const QString &distro, const QString &component) const
+{
+    QString source = m_channels.value(index).virtualSource;
+    source.replace("{distro}", distro);
+    source.replace("{component}", component);
+    return source;
+}
+
+QList<RepositoryChannel> RepositoryChannelMatcher::defaultChannels()
+{
+    RepositoryChannel testing;
+    testing.id = "testing";
+    testing.displayName = "Testing";
+    testing.pattern = "(ci-repo|repository)\\.nymea\\.io/(landing|landing-silo)";
+    testing.virtualSource = "deb http://repository.nymea.io/landing {distro} {component}";
+
+    RepositoryChannel experimental;
+    experimental.id = "experimental";
+    experimental.displayName = "Experimental";
+    experimental.pattern = "(ci-repo|repository)\\.nymea\\.io/(experimental|experimental-silo)";
+    experimental.virtualSource = "deb http://repository.nymea.io/experimental {distro} {component}";
+
+    return {testing, experimental};
+}
@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef REPOSITORYCHANNELMATCHER_H
+#define REPOSITORYCHANNELMATCHER_H
+
+#include <QList>
+#include <QRegularExpression>
+#include <QString>
+#include <QVector>
+
+class QSettings;
+
+class RepositoryChannel
+{
+public:
+    QString id;
+    QString displayName;
+    // Regular expression matched anywhere in the PackageKit repository ID, without named groups
+    QString pattern;
+    // sources.list line added when the virtual repository is enabled. {distro} and {component}
+    // are replaced. Channels without one don't get a virtual repository.
+    QString virtualSource;
+};
+
+// Classifies repository IDs into the configured channels (e.g. Testing and Experimental).
+// All channel patterns are compiled once into a single regular expression with one named
+// group per channel, so each repository is classified with a single match.
+class RepositoryChannelMatcher
+{
+public:
+    RepositoryChannelMatcher();
+    explicit RepositoryChannelMatcher(const QList<RepositoryChannel> &channels);
+
+    static RepositoryChannelMatcher fromSettings(QSettings &settings);
+
+    QList<RepositoryChannel> channels() const;
+    RepositoryChannel channel(int index) const;
+
+    // Index of the channel the repository belongs to, -1 if none. Source repositories never match.
+    int match(const QString &repositoryId) const;
+
+    // "virtual_<channel id>" for channels with a virtual source
+    QString virtualRepositoryId(int index) const;
+    int virtualRepositoryChannel(const QString &repositoryId) const;
+    QString virtualSource(int index, const QString &distro, const QString &component) const;
+
+private:
+    static QList<RepositoryChannel> defaultChannels();
+
+    QList<RepositoryChannel> m_channels;
+    QRegularExpression m_regExp;
+    QVector<int> m_groups;
+};
+
+#endif // REPOSITORYCHANNELMATCHER_H
@@ -0,0 +1,640 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "repositoryfilemanager.h"
+
+#include <QFile>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QSet>
+#include <QTimer>
+
+#include "loggingcategories.h"
+
+// One-line option names and their deb822 field names, see sources.list(5)
+static const QList<QPair<QString, QString>> s_optionNames = {
+    {"arch", "Architectures"},
+    {"lang", "Languages"},
+    {"target", "Targets"},
+    {"pdiffs", "PDiffs"},
+    {"by-hash", "By-Hash"},
+    {"allow-insecure", "Allow-Insecure"},
+    {"trusted", "Trusted"},
+    {"signed-by", "Signed-By"}
+};
+
+RepositoryFileManager::RepositoryFileManager(const QString &fileName, QObject *parent):
+    QObject(parent),
+    m_fileName(fileName)
+{
+    m_timeoutTimer = new QTimer(this);
+    m_timeoutTimer->setSingleShot(true);
+    m_timeoutTimer->setInterval(10 * 60 * 1000);
+    connect(m_timeoutTimer, &QTimer::timeout, this, [this](){
+        if (m_process) {
+            qCWarning(dcPlatformUpdate()) << "Refreshing" << m_fileName << "timed out.";
+            m_process->kill();
+        }
+    });
+}
+
+QString RepositoryFileManager::fileName() const
+{
+    return m_fileName;
+}
+
+bool RepositoryFileManager::isDeb822() const
+{
+    return m_fileName.endsWith(".sources");
+}
+
+bool RepositoryFileManager::addSource(const QString &source, bool *changed)
+{
+    if (changed) {
+        *changed = false;
+    }
+    Entry entry = parseLine(source);
+    if (!entry.isValid()) {
+        qCWarning(dcPlatformUpdate()) << "Not adding invalid repository source" << source;
+        return false;
+    }
+
+    bool ok;
+    QList<Block> blocks = readBlocks(&ok);
+    if (!ok) {
+        return false;
+    }
+    bool modified = deduplicate(&blocks);
+
+    // An enabled copy wins, otherwise the first disabled one gets enabled
+    int foundBlock = -1;
+    int foundEntry = -1;
+    for (int i = 0; i < blocks.count(); i++) {
+        for (int j = 0; j < blocks.at(i).entries.count(); j++) {
+            const Entry &existing = blocks.at(i).entries.at(j);
+            if (existing.matches(entry) && (foundBlock < 0 || (existing.enabled && !blocks.at(foundBlock).entries.at(foundEntry).enabled))) {
+                foundBlock = i;
+                foundEntry = j;
+            }
+        }
+    }
+    bool found = foundBlock >= 0;
+    if (found && !blocks.at(foundBlock).entries.at(foundEntry).enabled) {
+        blocks[foundBlock].entries[foundEntry].enabled = true;
+        blocks[foundBlock].dirty = true;
+        modified = true;
+    }
+    if (!found) {
+        Block block;
+        block.entries.append(entry);
+        block.dirty = true;
+        blocks.append(block);
+        modified = true;
+    }
+
+    if (!modified) {
+        qCDebug(dcPlatformUpdate()) << "Repository" << source << "already in" << m_fileName;
+        return true;
+    }
+    if (!writeBlocks(blocks)) {
+        return false;
+    }
+    if (changed) {
+        *changed = true;
+    }
+    qCDebug(dcPlatformUpdate()) << "Added repository" << source << "to" << m_fileName;
+    return true;
+}
+
+bool RepositoryFileManager::removeSource(const QString &source, bool *changed)
+{
+    if (changed) {
+        *changed = false;
+    }
+    Entry entry = parseLine(source);
+    if (!entry.isValid()) {
+        qCWarning(dcPlatformUpdate()) << "Not removing invalid repository source" << source;
+        return false;
+    }
+
+    bool ok;
+    QList<Block> blocks = readBlocks(&ok);
+    if (!ok) {
+        return false;
+    }
+    bool modified = deduplicate(&blocks);
+
+    for (int i = blocks.count() - 1; i >= 0; i--) {
+        Block &block = blocks[i];
+        if (block.entries.isEmpty()) {
+            continue;
+        }
+        for (int j = block.entries.count() - 1; j >= 0; j--) {
+            if (block.entries.at(j).matches(entry)) {
+                block.entries.removeAt(j);
+                block.dirty = true;
+                modified = true;
+            }
+        }
+        if (block.entries.isEmpty()) {
+            blocks.removeAt(i);
+        }
+    }
+
+    if (!modified) {
+        return true;
+    }
+    if (!writeBlocks(blocks)) {
+        return false;
+    }
+    if (changed) {
+        *changed = true;
+    }
+    qCDebug(dcPlatformUpdate()) << "Removed repository" << source << "from" << m_fileName;
+    return true;
+}
+
+bool RepositoryFileManager::refreshSources()
+{
+    if (m_process) {
+        qCDebug(dcPlatformUpdate()) << "Refresh of" << m_fileName << "already running.";
+        return false;
+    }
+    if (!QFile::exists(m_fileName)) {
+        qCWarning(dcPlatformUpdate()) << "Cannot refresh" << m_fileName << "as it doesn't exist.";
+        return false;
+    }
+
+    // Only this file, no sources.list.d, and don't delete the indices of all other repositories
+    QStringList arguments;
+    arguments << "update";
+    arguments << "-o" << "Dir::Etc::sourcelist=" + m_fileName;
+    arguments << "-o" << "Dir::Etc::sourceparts=-";
+    arguments << "-o" << "APT::Get::List-Cleanup=0";
+
+    m_process = new QProcess(this);
+    m_process->setProcessChannelMode(QProcess::MergedChannels);
+    connect(m_process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error){
+        // All other errors are followed by finished()
+        if (error == QProcess::FailedToStart) {
+            qCWarning(dcPlatformUpdate()) << "Failed to start apt-get to refresh" << m_fileName << m_process->errorString();
+            m_timeoutTimer->stop();
+            m_process->deleteLater();
+            emit refreshFinished(false);
+        }
+    });
+    connect(m_process, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished), this, [this](int exitCode, QProcess::ExitStatus exitStatus){
+        m_timeoutTimer->stop();
+        bool success = exitStatus == QProcess::NormalExit && exitCode == 0;
+        if (success) {
+            qCDebug(dcPlatformUpdate()) << "Refreshed package indices of" << m_fileName;
+        } else {
+            qCWarning(dcPlatformUpdate()) << "Refreshing" << m_fileName << "failed:" << m_process->readAll();
+        }
+        m_process->deleteLater();
+        emit refreshFinished(success);
+    });
+
+    qCDebug(dcPlatformUpdate()) << "Refreshing package indices of" << m_fileName;
+    m_timeoutTimer->start();
+    m_process->start("apt-get", arguments);
+    return true;
+}
+
+bool RepositoryFileManager::Entry::isValid() const
+{
+    return (type == "deb" || type == "deb-src") && !uri.isEmpty() && !suite.isEmpty();
+}
+
+QString RepositoryFileManager::Entry::location() const
+{
+    QString normalizedUri = uri;
+    while (normalizedUri.endsWith('/')) {
+        normalizedUri.chop(1);
+    }
+    QStringList sortedComponents = components;
+    sortedComponents.sort();
+    return QStringList({type, normalizedUri, suite, sortedComponents.join(' ')}).join('|');
+}
+
+QString RepositoryFileManager::Entry::key() const
+{
+    // Field names are case insensitive, the order of multiple values doesn't matter
+    QStringList normalizedOptions;
+    for (QMap<QString, QString>::const_iterator it = options.constBegin(); it != options.constEnd(); ++it) {
+        QStringList values = it.value().simplified().split(' ');
+        values.sort();
+        normalizedOptions.append(it.key().toLower() + "=" + values.join(' '));
+    }
+    normalizedOptions.sort();
+    return location() + "|" + normalizedOptions.join(' ');
+}
+
+bool RepositoryFileManager::Entry::matches(const Entry &source) const
+{
+    return source.options.isEmpty() ? location() == source.location() : key() == source.key();
+}
+
+QList<RepositoryFileManager::Block> RepositoryFileManager::readBlocks(bool *ok) const
+{
+    *ok = true;
+    QList<Block> blocks;
+    QFile file(m_fileName);
+    if (!file.exists()) {
+        return blocks;
+    }
+    if (!file.open(QFile::ReadOnly | QFile::Text)) {
+        qCWarning(dcPlatformUpdate()) << "Failed to open" << m_fileName << file.errorString();
+        *ok = false;
+        return blocks;
+    }
+    QString content = QString::fromUtf8(file.readAll());
+
+    if (isDeb822()) {
+        QStringList stanza;
+        foreach (const QString &line, content.split('\n')) {
+            if (!line.trimmed().isEmpty()) {
+                stanza.append(line);
+                continue;
+            }
+            if (!stanza.isEmpty()) {
+                Block block;
+                block.raw = stanza.join('\n');
+                block.entries = parseStanza(block.raw);
+                blocks.append(block);
+                stanza.clear();
+            }
+        }
+        if (!stanza.isEmpty()) {
+            Block block;
+            block.raw = stanza.join('\n');
+            block.entries = parseStanza(block.raw);
+            blocks.append(block);
+        }
+    } else {
+        foreach (const QString &line, content.split('\n')) {
+            Block block;
+            block.raw = line;
+            Entry entry = parseLine(line);
+            if (!entry.isValid() && line.trimmed().startsWith('#')) {
+                // A commented out entry is a disabled repository. Prose comments don't have a URI with a scheme.
+                entry = parseLine(line.trimmed().mid(1));
+                entry.enabled = false;
+                if (!entry.uri.contains(':')) {
+                    entry = Entry();
+                }
+            }
+            if (entry.isValid()) {
+                block.entries.append(entry);
+            }
+            blocks.append(block);
+        }
+        // The trailing newline is added again when writing
+        while (!blocks.isEmpty() && blocks.last().raw.trimmed().isEmpty()) {
+            blocks.removeLast();
+        }
+    }
+    return blocks;
+}
+
+bool RepositoryFileManager::writeBlocks(const QList<Block> &blocks) const
+{
+    QStringList parts;
+    foreach (const Block &block, blocks) {
+        parts.append(serialize(block));
+    }
+    QString content = parts.join(isDeb822() ? "\n\n" : "\n");
+    if (!content.isEmpty()) {
+        content.append('\n');
+    }
+
+    // Written to a temporary file in the same directory and renamed over the original
+    QSaveFile file(m_fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Text)) {
+        qCWarning(dcPlatformUpdate()) << "Failed to open" << m_fileName << "for writing:" << file.errorString();
+        return false;
+    }
+    file.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ReadGroup | QFile::ReadOther);
+    QByteArray data = content.toUtf8();
+    if (file.write(data) != data.length() || !file.commit()) {
+        qCWarning(dcPlatformUpdate()) << "Failed to write" << m_fileName << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool RepositoryFileManager::deduplicate(QList<Block> *blocks)
+{
+    // Keep the first enabled copy of every entry, or the first one if all copies are disabled
+    QHash<QString, QPair<int, int> > kept; // <key, <block, entry>>
+    for (int i = 0; i < blocks->count(); i++) {
+        for (int j = 0; j < blocks->at(i).entries.count(); j++) {
+            const Entry &entry = blocks->at(i).entries.at(j);
+            QHash<QString, QPair<int, int> >::iterator keeper = kept.find(entry.key());
+            if (keeper == kept.end()) {
+                kept.insert(entry.key(), qMakePair(i, j));
+            } else if (entry.enabled && !blocks->at(keeper->first).entries.at(keeper->second).enabled) {
+                *keeper = qMakePair(i, j);
+            }
+        }
+    }
+
+    bool modified = false;
+    for (int i = blocks->count() - 1; i >= 0; i--) {
+        Block &block = (*blocks)[i];
+        if (block.entries.isEmpty()) {
+            continue;
+        }
+        for (int j = block.entries.count() - 1; j >= 0; j--) {
+            if (kept.value(block.entries.at(j).key()) != qMakePair(i, j)) {
+                qCDebug(dcPlatformUpdate()) << "Dropping duplicate repository" << serializeLine(block.entries.at(j));
+                block.entries.removeAt(j);
+                block.dirty = true;
+                modified = true;
+            }
+        }
+        if (block.entries.isEmpty()) {
+            blocks->removeAt(i);
+        }
+    }
+    return modified;
+}
+
+RepositoryFileManager::Entry RepositoryFileManager::parseLine(const QString &line)
+{
+    Entry entry;
+    QString content = line.section('#', 0, 0).trimmed();
+    if (content.isEmpty()) {
+        return entry;
+    }
+
+    int typeEnd = content.indexOf(QRegularExpression("\\s"));
+    if (typeEnd < 0) {
+        return entry;
+    }
+    entry.type = content.left(typeEnd);
+    content = content.mid(typeEnd).trimmed();
+
+    if (content.startsWith('[')) {
+        int optionsEnd = content.indexOf(']');
+        if (optionsEnd < 0) {
+            return Entry();
+        }
+        QStringList options = content.mid(1, optionsEnd - 1).split(' ');
+        options.removeAll(QString());
+        foreach (const QString &option, options) {
+            QString name = option.section('=', 0, 0);
+            QString value = option.section('=', 1);
+            QString fieldName = name;
+            for (int i = 0; i < s_optionNames.count(); i++) {
+                if (s_optionNames.at(i).first == name) {
+                    fieldName = s_optionNames.at(i).second;
+                }
+            }
+            entry.options.insert(fieldName, value.replace(',', ' '));
+        }
+        content = content.mid(optionsEnd + 1);
+    }
+
+    QStringList parts = content.trimmed().split(QRegularExpression("\\s+"));
+    parts.removeAll(QString());
+    if (parts.count() < 2) {
+        return Entry();
+    }
+    entry.uri = parts.takeFirst();
+    entry.suite = parts.takeFirst();
+    entry.components = parts;
+    return entry;
+}
+
+QList<RepositoryFileManager::Entry> RepositoryFileManager::parseStanza(const QString &stanza)
+{
+    QList<QPair<QString, QString>> fields;
+    foreach (const QString &line, stanza.split('\n')) {
+        if (line.startsWith('#')) {
+            continue;
+        }
+        if ((line.startsWith(' ') || line.startsWith('\t')) && !fields.isEmpty()) {
+            fields.last().second.append('\n' + line);
+            continue;
+        }
+        int colon = line.indexOf(':');
+        if (colon > 0) {
+            fields.append(qMakePair(line.left(colon).trimmed(), line.mid(colon + 1).trimmed()));
+        }
+    }
+
+    QStringList types, uris, suites, components;
+    Entry base;
+    for (int i = 0; i < fields.count(); i++) {
+        QString name = fields.at(i).first.toLower();
+        QStringList values = fields.at(i).second.split(QRegularExpression("\\s+"));
+        values.removeAll(QString());
+        if (name == "types") {
+            types = values;
+        } else if (name == "uris") {
+            uris = values;
+        } else if (name == "suites") {
+            suites = values;
+        } else if (name == "components") {
+            components = values;
+        } else if (name == "enabled") {
+            base.enabled = fields.at(i).second.trimmed().toLower() != "no";
+        } else {
+            base.options.insert(fields.at(i).first, fields.at(i).second);
+        }
+    }
+
+    QList<Entry> entries;
+    foreach (const QString &type, types) {
+        foreach (const QString &uri, uris) {
+            foreach (const QString &suite, suites) {
+                Entry entry = base;
+                entry.type = type;
+                entry.uri = uri;
+                entry.suite = suite;
+                entry.components = components;
+                entries.append(entry);
+            }
+        }
+    }
+    return entries;
+}
+
+QString RepositoryFileManager::serialize(const Block &block) const
+{
+    if (!block.dirty) {
+        return block.raw;
+    }
+    if (isDeb822() && !block.raw.isEmpty()) {
+        // Entries of a stanza share everything but type, URI and suite (and the enabled state once one of
+        // them got enabled). The stanza is only split where what's left isn't a product of those any more.
+        QList<QList<Entry> > stanzas;
+        foreach (const Entry &entry, block.entries) {
+            bool grouped = false;
+            for (int i = 0; i < stanzas.count() && !grouped; i++) {
+                const Entry &first = stanzas.at(i).first();
+                if (first.enabled == entry.enabled && first.type == entry.type && first.uri == entry.uri) {
+                    stanzas[i].append(entry);
+                    grouped = true;
+                }
+            }
+            if (!grouped) {
+                stanzas.append(QList<Entry>({entry}));
+            }
+        }
+        mergeStanzas(&stanzas, &Entry::uri);
+        mergeStanzas(&stanzas, &Entry::type);
+        QStringList parts;
+        for (int i = 0; i < stanzas.count(); i++) {
+            parts.append(rewriteStanza(block.raw, stanzas.at(i), i == 0));
+        }
+        return parts.join("\n\n");
+    }
+    QStringList parts;
+    foreach (const Entry &entry, block.entries) {
+        parts.append(isDeb822() ? serializeStanza(entry) : serializeLine(entry));
+    }
+    return parts.join(isDeb822() ? "\n\n" : "\n");
+}
+
+QString RepositoryFileManager::serializeLine(const Entry &entry)
+{
+    QStringList parts;
+    parts.append(entry.type);
+    if (!entry.options.isEmpty()) {
+        QStringList options;
+        for (QMap<QString, QString>::const_iterator it = entry.options.constBegin(); it != entry.options.constEnd(); ++it) {
+            QString name = it.key();
+            for (int i = 0; i < s_optionNames.count(); i++) {
+                if (s_optionNames.at(i).second == it.key()) {
+                    name = s_optionNames.at(i).first;
+                }
+            }
+            options.append(name + "=" + QString(it.value()).replace(' ', ','));
+        }
+        parts.append("[" + options.join(' ') + "]");
+    }
+    parts.append(entry.uri);
+    parts.append(entry.suite);
+    parts.append(entry.components);
+    QString line = parts.join(' ');
+    return entry.enabled ? line : "# " + line;
+}
+
+QString RepositoryFileManager::serializeStanza(const Entry &entry)
+{
+    QStringList lines;
+    lines.append("Types: " + entry.type);
+    lines.append("URIs: " + entry.uri);
+    lines.append("Suites: " + entry.suite);
+    if (!entry.components.isEmpty()) {
+        lines.append("Components: " + entry.components.join(' '));
+    }
+    if (!entry.enabled) {
+        lines.append("Enabled: no");
+    }
+    for (QMap<QString, QString>::const_iterator it = entry.options.constBegin(); it != entry.options.constEnd(); ++it) {
+        // A multi-line value may start on the line after the field name
+        lines.append(it.key() + (it.value().startsWith('\n') ? ":" : ": ") + it.value());
+    }
+    return lines.join('\n');
+}
+
+QStringList RepositoryFileManager::distinctValues(const QList<Entry> &entries, QString Entry::*field)
+{
+    QStringList values;
+    foreach (const Entry &entry, entries) {
+        if (!values.contains(entry.*field)) {
+            values.append(entry.*field);
+        }
+    }
+    return values;
+}
+
+void RepositoryFileManager::mergeStanzas(QList<QList<Entry> > *stanzas, QString Entry::*axis)
+{
+    // Two stanzas which only differ along axis can be written as one
+    QList<QString Entry::*> fields({&Entry::type, &Entry::uri, &Entry::suite});
+    fields.removeAll(axis);
+    for (int i = 0; i < stanzas->count(); i++) {
+        for (int j = stanzas->count() - 1; j > i; j--) {
+            bool mergeable = stanzas->at(i).first().enabled == stanzas->at(j).first().enabled;
+            foreach (QString Entry::*field, fields) {
+                mergeable &= distinctValues(stanzas->at(i), field) == distinctValues(stanzas->at(j), field);
+            }
+            if (mergeable) {
+                (*stanzas)[i].append(stanzas->takeAt(j));
+            }
+        }
+    }
+}
+
+QString RepositoryFileManager::rewriteStanza(const QString &stanza, const QList<Entry> &entries, bool keepComments)
+{
+    // entries share the options and enabled state and cover all combinations of their types, URIs and suites
+    QMap<QString, QString> values; // <lower case field name, value>, empty to drop the field
+    values.insert("types", distinctValues(entries, &Entry::type).join(' '));
+    values.insert("uris", distinctValues(entries, &Entry::uri).join(' '));
+    values.insert("suites", distinctValues(entries, &Entry::suite).join(' '));
+    values.insert("enabled", entries.first().enabled ? QString() : QString("no"));
+
+    QStringList lines;
+    QSet<QString> written;
+    bool skipContinuation = false;
+    foreach (const QString &line, stanza.split('\n')) {
+        if (line.startsWith('#')) {
+            if (keepComments) {
+                lines.append(line);
+            }
+            continue;
+        }
+        if (line.startsWith(' ') || line.startsWith('\t')) {
+            if (!skipContinuation) {
+                lines.append(line);
+            }
+            continue;
+        }
+        skipContinuation = false;
+        int colon = line.indexOf(':');
+        QString name = line.left(colon).trimmed();
+        if (colon <= 0 || !values.contains(name.toLower())) {
+            lines.append(line);
+            continue;
+        }
+        // Only the values of these fields are replaced, the line keeps its place and the field name its spelling
+        skipContinuation = true;
+        written.insert(name.toLower());
+        QString value = values.value(name.toLower());
+        if (!value.isEmpty()) {
+            lines.append(name + ": " + value);
+        }
+    }
+    if (!written.contains("enabled") && !values.value("enabled").isEmpty()) {
+        lines.append("Enabled: " + values.value("enabled"));
+    }
+    return lines.join('\n');
+}
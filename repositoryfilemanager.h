@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef REPOSITORYFILEMANAGER_H
+#define REPOSITORYFILEMANAGER_H
+
+#include <QObject>
+#include <QMap>
+#include <QStringList>
+#include <QPointer>
+
+class QProcess;
+class QTimer;
+
+// Manages the APT sources file owned by nymea (one-line .list or deb822 .sources format).
+//
+// Changes parse the whole file, drop duplicate entries and write it back atomically, so
+// repeated additions don't make it grow. refreshSources() fetches the indices of this file
+// only, instead of updating every repository on the system.
+class RepositoryFileManager : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RepositoryFileManager(const QString &fileName, QObject *parent = nullptr);
+
+    QString fileName() const;
+    bool isDeb822() const;
+
+    // source is a one-line entry, e.g. "deb http://repository.nymea.io/landing jammy main".
+    // changed is set to false if the file already was in the requested state.
+    bool addSource(const QString &source, bool *changed = nullptr);
+    bool removeSource(const QString &source, bool *changed = nullptr);
+
+    // Runs "apt-get update" restricted to this file. Emits refreshFinished() when done.
+    bool refreshSources();
+
+signals:
+    void refreshFinished(bool success);
+
+private:
+    class Entry {
+    public:
+        bool enabled = true;
+        QString type;
+        QString uri;
+        QString suite;
+        QStringList components;
+        // Keyed by deb822 field name, e.g. "Signed-By". Continuation lines of multi-line
+        // deb822 fields (e.g. an inline Signed-By key) are kept verbatim, including the newlines.
+        QMap<QString, QString> options;
+
+        bool isValid() const;
+        // Type, URI, suite and components, which identify the repository
+        QString location() const;
+        // The location plus the options. Entries with the same key are duplicates.
+        QString key() const;
+        // A requested source without options stands for the repository with any options
+        bool matches(const Entry &source) const;
+    };
+
+    // A line (.list) or stanza (.sources) of the file. Blocks which haven't been modified
+    // are written back verbatim to keep comments and formatting. Modified stanzas only get
+    // the fields rewritten which describe their entries.
+    class Block {
+    public:
+        QString raw;
+        QList<Entry> entries;
+        bool dirty = false;
+    };
+
+    QList<Block> readBlocks(bool *ok) const;
+    bool writeBlocks(const QList<Block> &blocks) const;
+    static bool deduplicate(QList<Block> *blocks);
+
+    static Entry parseLine(const QString &line);
+    static QList<Entry> parseStanza(const QString &stanza);
+    QString serialize(const Block &block) const;
+    static QString serializeLine(const Entry &entry);
+    static QString serializeStanza(const Entry &entry);
+    static QStringList distinctValues(const QList<Entry> &entries, QString Entry::*field);
+    static void mergeStanzas(QList<QList<Entry> > *stanzas, QString Entry::*axis);
+    static QString rewriteStanza(const QString &stanza, const QList<Entry> &entries, bool keepComments);
+
+    QString m_fileName;
+    QPointer<QProcess> m_process;
+    QTimer *m_timeoutTimer = nullptr;
+};
+
+#endif // REPOSITORYFILEMANAGER_H
@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "repositorystore.h"
+
+quint64 RepositoryStore::generation() const
+{
+    return m_generation;
+}
+
+int RepositoryStore::count() const
+{
+    return m_repositories.count();
+}
+
+bool RepositoryStore::contains(const QString &repositoryId) const
+{
+    return m_repositories.contains(repositoryId);
+}
+
+Repository RepositoryStore::repository(const QString &repositoryId) const
+{
+    return m_repositories.value(repositoryId);
+}
+
+QStringList RepositoryStore::repositoryIds() const
+{
+    return m_repositories.keys();
+}
+
+QList<Repository> RepositoryStore::repositories() const
+{
+    if (!m_snapshotValid) {
+        m_snapshot = m_repositories.values();
+        m_snapshotValid = true;
+    }
+    return m_snapshot;
+}
+
+void RepositoryStore::insert(const Repository &repository)
+{
+    m_repositories.insert(repository.id(), repository);
+    invalidate();
+}
+
+bool RepositoryStore::remove(const QString &repositoryId)
+{
+    if (m_repositories.remove(repositoryId) == 0) {
+        return false;
+    }
+    invalidate();
+    return true;
+}
+
+bool RepositoryStore::setEnabled(const QString &repositoryId, bool enabled)
+{
+    QHash<QString, Repository>::iterator it = m_repositories.find(repositoryId);
+    if (it == m_repositories.end()) {
+        return false;
+    }
+    it->setEnabled(enabled);
+    invalidate();
+    return true;
+}
+
+void RepositoryStore::invalidate()
+{
+    m_generation++;
+    m_snapshotValid = false;
+    m_snapshot.clear();
+}
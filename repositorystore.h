@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef REPOSITORYSTORE_H
+#define REPOSITORYSTORE_H
+
+#include <QHash>
+#include <QList>
+#include <QStringList>
+
+#include "platform/repository.h"
+
+// The known repositories, keyed by ID. Like PackageStore it bumps a generation on every
+// modification and hands out a shared snapshot which is only rebuilt after a change.
+class RepositoryStore
+{
+public:
+    quint64 generation() const;
+
+    int count() const;
+    bool contains(const QString &repositoryId) const;
+    Repository repository(const QString &repositoryId) const;
+    QStringList repositoryIds() const;
+    QList<Repository> repositories() const;
+
+    void insert(const Repository &repository);
+    bool remove(const QString &repositoryId);
+    bool setEnabled(const QString &repositoryId, bool enabled);
+
+private:
+    void invalidate();
+
+    QHash<QString, Repository> m_repositories;
+    quint64 m_generation = 0;
+    mutable QList<Repository> m_snapshot;
+    mutable bool m_snapshotValid = true;
+};
+
+#endif // REPOSITORYSTORE_H
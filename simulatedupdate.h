@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef SIMULATEDUPDATE_H
+#define SIMULATEDUPDATE_H
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+
+#include <Transaction>
+
+// The outcome of a simulated update of all managed updates: every package the transaction would
+// touch, including pulled in dependencies and removals, and what it would cost.
+class SimulatedUpdate
+{
+public:
+    bool valid = false;
+    // Package store generation the simulation was based on
+    quint64 generation = 0;
+
+    // The update IDs the simulation was run for, <packageName, packageId>
+    QHash<QString, QString> updateIds;
+    // Everything the transaction would touch, <packageId, info>
+    QHash<QString, PackageKit::Transaction::Info> packages;
+    // The currently installed versions of the upgraded packages
+    QSet<QString> replacedIds;
+
+    // -1 if the backend doesn't report the download size of every package
+    qlonglong downloadSize = 0;
+    // Installed size of new and upgraded packages minus that of removed and replaced ones
+    qlonglong installedSizeDelta = 0;
+};
+
+#endif // SIMULATEDUPDATE_H
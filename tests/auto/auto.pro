@@ -0,0 +1,13 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    cacherefreshpolicy \
+    debcontrolreader \
+    nativecomparison \
+    nativepackagereader \
+    packageid \
+    packagesnapshot \
+    packagestore \
+    repositoryfilemanager \
+    transactiongraph \
+    updateretrypolicy
@@ -0,0 +1,7 @@
+include(../../testcommon.pri)
+
+TARGET = testcacherefreshpolicy
+
+SOURCES += \
+    testcacherefreshpolicy.cpp \
+    $$PLUGIN_SOURCE_DIR/cacherefreshpolicy.cpp
@@ -0,0 +1,206 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include <QtTest>
+#include <QSettings>
+
+#include <utime.h>
+
+#include "cacherefreshpolicy.h"
+
+class TestCacheRefreshPolicy: public QObject
+{
+    Q_OBJECT
+
+private:
+    void load(CacheRefreshPolicy *policy, const QVariantMap &values);
+
+private slots:
+    void init();
+
+    void adaptiveInterval();
+    void backoff();
+    void jitter();
+    void bounds();
+    void forceRefresh();
+    void forceRefreshUnknownAge();
+
+private:
+    QScopedPointer<QTemporaryDir> m_dir;
+};
+
+void TestCacheRefreshPolicy::load(CacheRefreshPolicy *policy, const QVariantMap &values)
+{
+    QSettings settings(m_dir->filePath("updatepluginpackagekit.conf"), QSettings::IniFormat);
+    settings.beginGroup("CacheRefresh");
+    settings.setValue("listsDirectory", m_dir->filePath("lists"));
+    settings.setValue("jitter", 0);
+    for (QVariantMap::const_iterator it = values.constBegin(); it != values.constEnd(); ++it) {
+        settings.setValue(it.key(), it.value());
+    }
+    settings.endGroup();
+    policy->load(settings);
+}
+
+void TestCacheRefreshPolicy::init()
+{
+    m_dir.reset(new QTemporaryDir);
+    QVERIFY(m_dir->isValid());
+    QVERIFY(QDir(m_dir->path()).mkdir("lists"));
+}
+
+void TestCacheRefreshPolicy::adaptiveInterval()
+{
+    QVariantMap values;
+    values.insert("minimumInterval", 3600);
+    values.insert("maximumInterval", 24 * 3600);
+    values.insert("interval", 6 * 3600);
+    CacheRefreshPolicy policy;
+    load(&policy, values);
+
+    QCOMPARE(policy.interval(), Q_INT64_C(21600));
+    QCOMPARE(policy.nextDelay(), Q_INT64_C(21600000));
+
+    // New updates make us look more often...
+    policy.refreshSucceeded(true);
+    QCOMPARE(policy.interval(), Q_INT64_C(10800));
+    policy.refreshSucceeded(true);
+    QCOMPARE(policy.interval(), Q_INT64_C(5400));
+    policy.refreshSucceeded(true);
+    QCOMPARE(policy.interval(), Q_INT64_C(3600));
+    policy.refreshSucceeded(true);
+    QCOMPARE(policy.interval(), Q_INT64_C(3600));
+    QCOMPARE(policy.nextDelay(), Q_INT64_C(3600000));
+
+    // ...and quiet periods less often
+    policy.refreshSucceeded(false);
+    QCOMPARE(policy.interval(), Q_INT64_C(5400));
+    for (int i = 0; i < 20; i++) {
+        policy.refreshSucceeded(false);
+    }
+    QCOMPARE(policy.interval(), Q_INT64_C(86400));
+}
+
+void TestCacheRefreshPolicy::backoff()
+{
+    QVariantMap values;
+    values.insert("interval", 3600);
+    values.insert("retryInterval", 300);
+    CacheRefreshPolicy policy;
+    load(&policy, values);
+
+    policy.refreshFailed();
+    QCOMPARE(policy.nextDelay(), Q_INT64_C(300000));
+    policy.refreshFailed();
+    QCOMPARE(policy.nextDelay(), Q_INT64_C(600000));
+    policy.refreshFailed();
+    QCOMPARE(policy.nextDelay(), Q_INT64_C(1200000));
+    // Never later than the regular refresh
+    for (int i = 0; i < 40; i++) {
+        policy.refreshFailed();
+    }
+    QCOMPARE(policy.nextDelay(), Q_INT64_C(3600000));
+
+    // A failure doesn't change the interval, a success ends the backoff
+    QCOMPARE(policy.interval(), Q_INT64_C(3600));
+    policy.refreshSucceeded(false);
+    QCOMPARE(policy.nextDelay(), Q_INT64_C(5400000));
+}
+
+void TestCacheRefreshPolicy::jitter()
+{
+    QVariantMap values;
+    values.insert("interval", 3600);
+    values.insert("jitter", 0.5);
+    CacheRefreshPolicy policy;
+    load(&policy, values);
+
+    qint64 delay = policy.nextDelay();
+    QVERIFY2(delay >= 1800000 && delay <= 5400000, QByteArray::number(delay));
+    // Stable per device
+    QCOMPARE(policy.nextDelay(), delay);
+}
+
+void TestCacheRefreshPolicy::bounds()
+{
+    QVariantMap values;
+    values.insert("minimumInterval", 1);
+    values.insert("maximumInterval", 30);
+    values.insert("interval", 1000000);
+    values.insert("retryInterval", 1);
+    values.insert("jitter", 3);
+    CacheRefreshPolicy policy;
+    load(&policy, values);
+
+    QCOMPARE(policy.interval(), Q_INT64_C(60));
+    qint64 delay = policy.nextDelay();
+    QVERIFY2(delay >= 30000 && delay <= 90000, QByteArray::number(delay));
+    policy.refreshFailed();
+    QCOMPARE(policy.nextDelay(), Q_INT64_C(10000));
+}
+
+void TestCacheRefreshPolicy::forceRefresh()
+{
+    QVariantMap values;
+    values.insert("maximumMetadataAge", 3600);
+    CacheRefreshPolicy policy;
+    load(&policy, values);
+
+    QCOMPARE(policy.listsDirectory(), m_dir->filePath("lists"));
+    QVERIFY(policy.metadataAge() >= 0);
+    QVERIFY(!policy.forceRefresh());
+
+    // Lists last updated two hours ago
+    QByteArray path = QFile::encodeName(m_dir->filePath("lists"));
+    struct utimbuf times;
+    times.actime = times.modtime = QDateTime::currentDateTime().addSecs(-7200).toSecsSinceEpoch();
+    QCOMPARE(utime(path.constData(), &times), 0);
+    QVERIFY(policy.metadataAge() >= 7200);
+    QVERIFY(policy.forceRefresh());
+
+    // A refresh which didn't change any list still counts
+    policy.refreshSucceeded(false);
+    QVERIFY(policy.metadataAge() < 3600);
+    QVERIFY(!policy.forceRefresh());
+}
+
+void TestCacheRefreshPolicy::forceRefreshUnknownAge()
+{
+    QVariantMap values;
+    values.insert("listsDirectory", m_dir->filePath("missing"));
+    CacheRefreshPolicy policy;
+    load(&policy, values);
+
+    QVERIFY(!policy.metadataTimestamp().isValid());
+    QCOMPARE(policy.metadataAge(), Q_INT64_C(-1));
+    QVERIFY(policy.forceRefresh());
+
+    policy.refreshSucceeded(false);
+    QVERIFY(policy.metadataAge() >= 0);
+    QVERIFY(!policy.forceRefresh());
+}
+
+QTEST_GUILESS_MAIN(TestCacheRefreshPolicy)
+#include "testcacherefreshpolicy.moc"
@@ -0,0 +1,7 @@
+include(../../testcommon.pri)
+
+TARGET = testdebcontrolreader
+
+SOURCES += \
+    testdebcontrolreader.cpp \
+    $$PLUGIN_SOURCE_DIR/debcontrolreader.cpp
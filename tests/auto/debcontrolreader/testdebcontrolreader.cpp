@@ -0,0 +1,141 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include <QtTest>
+
+#include "debcontrolreader.h"
+
+class TestDebControlReader: public QObject
+{
+    Q_OBJECT
+
+private:
+    QString writeFile(const QByteArray &content);
+
+private slots:
+    void init();
+
+    void stanzas();
+    void values();
+    void missingTrailingNewline();
+    void emptyFile();
+    void missingFile();
+
+private:
+    QScopedPointer<QTemporaryDir> m_dir;
+};
+
+QString TestDebControlReader::writeFile(const QByteArray &content)
+{
+    QString fileName = m_dir->filePath("status");
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly) || file.write(content) != content.size()) {
+        return QString();
+    }
+    return fileName;
+}
+
+void TestDebControlReader::init()
+{
+    m_dir.reset(new QTemporaryDir);
+    QVERIFY(m_dir->isValid());
+}
+
+void TestDebControlReader::stanzas()
+{
+    QString fileName = writeFile("Package: nymea\n"
+                                 "Status: install ok installed\n"
+                                 "Version: 1.0\n"
+                                 "\n"
+                                 "\n"
+                                 "Package: nymea-app\n"
+                                 "Version: 2.0\n"
+                                 "\n");
+    DebControlReader reader(fileName);
+    QVERIFY(reader.open());
+
+    QVERIFY(reader.readStanza());
+    QCOMPARE(reader.stanza(), QByteArray("Package: nymea\nStatus: install ok installed\nVersion: 1.0"));
+    QVERIFY(reader.readStanza());
+    QCOMPARE(reader.stanza(), QByteArray("Package: nymea-app\nVersion: 2.0"));
+    QVERIFY(!reader.readStanza());
+    QVERIFY(!reader.readStanza());
+}
+
+void TestDebControlReader::values()
+{
+    QString fileName = writeFile("Package: nymea\n"
+                                 "Package-Type: deb\n"
+                                 "Version:   1:1.0-1  \n"
+                                 "Description: IoT server\n"
+                                 " The long description\n"
+                                 " .\n"
+                                 " continues here.\n"
+                                 "Section: net\n");
+    DebControlReader reader(fileName);
+    QVERIFY(reader.open());
+    QVERIFY(reader.readStanza());
+
+    QCOMPARE(reader.value("Package"), QByteArray("nymea"));
+    QCOMPARE(reader.value("Package-Type"), QByteArray("deb"));
+    QCOMPARE(reader.value("Version"), QByteArray("1:1.0-1"));
+    // Only the first line of multi-line fields
+    QCOMPARE(reader.value("Description"), QByteArray("IoT server"));
+    // Continuation lines aren't fields
+    QCOMPARE(reader.value("Section"), QByteArray("net"));
+    QVERIFY(reader.value("continues here.").isEmpty());
+    QVERIFY(reader.value("Architecture").isEmpty());
+    QVERIFY(reader.value("Pack").isEmpty());
+}
+
+void TestDebControlReader::missingTrailingNewline()
+{
+    QString fileName = writeFile("Package: a\n\nPackage: b\nVersion: 1");
+    DebControlReader reader(fileName);
+    QVERIFY(reader.open());
+    QVERIFY(reader.readStanza());
+    QCOMPARE(reader.value("Package"), QByteArray("a"));
+    QVERIFY(reader.readStanza());
+    QCOMPARE(reader.value("Package"), QByteArray("b"));
+    QCOMPARE(reader.value("Version"), QByteArray("1"));
+    QVERIFY(!reader.readStanza());
+}
+
+void TestDebControlReader::emptyFile()
+{
+    DebControlReader reader(writeFile(QByteArray()));
+    QVERIFY(reader.open());
+    QVERIFY(!reader.readStanza());
+}
+
+void TestDebControlReader::missingFile()
+{
+    DebControlReader reader(m_dir->filePath("missing"));
+    QVERIFY(!reader.open());
+    QVERIFY(!reader.errorString().isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestDebControlReader)
+#include "testdebcontrolreader.moc"
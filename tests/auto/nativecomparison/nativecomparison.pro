@@ -0,0 +1,12 @@
+include(../../testcommon.pri)
+include(../../common/mockpackagekitbus.pri)
+include(../../../nymea-update-plugin-packagekit.pri)
+
+QT += network
+
+TARGET = testnativecomparison
+
+DEFINES += FIXTURES_DIR=\\\"$$PWD/fixtures\\\"
+
+SOURCES += \
+    testnativecomparison.cpp
@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include <QtTest>
+
+#include "mockpackagekitbus.h"
+#include "nativepackagereader.h"
+#include "nymeasettings.h"
+#include "updatecontrollerpackagekit.h"
+
+// Compares the native reader on the dpkg status and apt lists in fixtures/ with the package view the
+// plugin builds through PackageKit. This is a parser test against the mock: fixtures/packagekit.json
+// is hand written from the same status and lists files, following how the aptcc backend reports
+// packages, and served by the mock PackageKit daemon. No output of a real PackageKit is recorded, so
+// this doesn't prove the two views agree on a real system, only that both code paths read the same
+// data the same way.
+class TestNativeComparison: public QObject
+{
+    Q_OBJECT
+
+private:
+    static QStringList describe(const QHash<QString, Package> &packages);
+
+private slots:
+    void initTestCase();
+
+    void samePackages();
+
+private:
+    MockPackageKitBus m_bus;
+    QTemporaryDir m_dir;
+};
+
+QStringList TestNativeComparison::describe(const QHash<QString, Package> &packages)
+{
+    QStringList lines;
+    foreach (const Package &package, packages) {
+        lines.append(QString("%1 installed: %2 candidate: %3 update: %4 removable: %5")
+                     .arg(package.packageId(), package.installedVersion(), package.candidateVersion(),
+                          QString(package.updateAvailable() ? "yes" : "no"), QString(package.canRemove() ? "yes" : "no")));
+    }
+    lines.sort();
+    return lines;
+}
+
+void TestNativeComparison::initTestCase()
+{
+    QString errorString;
+    if (!m_bus.start(FIXTURES_DIR "/packagekit.json", &errorString)) {
+        QSKIP(qPrintable(errorString));
+    }
+
+    // Makes NymeaSettings use /tmp/nymea-test
+    QCoreApplication::setOrganizationName("nymea-test");
+    QVERIFY(m_dir.isValid());
+    QVERIFY(QDir().mkpath(NymeaSettings::settingsPath()));
+    QSettings settings(NymeaSettings::settingsPath() + "/updatepluginpackagekit.conf", QSettings::IniFormat);
+    settings.clear();
+    settings.setValue("PackageFilter/includePatterns", QStringList() << "nymea");
+    settings.setValue("PackageFilter/excludePatterns", QStringList() << "dbgsym");
+    settings.setValue("DpkgWatcher/enabled", false);
+    settings.setValue("NativeReader/enabled", false);
+    settings.setValue("UpdatePlan/enabled", false);
+    settings.setValue("RepositoryFiles/fileName", m_dir.filePath("nymea.list"));
+    settings.setValue("Snapshot/fileName", m_dir.filePath("updatepluginpackagekit.snapshot"));
+    settings.sync();
+    QCOMPARE(settings.status(), QSettings::NoError);
+}
+
+void TestNativeComparison::samePackages()
+{
+    QSettings settings(NymeaSettings::settingsPath() + "/updatepluginpackagekit.conf", QSettings::IniFormat);
+    NativePackageReader reader(FIXTURES_DIR "/status", FIXTURES_DIR "/lists");
+    reader.setFilter(PackageNameFilter::fromSettings(settings));
+    QHash<QString, Package> nativePackages;
+    PackageStringPool pool;
+    QVERIFY2(reader.read(&nativePackages, &pool), qPrintable(reader.errorString()));
+
+    // Without snapshot and native reader, the first packages are the result of a complete refresh
+    UpdateControllerPackageKit controller;
+    QTRY_VERIFY_WITH_TIMEOUT(!controller.packages().isEmpty(), 15000);
+    QHash<QString, Package> packageKitPackages;
+    foreach (const Package &package, controller.packages()) {
+        packageKitPackages.insert(package.packageId(), package);
+    }
+    QTRY_VERIFY_WITH_TIMEOUT(!controller.busy(), 15000);
+
+    // The fixtures cover managed, excluded, development, foreign, removed and unmanaged packages
+    QCOMPARE(nativePackages.count(), 5);
+    QVERIFY(nativePackages.contains("nymea-plugins-zigbee"));
+    QCOMPARE(nativePackages.value("nymea-plugins-zigbee").candidateVersion(), QString("1.11.0~rc1"));
+
+    // PackageKit's updates aren't filtered by the not-devel filter, so the plugin lists updates of
+    // development packages, even though it doesn't know their installed version. The native reader
+    // leaves them out like all other development packages, the first refresh adds them.
+    Package libnymeaDev = packageKitPackages.take("libnymea-dev");
+    QVERIFY(libnymeaDev.updateAvailable());
+    QCOMPARE(libnymeaDev.candidateVersion(), QString("1.10.0"));
+    QVERIFY(!nativePackages.contains("libnymea-dev"));
+
+    QCOMPARE(describe(packageKitPackages), describe(nativePackages));
+}
+
+QTEST_GUILESS_MAIN(TestNativeComparison)
+#include "testnativecomparison.moc"
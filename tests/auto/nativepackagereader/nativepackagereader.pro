@@ -0,0 +1,10 @@
+include(../../testcommon.pri)
+
+TARGET = testnativepackagereader
+
+SOURCES += \
+    testnativepackagereader.cpp \
+    $$PLUGIN_SOURCE_DIR/debcontrolreader.cpp \
+    $$PLUGIN_SOURCE_DIR/nativepackagereader.cpp \
+    $$PLUGIN_SOURCE_DIR/packageid.cpp \
+    $$PLUGIN_SOURCE_DIR/packagenamefilter.cpp
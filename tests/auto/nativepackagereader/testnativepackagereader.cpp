@@ -0,0 +1,216 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include <QtTest>
+
+#include "nativepackagereader.h"
+
+class TestNativePackageReader: public QObject
+{
+    Q_OBJECT
+
+private:
+    void writeFile(const QString &fileName, const QByteArray &content);
+
+private slots:
+    void init();
+
+    void compareVersions_data();
+    void compareVersions();
+
+    void installedAndCandidates();
+    void foreignArchitecture();
+    void foreignArchitectureFirst();
+    void developmentPackages();
+    void missingStatusFile();
+
+private:
+    QScopedPointer<QTemporaryDir> m_dir;
+};
+
+void TestNativePackageReader::writeFile(const QString &fileName, const QByteArray &content)
+{
+    QFile file(m_dir->filePath(fileName));
+    QVERIFY(file.open(QFile::WriteOnly));
+    QCOMPARE(file.write(content), content.size());
+}
+
+void TestNativePackageReader::init()
+{
+    m_dir.reset(new QTemporaryDir);
+    QVERIFY(m_dir->isValid());
+    QVERIFY(QDir(m_dir->path()).mkdir("lists"));
+}
+
+void TestNativePackageReader::compareVersions_data()
+{
+    QTest::addColumn<QByteArray>("a");
+    QTest::addColumn<QByteArray>("b");
+    QTest::addColumn<int>("result");
+
+    QTest::newRow("equal") << QByteArray("1.0") << QByteArray("1.0") << 0;
+    QTest::newRow("leading zeros") << QByteArray("1.01") << QByteArray("1.1") << 0;
+    QTest::newRow("numeric") << QByteArray("1.10") << QByteArray("1.9") << 1;
+    QTest::newRow("longer") << QByteArray("1.0.1") << QByteArray("1.0") << 1;
+    QTest::newRow("revision") << QByteArray("1.0-1") << QByteArray("1.0") << 1;
+    QTest::newRow("revision numeric") << QByteArray("1.0-10") << QByteArray("1.0-9") << 1;
+    QTest::newRow("hyphen in upstream") << QByteArray("1.0-2-3") << QByteArray("1.0-2-4") << -1;
+    QTest::newRow("epoch") << QByteArray("1:0.1") << QByteArray("2.0") << 1;
+    QTest::newRow("zero epoch") << QByteArray("0:1.0") << QByteArray("1.0") << 0;
+    QTest::newRow("tilde") << QByteArray("1.0~rc1") << QByteArray("1.0") << -1;
+    QTest::newRow("double tilde") << QByteArray("1.0~~") << QByteArray("1.0~") << -1;
+    QTest::newRow("tilde revision") << QByteArray("1.0-1~bpo1") << QByteArray("1.0-1") << -1;
+    QTest::newRow("letter") << QByteArray("1.0a") << QByteArray("1.0") << 1;
+    QTest::newRow("letters before others") << QByteArray("1.0a") << QByteArray("1.0+") << -1;
+    QTest::newRow("plus") << QByteArray("1.0+git1") << QByteArray("1.0") << 1;
+    QTest::newRow("ubuntu") << QByteArray("1.2.3-0ubuntu1") << QByteArray("1.2.3-0ubuntu0.1") << 1;
+}
+
+void TestNativePackageReader::compareVersions()
+{
+    QFETCH(QByteArray, a);
+    QFETCH(QByteArray, b);
+    QFETCH(int, result);
+
+    int forward = NativePackageReader::compareVersions(a, b);
+    int backward = NativePackageReader::compareVersions(b, a);
+    QCOMPARE(forward < 0 ? -1 : forward > 0 ? 1 : 0, result);
+    QCOMPARE(backward < 0 ? -1 : backward > 0 ? 1 : 0, -result);
+}
+
+void TestNativePackageReader::installedAndCandidates()
+{
+    writeFile("status",
+              "Package: dpkg\nStatus: install ok installed\nArchitecture: amd64\nVersion: 1.21\n\n"
+              "Package: nymea\nStatus: install ok installed\nArchitecture: amd64\nVersion: 1.0-1\nDescription: IoT server\n\n"
+              "Package: nymea-app\nStatus: install ok installed\nArchitecture: all\nVersion: 2.0\nDescription: App\n\n"
+              "Package: libnymea1\nStatus: deinstall ok config-files\nArchitecture: amd64\nVersion: 1.0-1\n\n"
+              "Package: bash\nStatus: install ok installed\nArchitecture: amd64\nVersion: 5.1\n");
+    writeFile("lists/repo_main_binary-amd64_Packages",
+              "Package: nymea\nArchitecture: amd64\nVersion: 1.1-1\n\n"
+              "Package: nymea\nArchitecture: amd64\nVersion: 1.0~rc1\n\n"
+              "Package: nymea-app\nArchitecture: all\nVersion: 2.0\n\n"
+              "Package: nymea-plugins\nArchitecture: amd64\nVersion: 3.0\nDescription: Plugins\n\n"
+              "Package: bash\nArchitecture: amd64\nVersion: 5.2\n");
+    // Candidates are merged across lists
+    writeFile("lists/other_main_binary-amd64_Packages",
+              "Package: nymea\nArchitecture: amd64\nVersion: 1.2-1\n");
+    // Not a Packages list
+    writeFile("lists/repo_InRelease", "Package: nymea\nVersion: 9.0\n");
+
+    NativePackageReader reader(m_dir->filePath("status"), m_dir->filePath("lists"));
+    QHash<QString, Package> packages;
+    PackageStringPool pool;
+    QVERIFY(reader.read(&packages, &pool));
+
+    QCOMPARE(packages.count(), 3);
+
+    Package nymea = packages.value("nymea");
+    QCOMPARE(nymea.installedVersion(), QString("1.0-1"));
+    QCOMPARE(nymea.candidateVersion(), QString("1.2-1"));
+    QCOMPARE(nymea.summary(), QString("IoT server"));
+    QVERIFY(nymea.updateAvailable());
+    QVERIFY(nymea.canRemove());
+
+    Package app = packages.value("nymea-app");
+    QCOMPARE(app.installedVersion(), QString("2.0"));
+    QCOMPARE(app.candidateVersion(), QString("2.0"));
+    QVERIFY(!app.updateAvailable());
+
+    Package plugins = packages.value("nymea-plugins");
+    QVERIFY(plugins.installedVersion().isEmpty());
+    QCOMPARE(plugins.candidateVersion(), QString("3.0"));
+    QCOMPARE(plugins.summary(), QString("Plugins"));
+    QVERIFY(!plugins.updateAvailable());
+    QVERIFY(!plugins.canRemove());
+
+    // Config files only isn't installed
+    QVERIFY(!packages.contains("libnymea1"));
+}
+
+void TestNativePackageReader::foreignArchitecture()
+{
+    writeFile("status",
+              "Package: dpkg\nStatus: install ok installed\nArchitecture: arm64\nVersion: 1.21\n\n"
+              "Package: nymea\nStatus: install ok installed\nArchitecture: arm64\nVersion: 1.0\n");
+    writeFile("lists/repo_main_binary-armhf_Packages",
+              "Package: nymea\nArchitecture: armhf\nVersion: 2.0\n");
+
+    NativePackageReader reader(m_dir->filePath("status"), m_dir->filePath("lists"));
+    QHash<QString, Package> packages;
+    PackageStringPool pool;
+    QVERIFY(reader.read(&packages, &pool));
+
+    QCOMPARE(packages.value("nymea").candidateVersion(), QString("1.0"));
+    QVERIFY(!packages.value("nymea").updateAvailable());
+}
+
+void TestNativePackageReader::foreignArchitectureFirst()
+{
+    // Sorted by name, both copies of bluez-nymea come before dpkg
+    writeFile("status",
+              "Package: bluez-nymea\nStatus: install ok installed\nArchitecture: i386\nVersion: 1.0\n\n"
+              "Package: bluez-nymea\nStatus: install ok installed\nArchitecture: amd64\nVersion: 2.0\n\n"
+              "Package: dpkg\nStatus: install ok installed\nArchitecture: amd64\nVersion: 1.21\n");
+
+    NativePackageReader reader(m_dir->filePath("status"), m_dir->filePath("lists"));
+    QHash<QString, Package> packages;
+    PackageStringPool pool;
+    QVERIFY(reader.read(&packages, &pool));
+
+    QCOMPARE(packages.value("bluez-nymea").installedVersion(), QString("2.0"));
+}
+
+void TestNativePackageReader::developmentPackages()
+{
+    writeFile("status",
+              "Package: dpkg\nStatus: install ok installed\nArchitecture: amd64\nVersion: 1.21\n\n"
+              "Package: libnymea-dev\nStatus: install ok installed\nArchitecture: amd64\nSection: libdevel\nVersion: 1.0\n\n"
+              "Package: nymea-sdk\nStatus: install ok installed\nArchitecture: amd64\nSection: contrib/devel\nVersion: 1.0\n\n"
+              "Package: nymea-dbg\nStatus: install ok installed\nArchitecture: amd64\nSection: debug\nVersion: 1.0\n\n"
+              "Package: nymea\nStatus: install ok installed\nArchitecture: amd64\nSection: net\nVersion: 1.0\n");
+    writeFile("lists/repo_main_binary-amd64_Packages",
+              "Package: nymea-qtcreator\nArchitecture: amd64\nSection: devel\nVersion: 1.0\n");
+
+    NativePackageReader reader(m_dir->filePath("status"), m_dir->filePath("lists"));
+    QHash<QString, Package> packages;
+    PackageStringPool pool;
+    QVERIFY(reader.read(&packages, &pool));
+
+    QCOMPARE(QStringList(packages.keys()), QStringList() << "nymea");
+}
+
+void TestNativePackageReader::missingStatusFile()
+{
+    NativePackageReader reader(m_dir->filePath("status"), m_dir->filePath("lists"));
+    QHash<QString, Package> packages;
+    PackageStringPool pool;
+    QVERIFY(!reader.read(&packages, &pool));
+    QVERIFY(!reader.errorString().isEmpty());
+    QVERIFY(packages.isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestNativePackageReader)
+#include "testnativepackagereader.moc"
@@ -0,0 +1,7 @@
+include(../../testcommon.pri)
+
+TARGET = testpackageid
+
+SOURCES += \
+    testpackageid.cpp \
+    $$PLUGIN_SOURCE_DIR/packageid.cpp
@@ -0,0 +1,165 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include <QtTest>
+
+#include <Daemon>
+
+#include "packageid.h"
+
+class TestPackageId: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void parse_data();
+    void parse();
+    void invalid_data();
+    void invalid();
+    void matchesDaemon_data();
+    void matchesDaemon();
+
+    void poolSharesStorage();
+    void poolAdoptsStorage();
+    void poolClear();
+};
+
+void TestPackageId::parse_data()
+{
+    QTest::addColumn<QString>("packageId");
+    QTest::addColumn<QString>("name");
+    QTest::addColumn<QString>("version");
+    QTest::addColumn<QString>("arch");
+    QTest::addColumn<QString>("data");
+
+    QTest::newRow("installed") << "nymea;1.9.0+202405;amd64;installed:ubuntu" << "nymea" << "1.9.0+202405" << "amd64" << "installed:ubuntu";
+    QTest::newRow("available") << "libnymea1;1:2.0-1;arm64;repository.nymea.io" << "libnymea1" << "1:2.0-1" << "arm64" << "repository.nymea.io";
+    QTest::newRow("empty fields") << "nymea-app;;;" << "nymea-app" << "" << "" << "";
+    QTest::newRow("separator in data") << "nymea;1.0;all;auto:a;b" << "nymea" << "1.0" << "all" << "auto:a;b";
+}
+
+void TestPackageId::parse()
+{
+    QFETCH(QString, packageId);
+    QFETCH(QString, name);
+    QFETCH(QString, version);
+    QFETCH(QString, arch);
+    QFETCH(QString, data);
+
+    PackageId parsed(packageId);
+    QVERIFY(parsed.isValid());
+    QCOMPARE(parsed.packageId(), packageId);
+    QCOMPARE(parsed.name().toString(), name);
+    QCOMPARE(parsed.version().toString(), version);
+    QCOMPARE(parsed.arch().toString(), arch);
+    QCOMPARE(parsed.data().toString(), data);
+}
+
+void TestPackageId::invalid_data()
+{
+    QTest::addColumn<QString>("packageId");
+
+    QTest::newRow("empty") << "";
+    QTest::newRow("name only") << "nymea";
+    QTest::newRow("three fields") << "nymea;1.0;amd64";
+    QTest::newRow("empty name") << ";1.0;amd64;installed";
+}
+
+void TestPackageId::invalid()
+{
+    QFETCH(QString, packageId);
+
+    PackageId parsed(packageId);
+    QVERIFY(!parsed.isValid());
+    QVERIFY(parsed.name().isEmpty());
+    QVERIFY(parsed.version().isEmpty());
+    QVERIFY(parsed.arch().isEmpty());
+    QVERIFY(parsed.data().isEmpty());
+}
+
+void TestPackageId::matchesDaemon_data()
+{
+    QTest::addColumn<QString>("packageId");
+
+    QTest::newRow("installed") << "nymea;1.9.0+202405;amd64;installed:ubuntu";
+    QTest::newRow("available") << "libnymea1;1:2.0-1;arm64;repository.nymea.io";
+    QTest::newRow("all") << "nymea-data;0.1~rc1;all;manual:focal";
+}
+
+void TestPackageId::matchesDaemon()
+{
+    // PackageId replaces the Daemon helpers, so it has to agree with them
+    QFETCH(QString, packageId);
+
+    PackageId parsed(packageId);
+    QCOMPARE(parsed.name().toString(), PackageKit::Daemon::packageName(packageId));
+    QCOMPARE(parsed.version().toString(), PackageKit::Daemon::packageVersion(packageId));
+    QCOMPARE(parsed.arch().toString(), PackageKit::Daemon::packageArch(packageId));
+    QCOMPARE(parsed.data().toString(), PackageKit::Daemon::packageData(packageId));
+}
+
+void TestPackageId::poolSharesStorage()
+{
+    PackageStringPool pool;
+    PackageId first("nymea;1.0;amd64;installed");
+    PackageId second("nymea;1.0;arm64;available");
+
+    QString a = pool.intern(first.name());
+    QString b = pool.intern(second.name());
+    QCOMPARE(a, QString("nymea"));
+    QCOMPARE(a.constData(), b.constData());
+    QCOMPARE(pool.intern(first.version()).constData(), pool.intern(second.version()).constData());
+    QCOMPARE(pool.count(), 2);
+
+    QVERIFY(pool.intern(QStringView()).isNull());
+    QCOMPARE(pool.count(), 2);
+}
+
+void TestPackageId::poolAdoptsStorage()
+{
+    PackageStringPool pool;
+    QString value = QString("nymea-") + "app";
+    QString interned = pool.intern(value);
+    QCOMPARE(interned.constData(), value.constData());
+
+    // Known values are handed out from the pool, not adopted again
+    QString copy = QString("nymea-") + "app";
+    QCOMPARE(pool.intern(copy).constData(), value.constData());
+    QCOMPARE(pool.count(), 1);
+}
+
+void TestPackageId::poolClear()
+{
+    PackageStringPool pool;
+    QString before = pool.intern(QStringView(u"nymea"));
+    pool.clear();
+    QCOMPARE(pool.count(), 0);
+    // Strings handed out earlier stay valid
+    QCOMPARE(before, QString("nymea"));
+    QCOMPARE(pool.intern(QStringView(u"nymea")), before);
+}
+
+QTEST_GUILESS_MAIN(TestPackageId)
+#include "testpackageid.moc"
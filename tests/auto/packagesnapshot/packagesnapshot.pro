@@ -0,0 +1,7 @@
+include(../../testcommon.pri)
+
+TARGET = testpackagesnapshot
+
+SOURCES += \
+    testpackagesnapshot.cpp \
+    $$PLUGIN_SOURCE_DIR/packagesnapshot.cpp
@@ -0,0 +1,181 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include <QtTest>
+
+#include "packagesnapshot.h"
+
+class TestPackageSnapshot: public QObject
+{
+    Q_OBJECT
+
+private:
+    QString writeSnapshot();
+
+private slots:
+    void init();
+
+    void roundTrip();
+    void empty();
+    void missingFile();
+    void corruptedPayload();
+    void truncated();
+    void unknownFormat();
+
+private:
+    QScopedPointer<QTemporaryDir> m_dir;
+};
+
+QString TestPackageSnapshot::writeSnapshot()
+{
+    Package nymea("nymea", "nymea");
+    nymea.setSummary("IoT server");
+    nymea.setInstalledVersion("1.0");
+    nymea.setCandidateVersion("1.1");
+    nymea.setUpdateAvailable(true);
+    nymea.setCanRemove(true);
+
+    Package app("nymea-app", "nymea app");
+    app.setCandidateVersion("2.0~rc1");
+
+    QString fileName = m_dir->filePath("snapshot");
+    if (!PackageSnapshot::save(fileName, {nymea, app}, {Repository("repository.nymea.io", "Stable", true), Repository("virtual_testing", "Testing", false)})) {
+        return QString();
+    }
+    return fileName;
+}
+
+void TestPackageSnapshot::init()
+{
+    m_dir.reset(new QTemporaryDir);
+    QVERIFY(m_dir->isValid());
+}
+
+void TestPackageSnapshot::roundTrip()
+{
+    QString fileName = writeSnapshot();
+    QVERIFY(!fileName.isEmpty());
+
+    QList<Package> packages;
+    QList<Repository> repositories;
+    QVERIFY(PackageSnapshot::load(fileName, &packages, &repositories));
+
+    QCOMPARE(packages.count(), 2);
+    QCOMPARE(packages.at(0).packageId(), QString("nymea"));
+    QCOMPARE(packages.at(0).displayName(), QString("nymea"));
+    QCOMPARE(packages.at(0).summary(), QString("IoT server"));
+    QCOMPARE(packages.at(0).installedVersion(), QString("1.0"));
+    QCOMPARE(packages.at(0).candidateVersion(), QString("1.1"));
+    QVERIFY(packages.at(0).updateAvailable());
+    QVERIFY(packages.at(0).canRemove());
+    QCOMPARE(packages.at(1).packageId(), QString("nymea-app"));
+    QCOMPARE(packages.at(1).displayName(), QString("nymea app"));
+    QVERIFY(packages.at(1).installedVersion().isEmpty());
+    QCOMPARE(packages.at(1).candidateVersion(), QString("2.0~rc1"));
+    QVERIFY(!packages.at(1).updateAvailable());
+    QVERIFY(!packages.at(1).canRemove());
+
+    QCOMPARE(repositories.count(), 2);
+    QCOMPARE(repositories.at(0).id(), QString("repository.nymea.io"));
+    QCOMPARE(repositories.at(0).displayName(), QString("Stable"));
+    QVERIFY(repositories.at(0).enabled());
+    QCOMPARE(repositories.at(1).id(), QString("virtual_testing"));
+    QVERIFY(!repositories.at(1).enabled());
+}
+
+void TestPackageSnapshot::empty()
+{
+    QString fileName = m_dir->filePath("empty");
+    QVERIFY(PackageSnapshot::save(fileName, QList<Package>(), QList<Repository>()));
+
+    QList<Package> packages;
+    QList<Repository> repositories;
+    QVERIFY(PackageSnapshot::load(fileName, &packages, &repositories));
+    QVERIFY(packages.isEmpty());
+    QVERIFY(repositories.isEmpty());
+}
+
+void TestPackageSnapshot::missingFile()
+{
+    QList<Package> packages;
+    QList<Repository> repositories;
+    QVERIFY(!PackageSnapshot::load(m_dir->filePath("missing"), &packages, &repositories));
+}
+
+void TestPackageSnapshot::corruptedPayload()
+{
+    QString fileName = writeSnapshot();
+    QFile file(fileName);
+    QVERIFY(file.open(QFile::ReadWrite));
+    QByteArray data = file.readAll();
+    // Flip a bit in the last byte of the payload, the size stays the same
+    data[data.size() - 1] = data.at(data.size() - 1) ^ 0x01;
+    QVERIFY(file.seek(0));
+    QCOMPARE(file.write(data), qint64(data.size()));
+    file.close();
+
+    QList<Package> packages;
+    QList<Repository> repositories;
+    QVERIFY(!PackageSnapshot::load(fileName, &packages, &repositories));
+    QVERIFY(packages.isEmpty());
+    QVERIFY(repositories.isEmpty());
+}
+
+void TestPackageSnapshot::truncated()
+{
+    QString fileName = writeSnapshot();
+    QFile file(fileName);
+    QVERIFY(file.resize(file.size() - 10));
+
+    QList<Package> packages;
+    QList<Repository> repositories;
+    QVERIFY(!PackageSnapshot::load(fileName, &packages, &repositories));
+    QVERIFY(packages.isEmpty());
+
+    // Shorter than the header
+    QVERIFY(file.resize(8));
+    QVERIFY(!PackageSnapshot::load(fileName, &packages, &repositories));
+}
+
+void TestPackageSnapshot::unknownFormat()
+{
+    QString fileName = writeSnapshot();
+    QFile file(fileName);
+    QVERIFY(file.open(QFile::ReadWrite));
+    // Bump the format version, which follows the magic
+    QVERIFY(file.seek(7));
+    char byte;
+    QVERIFY(file.getChar(&byte));
+    QVERIFY(file.seek(7));
+    QVERIFY(file.putChar(byte + 1));
+    file.close();
+
+    QList<Package> packages;
+    QList<Repository> repositories;
+    QVERIFY(!PackageSnapshot::load(fileName, &packages, &repositories));
+}
+
+QTEST_GUILESS_MAIN(TestPackageSnapshot)
+#include "testpackagesnapshot.moc"
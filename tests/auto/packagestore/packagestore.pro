@@ -0,0 +1,9 @@
+include(../../testcommon.pri)
+
+TARGET = testpackagestore
+
+SOURCES += \
+    testpackagestore.cpp \
+    $$PLUGIN_SOURCE_DIR/packagechangeset.cpp \
+    $$PLUGIN_SOURCE_DIR/packageid.cpp \
+    $$PLUGIN_SOURCE_DIR/packagestore.cpp
@@ -0,0 +1,196 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include <QtTest>
+
+#include "packagestore.h"
+
+class TestPackageStore: public QObject
+{
+    Q_OBJECT
+
+private:
+    static Package package(const QString &name, const QString &installed, const QString &candidate, bool updateAvailable = false);
+    static QHash<QString, Package> packages(const QList<Package> &list);
+    static QStringList ids(const QList<Package> &list);
+
+private slots:
+    void applyReportsChanges();
+    void applyWithoutChanges();
+    void indices();
+    void removeMovesLastRow();
+    void keepsChangelogOfSameCandidate();
+    void compactionKeepsLookups();
+};
+
+Package TestPackageStore::package(const QString &name, const QString &installed, const QString &candidate, bool updateAvailable)
+{
+    Package package(name, name);
+    package.setSummary("Summary of " + name);
+    package.setInstalledVersion(installed);
+    package.setCandidateVersion(candidate);
+    package.setUpdateAvailable(updateAvailable);
+    package.setCanRemove(!installed.isEmpty());
+    return package;
+}
+
+QHash<QString, Package> TestPackageStore::packages(const QList<Package> &list)
+{
+    QHash<QString, Package> packages;
+    foreach (const Package &package, list) {
+        packages.insert(package.packageId(), package);
+    }
+    return packages;
+}
+
+QStringList TestPackageStore::ids(const QList<Package> &list)
+{
+    QStringList ids;
+    foreach (const Package &package, list) {
+        ids.append(package.packageId());
+    }
+    ids.sort();
+    return ids;
+}
+
+void TestPackageStore::applyReportsChanges()
+{
+    PackageStore store;
+    QHash<QString, Package> incoming = packages({package("nymea", "1.0", "1.0"), package("nymea-app", "", "2.0"), package("libnymea1", "1.0", "1.0")});
+    PackageChangeset changeset = store.apply(incoming);
+    QVERIFY(incoming.isEmpty());
+    QCOMPARE(ids(changeset.added), QStringList({"libnymea1", "nymea", "nymea-app"}));
+    QVERIFY(changeset.changed.isEmpty());
+    QVERIFY(changeset.removed.isEmpty());
+    QCOMPARE(store.count(), 3);
+    QCOMPARE(store.generation(), quint64(1));
+
+    incoming = packages({package("nymea", "1.0", "1.1", true), package("nymea-app", "", "2.0")});
+    changeset = store.apply(incoming);
+    QVERIFY(changeset.added.isEmpty());
+    QCOMPARE(ids(changeset.changed), QStringList({"nymea"}));
+    QCOMPARE(changeset.removed, QStringList({"libnymea1"}));
+    QCOMPARE(store.count(), 2);
+    QCOMPARE(store.generation(), quint64(2));
+
+    Package stored = store.package("nymea");
+    QCOMPARE(stored.installedVersion(), QString("1.0"));
+    QCOMPARE(stored.candidateVersion(), QString("1.1"));
+    QVERIFY(stored.updateAvailable());
+    QVERIFY(stored.canRemove());
+    QCOMPARE(stored.summary(), QString("Summary of nymea"));
+    QVERIFY(!store.contains("libnymea1"));
+}
+
+void TestPackageStore::applyWithoutChanges()
+{
+    PackageStore store;
+    QHash<QString, Package> incoming = packages({package("nymea", "1.0", "1.0")});
+    store.apply(incoming);
+    QList<Package> snapshot = store.packages();
+
+    incoming = packages({package("nymea", "1.0", "1.0")});
+    PackageChangeset changeset = store.apply(incoming);
+    QVERIFY(changeset.isEmpty());
+    QCOMPARE(store.generation(), quint64(1));
+    QVERIFY(!store.insert(package("nymea", "1.0", "1.0")));
+    QCOMPARE(store.generation(), quint64(1));
+    QCOMPARE(ids(store.packages()), ids(snapshot));
+}
+
+void TestPackageStore::indices()
+{
+    PackageStore store;
+    QHash<QString, Package> incoming = packages({package("a", "1.0", "1.1", true), package("b", "1.0", "1.0"), package("c", "", "1.0")});
+    store.apply(incoming);
+    QCOMPARE(ids(store.updatablePackages()), QStringList({"a"}));
+    QCOMPARE(ids(store.removablePackages()), QStringList({"a", "b"}));
+    QCOMPARE(ids(store.installedPackages()), QStringList({"a", "b"}));
+
+    QVERIFY(store.insert(package("a", "1.1", "1.1")));
+    QVERIFY(store.insert(package("c", "1.0", "1.0")));
+    QVERIFY(store.updatablePackages().isEmpty());
+    QCOMPARE(ids(store.installedPackages()), QStringList({"a", "b", "c"}));
+}
+
+void TestPackageStore::removeMovesLastRow()
+{
+    PackageStore store;
+    QHash<QString, Package> incoming = packages({package("a", "1.0", "1.1", true), package("b", "1.0", "1.0"), package("c", "1.0", "1.2", true)});
+    store.apply(incoming);
+
+    // Whichever row is removed, the remaining ones have to keep their data and index entries
+    QVERIFY(store.remove("a"));
+    QVERIFY(!store.remove("a"));
+    QCOMPARE(store.count(), 2);
+    QCOMPARE(ids(store.packages()), QStringList({"b", "c"}));
+    QCOMPARE(ids(store.updatablePackages()), QStringList({"c"}));
+    QCOMPARE(store.package("c").candidateVersion(), QString("1.2"));
+    QCOMPARE(store.package("b").candidateVersion(), QString("1.0"));
+}
+
+void TestPackageStore::keepsChangelogOfSameCandidate()
+{
+    PackageStore store;
+    QHash<QString, Package> incoming = packages({package("a", "1.0", "1.1", true)});
+    store.apply(incoming);
+
+    Package withChangelog = package("a", "1.0", "1.1", true);
+    withChangelog.setChangelog("Fixes");
+    QVERIFY(store.insert(withChangelog));
+
+    // Refreshes don't carry changelogs
+    incoming = packages({package("a", "1.0", "1.1", true)});
+    QVERIFY(store.apply(incoming).isEmpty());
+    QCOMPARE(store.package("a").changelog(), QString("Fixes"));
+
+    incoming = packages({package("a", "1.0", "1.2", true)});
+    QCOMPARE(store.apply(incoming).changed.count(), 1);
+    QVERIFY(store.package("a").changelog().isEmpty());
+}
+
+void TestPackageStore::compactionKeepsLookups()
+{
+    // Enough version churn to make the string pool rebuild itself
+    PackageStore store;
+    for (int round = 0; round < 20; round++) {
+        QHash<QString, Package> incoming;
+        for (int i = 0; i < 10; i++) {
+            QString name = QString("package%1").arg(i);
+            incoming.insert(name, package(name, QString("1.%1").arg(round), QString("1.%1").arg(round + 1), true));
+        }
+        store.apply(incoming);
+    }
+    QCOMPARE(store.count(), 10);
+    for (int i = 0; i < 10; i++) {
+        QString name = QString("package%1").arg(i);
+        QVERIFY(store.contains(name));
+        QCOMPARE(store.package(name).installedVersion(), QString("1.19"));
+    }
+    QCOMPARE(store.updatablePackages().count(), 10);
+}
+
+QTEST_GUILESS_MAIN(TestPackageStore)
+#include "testpackagestore.moc"
@@ -0,0 +1,10 @@
+include(../../testcommon.pri)
+
+TARGET = testrepositoryfilemanager
+
+SOURCES += \
+    testrepositoryfilemanager.cpp \
+    $$PLUGIN_SOURCE_DIR/repositoryfilemanager.cpp
+
+HEADERS += \
+    $$PLUGIN_SOURCE_DIR/repositoryfilemanager.h
@@ -0,0 +1,345 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include <QtTest>
+
+#include "repositoryfilemanager.h"
+
+class TestRepositoryFileManager: public QObject
+{
+    Q_OBJECT
+
+private:
+    QString filePath(const QString &fileName) const;
+    void writeFile(const QString &fileName, const QByteArray &content);
+    QByteArray readFile(const QString &fileName) const;
+
+private slots:
+    void init();
+
+    void addToMissingFile();
+    void addIsIdempotent();
+    void addKeepsComments();
+    void addDropsDuplicates();
+    void addKeepsEnabledDuplicate();
+    void addEnablesCommentedSource();
+    void optionsDistinguishDuplicates();
+    void remove();
+    void invalidSource();
+
+    void deb822Add();
+    void deb822Enable();
+    void deb822RemoveFromStanza();
+    void deb822RemoveKeepsComments();
+
+private:
+    QScopedPointer<QTemporaryDir> m_dir;
+};
+
+QString TestRepositoryFileManager::filePath(const QString &fileName) const
+{
+    return m_dir->filePath(fileName);
+}
+
+void TestRepositoryFileManager::writeFile(const QString &fileName, const QByteArray &content)
+{
+    QFile file(filePath(fileName));
+    QVERIFY(file.open(QFile::WriteOnly));
+    QCOMPARE(file.write(content), content.size());
+}
+
+QByteArray TestRepositoryFileManager::readFile(const QString &fileName) const
+{
+    QFile file(filePath(fileName));
+    if (!file.open(QFile::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+void TestRepositoryFileManager::init()
+{
+    m_dir.reset(new QTemporaryDir);
+    QVERIFY(m_dir->isValid());
+}
+
+void TestRepositoryFileManager::addToMissingFile()
+{
+    RepositoryFileManager manager(filePath("nymea.list"));
+    QVERIFY(!manager.isDeb822());
+
+    bool changed = false;
+    QVERIFY(manager.addSource("deb http://repository.nymea.io jammy main", &changed));
+    QVERIFY(changed);
+    QCOMPARE(readFile("nymea.list"), QByteArray("deb http://repository.nymea.io jammy main\n"));
+}
+
+void TestRepositoryFileManager::addIsIdempotent()
+{
+    RepositoryFileManager manager(filePath("nymea.list"));
+    QVERIFY(manager.addSource("deb http://repository.nymea.io jammy main non-free"));
+
+    bool changed = true;
+    QVERIFY(manager.addSource("deb http://repository.nymea.io jammy main non-free", &changed));
+    QVERIFY(!changed);
+    // Trailing slashes and the order of the components don't make a different repository
+    QVERIFY(manager.addSource("deb http://repository.nymea.io/ jammy non-free main", &changed));
+    QVERIFY(!changed);
+    QCOMPARE(readFile("nymea.list"), QByteArray("deb http://repository.nymea.io jammy main non-free\n"));
+}
+
+void TestRepositoryFileManager::addKeepsComments()
+{
+    writeFile("nymea.list", "# Managed by nymea\n"
+                            "deb [arch=amd64 signed-by=/usr/share/keyrings/nymea.gpg] http://repository.nymea.io jammy main\n"
+                            "\n"
+                            "# deb http://repository.nymea.io jammy-experimental main\n");
+    RepositoryFileManager manager(filePath("nymea.list"));
+
+    bool changed = true;
+    QVERIFY(manager.addSource("deb http://repository.nymea.io jammy main", &changed));
+    QVERIFY(!changed);
+
+    QVERIFY(manager.addSource("deb http://repository.nymea.io jammy-landing main", &changed));
+    QVERIFY(changed);
+    QCOMPARE(readFile("nymea.list"), QByteArray("# Managed by nymea\n"
+                                                "deb [arch=amd64 signed-by=/usr/share/keyrings/nymea.gpg] http://repository.nymea.io jammy main\n"
+                                                "\n"
+                                                "# deb http://repository.nymea.io jammy-experimental main\n"
+                                                "deb http://repository.nymea.io jammy-landing main\n"));
+}
+
+void TestRepositoryFileManager::addDropsDuplicates()
+{
+    writeFile("nymea.list", "deb http://repository.nymea.io jammy main\n"
+                            "deb http://repository.nymea.io jammy main\n"
+                            "deb http://repository.nymea.io/ jammy main\n");
+    RepositoryFileManager manager(filePath("nymea.list"));
+
+    bool changed = false;
+    QVERIFY(manager.addSource("deb http://repository.nymea.io jammy main", &changed));
+    // The file is cleaned up even though the source already was in it
+    QVERIFY(changed);
+    QCOMPARE(readFile("nymea.list"), QByteArray("deb http://repository.nymea.io jammy main\n"));
+}
+
+void TestRepositoryFileManager::addKeepsEnabledDuplicate()
+{
+    writeFile("nymea.list", "# deb http://repository.nymea.io jammy main\n"
+                            "deb http://repository.nymea.io jammy main\n");
+    RepositoryFileManager manager(filePath("nymea.list"));
+
+    bool changed = false;
+    QVERIFY(manager.addSource("deb http://repository.nymea.io jammy-landing main", &changed));
+    QVERIFY(changed);
+    QCOMPARE(readFile("nymea.list"), QByteArray("deb http://repository.nymea.io jammy main\n"
+                                                "deb http://repository.nymea.io jammy-landing main\n"));
+}
+
+void TestRepositoryFileManager::addEnablesCommentedSource()
+{
+    writeFile("nymea.list", "# deb lines are managed by nymea\n"
+                            "# deb http://repository.nymea.io jammy main\n");
+    RepositoryFileManager manager(filePath("nymea.list"));
+
+    bool changed = false;
+    QVERIFY(manager.addSource("deb http://repository.nymea.io jammy main", &changed));
+    QVERIFY(changed);
+    QCOMPARE(readFile("nymea.list"), QByteArray("# deb lines are managed by nymea\n"
+                                                "deb http://repository.nymea.io jammy main\n"));
+}
+
+void TestRepositoryFileManager::optionsDistinguishDuplicates()
+{
+    QByteArray content("deb [arch=amd64] http://repository.nymea.io jammy main\n"
+                       "deb [arch=arm64] http://repository.nymea.io jammy main\n");
+    writeFile("nymea.list", content);
+    RepositoryFileManager manager(filePath("nymea.list"));
+
+    bool changed = true;
+    QVERIFY(manager.addSource("deb [arch=arm64] http://repository.nymea.io jammy main", &changed));
+    QVERIFY(!changed);
+    // Without options any of them is the requested repository
+    QVERIFY(manager.addSource("deb http://repository.nymea.io jammy main", &changed));
+    QVERIFY(!changed);
+    QCOMPARE(readFile("nymea.list"), content);
+
+    QVERIFY(manager.addSource("deb [arch=i386] http://repository.nymea.io jammy main", &changed));
+    QVERIFY(changed);
+    QCOMPARE(readFile("nymea.list"), content + "deb [arch=i386] http://repository.nymea.io jammy main\n");
+}
+
+void TestRepositoryFileManager::remove()
+{
+    writeFile("nymea.list", "# Managed by nymea\n"
+                            "deb http://repository.nymea.io jammy main\n"
+                            "deb http://repository.nymea.io jammy-landing main\n");
+    RepositoryFileManager manager(filePath("nymea.list"));
+
+    bool changed = false;
+    QVERIFY(manager.removeSource("deb http://repository.nymea.io/ jammy main", &changed));
+    QVERIFY(changed);
+    QCOMPARE(readFile("nymea.list"), QByteArray("# Managed by nymea\n"
+                                                "deb http://repository.nymea.io jammy-landing main\n"));
+
+    QVERIFY(manager.removeSource("deb http://repository.nymea.io jammy main", &changed));
+    QVERIFY(!changed);
+
+    QVERIFY(manager.removeSource("deb http://repository.nymea.io jammy-landing main", &changed));
+    QVERIFY(changed);
+    QCOMPARE(readFile("nymea.list"), QByteArray("# Managed by nymea\n"));
+}
+
+void TestRepositoryFileManager::invalidSource()
+{
+    RepositoryFileManager manager(filePath("nymea.list"));
+    QVERIFY(!manager.addSource("http://repository.nymea.io jammy main"));
+    QVERIFY(!manager.addSource("deb http://repository.nymea.io"));
+    QVERIFY(!manager.removeSource("# deb http://repository.nymea.io jammy main"));
+    QVERIFY(!QFile::exists(filePath("nymea.list")));
+}
+
+void TestRepositoryFileManager::deb822Add()
+{
+    RepositoryFileManager manager(filePath("nymea.sources"));
+    QVERIFY(manager.isDeb822());
+
+    bool changed = false;
+    QVERIFY(manager.addSource("deb [arch=amd64,arm64] http://repository.nymea.io jammy main", &changed));
+    QVERIFY(changed);
+    QCOMPARE(readFile("nymea.sources"), QByteArray("Types: deb\n"
+                                                   "URIs: http://repository.nymea.io\n"
+                                                   "Suites: jammy\n"
+                                                   "Components: main\n"
+                                                   "Architectures: amd64 arm64\n"));
+
+    QVERIFY(manager.addSource("deb http://repository.nymea.io jammy main", &changed));
+    QVERIFY(!changed);
+}
+
+void TestRepositoryFileManager::deb822Enable()
+{
+    writeFile("nymea.sources", "# Managed by nymea\n"
+                               "\n"
+                               "Types: deb\n"
+                               "URIs: http://repository.nymea.io\n"
+                               "Suites: jammy\n"
+                               "Components: main\n"
+                               "Enabled: no\n"
+                               "Signed-By:\n"
+                               " -----BEGIN PGP PUBLIC KEY BLOCK-----\n"
+                               " .\n"
+                               " mQINBGRkZXNjcmlwdGlvbg==\n"
+                               " -----END PGP PUBLIC KEY BLOCK-----\n");
+    RepositoryFileManager manager(filePath("nymea.sources"));
+
+    bool changed = false;
+    QVERIFY(manager.addSource("deb http://repository.nymea.io jammy main", &changed));
+    QVERIFY(changed);
+    // The inline key survives rewriting the stanza
+    QCOMPARE(readFile("nymea.sources"), QByteArray("# Managed by nymea\n"
+                                                   "\n"
+                                                   "Types: deb\n"
+                                                   "URIs: http://repository.nymea.io\n"
+                                                   "Suites: jammy\n"
+                                                   "Components: main\n"
+                                                   "Signed-By:\n"
+                                                   " -----BEGIN PGP PUBLIC KEY BLOCK-----\n"
+                                                   " .\n"
+                                                   " mQINBGRkZXNjcmlwdGlvbg==\n"
+                                                   " -----END PGP PUBLIC KEY BLOCK-----\n"));
+}
+
+void TestRepositoryFileManager::deb822RemoveFromStanza()
+{
+    writeFile("nymea.sources", "Types: deb\n"
+                               "URIs: http://repository.nymea.io\n"
+                               "Suites: jammy jammy-landing\n"
+                               "Components: main\n"
+                               "\n"
+                               "Types: deb\n"
+                               "URIs: http://example.com\n"
+                               "Suites: stable\n"
+                               "Components: main\n");
+    RepositoryFileManager manager(filePath("nymea.sources"));
+
+    bool changed = false;
+    QVERIFY(manager.removeSource("deb http://repository.nymea.io jammy-landing main", &changed));
+    QVERIFY(changed);
+    QCOMPARE(readFile("nymea.sources"), QByteArray("Types: deb\n"
+                                                   "URIs: http://repository.nymea.io\n"
+                                                   "Suites: jammy\n"
+                                                   "Components: main\n"
+                                                   "\n"
+                                                   "Types: deb\n"
+                                                   "URIs: http://example.com\n"
+                                                   "Suites: stable\n"
+                                                   "Components: main\n"));
+}
+
+void TestRepositoryFileManager::deb822RemoveKeepsComments()
+{
+    writeFile("nymea.sources", "# nymea repositories\n"
+                               "Types: deb deb-src\n"
+                               "URIs: http://repository.nymea.io\n"
+                               "# Landing is only needed for testing\n"
+                               "Suites: jammy jammy-landing\n"
+                               "Components: main\n"
+                               "Signed-By: /usr/share/keyrings/nymea.gpg\n");
+    RepositoryFileManager manager(filePath("nymea.sources"));
+
+    bool changed = false;
+    QVERIFY(manager.removeSource("deb-src http://repository.nymea.io jammy-landing main", &changed));
+    QVERIFY(changed);
+    // Only what can't be written as one stanza any more goes into a second one
+    QCOMPARE(readFile("nymea.sources"), QByteArray("# nymea repositories\n"
+                                                   "Types: deb\n"
+                                                   "URIs: http://repository.nymea.io\n"
+                                                   "# Landing is only needed for testing\n"
+                                                   "Suites: jammy jammy-landing\n"
+                                                   "Components: main\n"
+                                                   "Signed-By: /usr/share/keyrings/nymea.gpg\n"
+                                                   "\n"
+                                                   "Types: deb-src\n"
+                                                   "URIs: http://repository.nymea.io\n"
+                                                   "Suites: jammy\n"
+                                                   "Components: main\n"
+                                                   "Signed-By: /usr/share/keyrings/nymea.gpg\n"));
+
+    QVERIFY(manager.removeSource("deb-src http://repository.nymea.io jammy main", &changed));
+    QVERIFY(changed);
+    QVERIFY(manager.removeSource("deb http://repository.nymea.io jammy-landing main", &changed));
+    QVERIFY(changed);
+    QCOMPARE(readFile("nymea.sources"), QByteArray("# nymea repositories\n"
+                                                   "Types: deb\n"
+                                                   "URIs: http://repository.nymea.io\n"
+                                                   "# Landing is only needed for testing\n"
+                                                   "Suites: jammy\n"
+                                                   "Components: main\n"
+                                                   "Signed-By: /usr/share/keyrings/nymea.gpg\n"));
+}
+
+QTEST_GUILESS_MAIN(TestRepositoryFileManager)
+#include "testrepositoryfilemanager.moc"
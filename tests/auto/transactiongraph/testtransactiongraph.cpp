@@ -0,0 +1,237 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include <QtTest>
+#include <QDBusObjectPath>
+
+#include "transactiongraph.h"
+
+class TestTransactionGraph: public QObject
+{
+    Q_OBJECT
+
+private:
+    // Transactions which never talk to the daemon, finished by the test
+    PackageKit::Transaction *createTransaction(const QString &step);
+    void finish(const QString &step, bool success);
+
+private slots:
+    void cleanup();
+
+    void nothingToDo();
+    void dependencies();
+    void concurrentSteps();
+    void failureSkipsDependents();
+    void gate();
+    void resumeBeforeStart();
+    void stepsAddedWhileRunning();
+
+private:
+    QHash<QString, QPointer<PackageKit::Transaction>> m_transactions;
+    QStringList m_created;
+};
+
+PackageKit::Transaction *TestTransactionGraph::createTransaction(const QString &step)
+{
+    m_created.append(step);
+    PackageKit::Transaction *transaction = new PackageKit::Transaction(QDBusObjectPath("/test/" + step));
+    m_transactions.insert(step, transaction);
+    return transaction;
+}
+
+void TestTransactionGraph::finish(const QString &step, bool success)
+{
+    PackageKit::Transaction *transaction = m_transactions.value(step);
+    QVERIFY(transaction);
+    if (!success) {
+        emit transaction->errorCode(PackageKit::Transaction::ErrorDepResolutionFailed, "broken");
+    }
+    emit transaction->finished(success ? PackageKit::Transaction::ExitSuccess : PackageKit::Transaction::ExitFailed, 0);
+}
+
+void TestTransactionGraph::cleanup()
+{
+    foreach (const QPointer<PackageKit::Transaction> &transaction, m_transactions) {
+        delete transaction.data();
+    }
+    m_transactions.clear();
+    m_created.clear();
+}
+
+void TestTransactionGraph::nothingToDo()
+{
+    QPointer<TransactionGraph> graph = new TransactionGraph("test");
+    QSignalSpy finishedSpy(graph.data(), &TransactionGraph::finished);
+    int a = graph->addStep("a", [](){ return nullptr; });
+    graph->addStep("b", [](){ return nullptr; }, {a});
+    graph->start();
+
+    QCOMPARE(finishedSpy.count(), 1);
+    QCOMPARE(finishedSpy.at(0).at(0).toBool(), true);
+    QVERIFY(graph->succeeded());
+    QVERIFY(graph->succeeded(a));
+    QVERIFY(!graph->succeeded(5));
+
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+    QVERIFY(graph.isNull());
+}
+
+void TestTransactionGraph::dependencies()
+{
+    QStringList order;
+    TransactionGraph *graph = new TransactionGraph("test");
+    QSignalSpy finishedSpy(graph, &TransactionGraph::finished);
+    int a = graph->addStep("a", [&order](){ order.append("a"); return nullptr; });
+    int b = graph->addStep("b", [&order](){ order.append("b"); return nullptr; }, {a});
+    graph->addStep("c", [&order](){ order.append("c"); return nullptr; }, {a, b});
+    graph->addStep("d", [&order](){ order.append("d"); return nullptr; });
+    graph->start();
+
+    QCOMPARE(finishedSpy.count(), 1);
+    QCOMPARE(order.count(), 4);
+    QVERIFY(order.indexOf("a") < order.indexOf("b"));
+    QVERIFY(order.indexOf("b") < order.indexOf("c"));
+}
+
+void TestTransactionGraph::concurrentSteps()
+{
+    TransactionGraph *graph = new TransactionGraph("test");
+    QSignalSpy finishedSpy(graph, &TransactionGraph::finished);
+    int a = graph->addStep("a", [this](){ return createTransaction("a"); });
+    int b = graph->addStep("b", [this](){ return createTransaction("b"); });
+    graph->addStep("c", [this](){ return createTransaction("c"); }, {a, b});
+    graph->start();
+
+    // Independent steps run at the same time
+    QCOMPARE(m_created, QStringList({"a", "b"}));
+
+    finish("b", true);
+    QCOMPARE(m_created, QStringList({"a", "b"}));
+    finish("a", true);
+    QCOMPARE(m_created, QStringList({"a", "b", "c"}));
+    QCOMPARE(finishedSpy.count(), 0);
+
+    // Duplicate finished signals of old libpackagekitqt versions are ignored
+    finish("a", true);
+    QCOMPARE(finishedSpy.count(), 0);
+
+    finish("c", true);
+    QCOMPARE(finishedSpy.count(), 1);
+    QCOMPARE(finishedSpy.at(0).at(0).toBool(), true);
+}
+
+void TestTransactionGraph::failureSkipsDependents()
+{
+    bool dependentCalled = false;
+    TransactionGraph *graph = new TransactionGraph("test");
+    QSignalSpy finishedSpy(graph, &TransactionGraph::finished);
+    int a = graph->addStep("a", [this](){ return createTransaction("a"); });
+    int b = graph->addStep("b", [&dependentCalled](){ dependentCalled = true; return nullptr; }, {a});
+    int c = graph->addStep("c", [&dependentCalled](){ dependentCalled = true; return nullptr; }, {b});
+    int d = graph->addStep("d", [this](){ return createTransaction("d"); });
+    graph->start();
+
+    finish("a", false);
+    QVERIFY(!dependentCalled);
+    QCOMPARE(finishedSpy.count(), 0);
+
+    finish("d", true);
+    QCOMPARE(finishedSpy.count(), 1);
+    QCOMPARE(finishedSpy.at(0).at(0).toBool(), false);
+    QVERIFY(!graph->succeeded(a));
+    QVERIFY(!graph->succeeded(b));
+    QVERIFY(!graph->succeeded(c));
+    QVERIFY(graph->succeeded(d));
+    QCOMPARE(graph->errors().count(), 1);
+    QVERIFY(graph->errors().first().startsWith("a: broken"));
+}
+
+void TestTransactionGraph::gate()
+{
+    bool open = false;
+    QStringList order;
+    TransactionGraph *graph = new TransactionGraph("test");
+    QSignalSpy finishedSpy(graph, &TransactionGraph::finished);
+    graph->setGate([&open](const QString &step){ return open || step != "b"; });
+    int a = graph->addStep("a", [&order](){ order.append("a"); return nullptr; });
+    graph->addStep("b", [&order](){ order.append("b"); return nullptr; }, {a});
+    graph->start();
+
+    // Held back steps keep the graph alive
+    QCOMPARE(order, QStringList({"a"}));
+    QCOMPARE(finishedSpy.count(), 0);
+
+    graph->resume();
+    QCOMPARE(order, QStringList({"a"}));
+    QCOMPARE(finishedSpy.count(), 0);
+
+    open = true;
+    graph->resume();
+    QCOMPARE(order, QStringList({"a", "b"}));
+    QCOMPARE(finishedSpy.count(), 1);
+    QCOMPARE(finishedSpy.at(0).at(0).toBool(), true);
+}
+
+void TestTransactionGraph::resumeBeforeStart()
+{
+    bool called = false;
+    TransactionGraph *graph = new TransactionGraph("test");
+    QSignalSpy finishedSpy(graph, &TransactionGraph::finished);
+    graph->addStep("a", [&called](){ called = true; return nullptr; });
+    graph->resume();
+    QVERIFY(!called);
+    QCOMPARE(finishedSpy.count(), 0);
+
+    graph->start();
+    QVERIFY(called);
+    QCOMPARE(finishedSpy.count(), 1);
+}
+
+void TestTransactionGraph::stepsAddedWhileRunning()
+{
+    TransactionGraph *graph = new TransactionGraph("test");
+    QSignalSpy finishedSpy(graph, &TransactionGraph::finished);
+    int a = graph->addStep("a", [this](){ return createTransaction("a"); });
+    graph->addStep("b", [this, graph, a](){
+        // Splits its work into two steps, the second one waiting for the first
+        int c = graph->addStep("c", [this](){ return createTransaction("c"); }, {a});
+        graph->addStep("d", [this](){ return createTransaction("d"); }, {c});
+        return nullptr;
+    });
+    graph->start();
+
+    QCOMPARE(m_created, QStringList({"a"}));
+    finish("a", true);
+    QCOMPARE(m_created, QStringList({"a", "c"}));
+    finish("c", true);
+    QCOMPARE(m_created, QStringList({"a", "c", "d"}));
+    QCOMPARE(finishedSpy.count(), 0);
+    finish("d", true);
+    QCOMPARE(finishedSpy.count(), 1);
+    QCOMPARE(finishedSpy.at(0).at(0).toBool(), true);
+}
+
+QTEST_GUILESS_MAIN(TestTransactionGraph)
+#include "testtransactiongraph.moc"
@@ -0,0 +1,10 @@
+include(../../testcommon.pri)
+
+TARGET = testtransactiongraph
+
+SOURCES += \
+    testtransactiongraph.cpp \
+    $$PLUGIN_SOURCE_DIR/transactiongraph.cpp
+
+HEADERS += \
+    $$PLUGIN_SOURCE_DIR/transactiongraph.h
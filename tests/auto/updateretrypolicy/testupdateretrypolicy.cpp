@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include <QtTest>
+#include <QSettings>
+
+#include "updateretrypolicy.h"
+
+class TestUpdateRetryPolicy: public QObject
+{
+    Q_OBJECT
+
+private:
+    QString settingsFile(const QVariantMap &values);
+
+private slots:
+    void init();
+
+    void classify_data();
+    void classify();
+
+    void defaults();
+    void backoff();
+    void jitter();
+    void bounds();
+
+private:
+    QScopedPointer<QTemporaryDir> m_dir;
+};
+
+QString TestUpdateRetryPolicy::settingsFile(const QVariantMap &values)
+{
+    QString fileName = m_dir->filePath("updatepluginpackagekit.conf");
+    QSettings settings(fileName, QSettings::IniFormat);
+    settings.beginGroup("Retry");
+    for (QVariantMap::const_iterator it = values.constBegin(); it != values.constEnd(); ++it) {
+        settings.setValue(it.key(), it.value());
+    }
+    settings.endGroup();
+    settings.sync();
+    return fileName;
+}
+
+void TestUpdateRetryPolicy::init()
+{
+    m_dir.reset(new QTemporaryDir);
+    QVERIFY(m_dir->isValid());
+}
+
+void TestUpdateRetryPolicy::classify_data()
+{
+    // The enums aren't registered meta types
+    QTest::addColumn<int>("error");
+    QTest::addColumn<int>("errorClass");
+
+    QTest::newRow("no network") << static_cast<int>(PackageKit::Transaction::ErrorNoNetwork) << static_cast<int>(UpdateRetryPolicy::ErrorClassTransient);
+    QTest::newRow("repo not available") << static_cast<int>(PackageKit::Transaction::ErrorRepoNotAvailable) << static_cast<int>(UpdateRetryPolicy::ErrorClassTransient);
+    QTest::newRow("lock") << static_cast<int>(PackageKit::Transaction::ErrorCannotGetLock) << static_cast<int>(UpdateRetryPolicy::ErrorClassTransient);
+    QTest::newRow("download failed") << static_cast<int>(PackageKit::Transaction::ErrorPackageDownloadFailed) << static_cast<int>(UpdateRetryPolicy::ErrorClassStaleMetadata);
+    QTest::newRow("package not found") << static_cast<int>(PackageKit::Transaction::ErrorPackageNotFound) << static_cast<int>(UpdateRetryPolicy::ErrorClassStaleMetadata);
+    QTest::newRow("no cache") << static_cast<int>(PackageKit::Transaction::ErrorNoCache) << static_cast<int>(UpdateRetryPolicy::ErrorClassStaleMetadata);
+    QTest::newRow("dependencies") << static_cast<int>(PackageKit::Transaction::ErrorDepResolutionFailed) << static_cast<int>(UpdateRetryPolicy::ErrorClassPermanent);
+    QTest::newRow("disk space") << static_cast<int>(PackageKit::Transaction::ErrorNoSpaceOnDevice) << static_cast<int>(UpdateRetryPolicy::ErrorClassPermanent);
+    QTest::newRow("signature") << static_cast<int>(PackageKit::Transaction::ErrorGpgFailure) << static_cast<int>(UpdateRetryPolicy::ErrorClassPermanent);
+    QTest::newRow("unknown") << static_cast<int>(PackageKit::Transaction::ErrorUnknown) << static_cast<int>(UpdateRetryPolicy::ErrorClassPermanent);
+}
+
+void TestUpdateRetryPolicy::classify()
+{
+    QFETCH(int, error);
+    QFETCH(int, errorClass);
+
+    QCOMPARE(static_cast<int>(UpdateRetryPolicy::classify(static_cast<PackageKit::Transaction::Error>(error))), errorClass);
+}
+
+void TestUpdateRetryPolicy::defaults()
+{
+    UpdateRetryPolicy policy;
+    QSettings settings(settingsFile(QVariantMap()), QSettings::IniFormat);
+    policy.load(settings);
+    QCOMPARE(policy.maximumAttempts(), 3);
+}
+
+void TestUpdateRetryPolicy::backoff()
+{
+    QVariantMap values;
+    values.insert("maximumAttempts", 5);
+    values.insert("initialDelay", 30);
+    values.insert("maximumDelay", 600);
+    values.insert("jitter", 0);
+    QSettings settings(settingsFile(values), QSettings::IniFormat);
+    UpdateRetryPolicy policy;
+    policy.load(settings);
+
+    QCOMPARE(policy.maximumAttempts(), 5);
+    QCOMPARE(policy.delay(1), Q_INT64_C(30000));
+    QCOMPARE(policy.delay(2), Q_INT64_C(60000));
+    QCOMPARE(policy.delay(3), Q_INT64_C(120000));
+    QCOMPARE(policy.delay(5), Q_INT64_C(480000));
+    QCOMPARE(policy.delay(6), Q_INT64_C(600000));
+    QCOMPARE(policy.delay(100), Q_INT64_C(600000));
+}
+
+void TestUpdateRetryPolicy::jitter()
+{
+    QVariantMap values;
+    values.insert("initialDelay", 100);
+    values.insert("jitter", 0.5);
+    QSettings settings(settingsFile(values), QSettings::IniFormat);
+    UpdateRetryPolicy policy;
+    policy.load(settings);
+
+    for (int i = 0; i < 100; i++) {
+        qint64 delay = policy.delay(1);
+        QVERIFY2(delay >= 50000 && delay <= 150000, QByteArray::number(delay));
+    }
+}
+
+void TestUpdateRetryPolicy::bounds()
+{
+    QVariantMap values;
+    values.insert("maximumAttempts", 0);
+    values.insert("initialDelay", 0);
+    values.insert("maximumDelay", 0);
+    values.insert("jitter", 5);
+    QSettings settings(settingsFile(values), QSettings::IniFormat);
+    UpdateRetryPolicy policy;
+    policy.load(settings);
+
+    QCOMPARE(policy.maximumAttempts(), 1);
+    // Never retried right away, even with full jitter
+    for (int i = 0; i < 100; i++) {
+        QVERIFY(policy.delay(1) >= 1000);
+    }
+}
+
+QTEST_GUILESS_MAIN(TestUpdateRetryPolicy)
+#include "testupdateretrypolicy.moc"
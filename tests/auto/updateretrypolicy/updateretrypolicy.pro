@@ -0,0 +1,7 @@
+include(../../testcommon.pri)
+
+TARGET = testupdateretrypolicy
+
+SOURCES += \
+    testupdateretrypolicy.cpp \
+    $$PLUGIN_SOURCE_DIR/updateretrypolicy.cpp
@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include <QtTest>
+
+#include <Daemon>
+
+#include "packageid.h"
+
+// Compares splitting the package IDs of a refresh with PackageId against PackageKit::Daemon's helpers,
+// which allocate a new string per field.
+class BenchPackageId: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void splitDaemon();
+    void splitPackageId();
+
+    void internDaemon();
+    void internPackageId();
+
+private:
+    QStringList m_packageIds;
+};
+
+void BenchPackageId::initTestCase()
+{
+    // About the size of a refresh with the default filter on a device with the nymea repositories
+    for (int i = 0; i < 2000; i++) {
+        m_packageIds.append(QString("nymea-plugin-%1;1.%2.0+202405%3~jammy1;%4;repository.nymea.io")
+                            .arg(i).arg(i % 10).arg(i % 3).arg(i % 2 ? "amd64" : "all"));
+    }
+}
+
+void BenchPackageId::splitDaemon()
+{
+    int length = 0;
+    QBENCHMARK {
+        foreach (const QString &packageId, m_packageIds) {
+            length += PackageKit::Daemon::packageName(packageId).length();
+            length += PackageKit::Daemon::packageVersion(packageId).length();
+            length += PackageKit::Daemon::packageArch(packageId).length();
+            length += PackageKit::Daemon::packageData(packageId).length();
+        }
+    }
+    QVERIFY(length > 0);
+}
+
+void BenchPackageId::splitPackageId()
+{
+    int length = 0;
+    QBENCHMARK {
+        foreach (const QString &packageId, m_packageIds) {
+            PackageId id(packageId);
+            length += id.name().length();
+            length += id.version().length();
+            length += id.arch().length();
+            length += id.data().length();
+        }
+    }
+    QVERIFY(length > 0);
+}
+
+void BenchPackageId::internDaemon()
+{
+    // What the controller did before: a QString per field and package, kept in the package
+    QBENCHMARK {
+        QVector<QString> fields;
+        fields.reserve(m_packageIds.count() * 3);
+        foreach (const QString &packageId, m_packageIds) {
+            fields.append(PackageKit::Daemon::packageName(packageId));
+            fields.append(PackageKit::Daemon::packageVersion(packageId));
+            fields.append(PackageKit::Daemon::packageArch(packageId));
+        }
+    }
+}
+
+void BenchPackageId::internPackageId()
+{
+    // Repeated versions and arches share their storage, a second refresh doesn't allocate
+    PackageStringPool pool;
+    QBENCHMARK {
+        QVector<QString> fields;
+        fields.reserve(m_packageIds.count() * 3);
+        foreach (const QString &packageId, m_packageIds) {
+            PackageId id(packageId);
+            fields.append(pool.intern(id.name()));
+            fields.append(pool.intern(id.version()));
+            fields.append(pool.intern(id.arch()));
+        }
+    }
+    QVERIFY(pool.count() < m_packageIds.count() + 50);
+}
+
+QTEST_GUILESS_MAIN(BenchPackageId)
+#include "benchpackageid.moc"
@@ -0,0 +1,7 @@
+include(../../testcommon.pri)
+
+TARGET = benchpackageid
+
+SOURCES += \
+    benchpackageid.cpp \
+    $$PLUGIN_SOURCE_DIR/packageid.cpp
@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include <QtTest>
+
+#include <malloc.h>
+
+#include "packagestore.h"
+
+// Compares the heap used for the managed packages by PackageStore with the QHash of Package objects
+// it replaced, and times applying a refresh result.
+class BenchPackageStore: public QObject
+{
+    Q_OBJECT
+
+private:
+    // A refresh result as it comes from D-Bus: every field is a string of its own
+    static QHash<QString, Package> refresh(int generation);
+    static qint64 heapUsage();
+
+private slots:
+    void memoryHash();
+    void memoryStore();
+
+    void applyUnchanged();
+    void applyChanged();
+};
+
+static const int s_packageCount = 3000;
+
+QHash<QString, Package> BenchPackageStore::refresh(int generation)
+{
+    QHash<QString, Package> packages;
+    for (int i = 0; i < s_packageCount; i++) {
+        QByteArray name = "nymea-plugin-" + QByteArray::number(i);
+        QByteArray installed = "1." + QByteArray::number(i % 20) + ".0-1~jammy1";
+        // Every generation brings updates for a tenth of the packages
+        QByteArray candidate = i % 10 == generation % 10 ? "1." + QByteArray::number(i % 20 + generation) + ".0-1~jammy1" : installed;
+        Package package(QString::fromLatin1(name), QString::fromLatin1(name));
+        package.setSummary(QString::fromLatin1("nymea integration plugin " + QByteArray::number(i)));
+        package.setInstalledVersion(QString::fromLatin1(installed));
+        package.setCandidateVersion(QString::fromLatin1(candidate));
+        package.setUpdateAvailable(candidate != installed);
+        package.setCanRemove(true);
+        packages.insert(package.packageId(), package);
+    }
+    return packages;
+}
+
+qint64 BenchPackageStore::heapUsage()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    return static_cast<qint64>(info.uordblks + info.hblkhd);
+#else
+    return -1;
+#endif
+}
+
+void BenchPackageStore::memoryHash()
+{
+    if (heapUsage() < 0) {
+        QSKIP("Heap statistics need glibc >= 2.33");
+    }
+    qint64 before = heapUsage();
+    QHash<QString, Package> packages;
+    for (int generation = 0; generation < 3; generation++) {
+        packages = refresh(generation);
+    }
+    qint64 used = heapUsage() - before;
+    qInfo() << "QHash<QString, Package> with" << packages.count() << "packages:" << used << "bytes";
+    QTest::setBenchmarkResult(used, QTest::BytesAllocated);
+}
+
+void BenchPackageStore::memoryStore()
+{
+    if (heapUsage() < 0) {
+        QSKIP("Heap statistics need glibc >= 2.33");
+    }
+    qint64 before = heapUsage();
+    PackageStore store;
+    for (int generation = 0; generation < 3; generation++) {
+        QHash<QString, Package> packages = refresh(generation);
+        store.apply(packages);
+    }
+    qint64 used = heapUsage() - before;
+    qInfo() << "PackageStore with" << store.count() << "packages," << store.stringPool().count() << "pooled strings:" << used << "bytes";
+    QTest::setBenchmarkResult(used, QTest::BytesAllocated);
+}
+
+void BenchPackageStore::applyUnchanged()
+{
+    PackageStore store;
+    QHash<QString, Package> packages = refresh(0);
+    store.apply(packages);
+    QHash<QString, Package> incoming = refresh(0);
+    QBENCHMARK {
+        QHash<QString, Package> copy = incoming;
+        store.apply(copy);
+    }
+    QCOMPARE(store.count(), s_packageCount);
+}
+
+void BenchPackageStore::applyChanged()
+{
+    PackageStore store;
+    QList<QHash<QString, Package>> generations;
+    for (int generation = 0; generation < 2; generation++) {
+        generations.append(refresh(generation));
+    }
+    int generation = 0;
+    QBENCHMARK {
+        QHash<QString, Package> copy = generations.at(generation++ % 2);
+        store.apply(copy);
+    }
+    QCOMPARE(store.count(), s_packageCount);
+}
+
+QTEST_GUILESS_MAIN(BenchPackageStore)
+#include "benchpackagestore.moc"
@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "mockpackagekitbus.h"
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusReply>
+#include <QJsonDocument>
+#include <QStandardPaths>
+
+static QDBusMessage controlCall(const QString &method)
+{
+    return QDBusMessage::createMethodCall("org.freedesktop.PackageKit", "/org/freedesktop/PackageKit", "io.nymea.MockPackageKit", method);
+}
+
+MockPackageKitBus::~MockPackageKitBus()
+{
+    m_mock.terminate();
+    m_mock.waitForFinished(2000);
+    m_busDaemon.terminate();
+    m_busDaemon.waitForFinished(2000);
+}
+
+bool MockPackageKitBus::start(const QString &scriptFileName, QString *errorString)
+{
+    QString busDaemon = QStandardPaths::findExecutable("dbus-daemon");
+    if (busDaemon.isEmpty()) {
+        *errorString = "dbus-daemon not found";
+        return false;
+    }
+    m_busDaemon.start(busDaemon, QStringList() << "--session" << "--nofork" << "--print-address");
+    if (!m_busDaemon.waitForStarted() || !m_busDaemon.waitForReadyRead(5000)) {
+        *errorString = "Cannot start dbus-daemon: " + m_busDaemon.errorString();
+        return false;
+    }
+    QByteArray address = m_busDaemon.readLine().trimmed();
+    // Inherited by the mock as well
+    qputenv("DBUS_SYSTEM_BUS_ADDRESS", address);
+
+    QStringList arguments;
+    if (!scriptFileName.isEmpty()) {
+        arguments << "--script" << scriptFileName;
+    }
+    m_mock.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    m_mock.start(MOCK_PACKAGEKIT, arguments);
+    if (!m_mock.waitForStarted() || !m_mock.waitForReadyRead(5000) || m_mock.readLine().trimmed() != "ready") {
+        *errorString = QString("Cannot start %1: %2").arg(QString(MOCK_PACKAGEKIT), m_mock.errorString());
+        return false;
+    }
+    return true;
+}
+
+bool MockPackageKitBus::loadScript(const QString &fileName)
+{
+    QDBusReply<bool> reply = QDBusConnection::systemBus().call(controlCall("LoadScript") << fileName);
+    return reply.isValid() && reply.value();
+}
+
+QVariantList MockPackageKitBus::log() const
+{
+    QDBusReply<QString> reply = QDBusConnection::systemBus().call(controlCall("Log"));
+    return QJsonDocument::fromJson(reply.value().toUtf8()).toVariant().toList();
+}
+
+void MockPackageKitBus::clearLog()
+{
+    QDBusConnection::systemBus().call(controlCall("ClearLog"));
+}
@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MOCKPACKAGEKITBUS_H
+#define MOCKPACKAGEKITBUS_H
+
+#include <QProcess>
+#include <QVariantList>
+
+// Runs a private D-Bus daemon as the system bus of this process and the mock PackageKit daemon on it.
+// Has to be started before anything in this process connects to the system bus.
+class MockPackageKitBus
+{
+public:
+    MockPackageKitBus() = default;
+    ~MockPackageKitBus();
+
+    bool start(const QString &scriptFileName, QString *errorString);
+
+    // Replaces the package state of the mock and clears its transaction log
+    bool loadScript(const QString &fileName);
+
+    // Transactions since the last script load or clearLog(), see MockBackend
+    QVariantList log() const;
+    void clearLog();
+
+private:
+    QProcess m_busDaemon;
+    QProcess m_mock;
+};
+
+#endif // MOCKPACKAGEKITBUS_H
@@ -0,0 +1,8 @@
+# The mock PackageKit daemon on a private bus, for executables talking to PackageKit
+
+INCLUDEPATH += $$PWD
+
+SOURCES += $$PWD/mockpackagekitbus.cpp
+HEADERS += $$PWD/mockpackagekitbus.h
+
+DEFINES += MOCK_PACKAGEKIT=\\\"$$shadowed($$PWD/../mockpackagekit)/mockpackagekit\\\"
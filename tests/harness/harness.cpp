@@ -0,0 +1,305 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "harness.h"
+#include "allocationcounter.h"
+#include "mockpackagekitbus.h"
+#include "updatecontrollerpackagekit.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QTimer>
+
+#include <algorithm>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+static qint64 median(QList<qint64> values)
+{
+    if (values.isEmpty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values.at(values.count() / 2);
+}
+
+Harness::Harness(MockPackageKitBus *bus, const QString &scriptFileName, QObject *parent):
+    QObject(parent),
+    m_bus(bus),
+    m_scriptFileName(scriptFileName)
+{
+    m_settleTimer = new QTimer(this);
+    m_settleTimer->setSingleShot(true);
+    m_settleTimer->setInterval(2000);
+    connect(m_settleTimer, &QTimer::timeout, this, &Harness::finishCycle);
+
+    m_sampleTimer = new QTimer(this);
+    m_sampleTimer->setInterval(10);
+    connect(m_sampleTimer, &QTimer::timeout, this, &Harness::sampleMemory);
+
+    m_timeoutTimer = new QTimer(this);
+    m_timeoutTimer->setSingleShot(true);
+    m_timeoutTimer->setInterval(300000);
+    connect(m_timeoutTimer, &QTimer::timeout, this, &Harness::abort);
+}
+
+void Harness::setIterations(int iterations)
+{
+    m_iterations = iterations;
+}
+
+void Harness::setSettleTime(int milliseconds)
+{
+    m_settleTimer->setInterval(milliseconds);
+}
+
+void Harness::setTimeout(int milliseconds)
+{
+    m_timeoutTimer->setInterval(milliseconds);
+}
+
+void Harness::setRemoveCount(int count)
+{
+    m_removeCount = count;
+}
+
+void Harness::setMetricsFileName(const QString &fileName)
+{
+    m_metricsFileName = fileName;
+}
+
+void Harness::start()
+{
+    // The first cycle is the plugin starting up and refreshing on its own. Every further iteration
+    // starts from the scripted state again.
+    m_queue.append("startup");
+    for (int i = 0; i < m_iterations; i++) {
+        if (i > 0) {
+            m_queue.append("reset");
+        }
+        m_queue << "refresh" << "update" << "remove";
+    }
+    startCycle();
+}
+
+QVariantMap Harness::report() const
+{
+    QHash<QString, QList<qint64>> wallTimes;
+    QHash<QString, QList<qint64>> cpuTimes;
+    QHash<QString, QList<qint64>> allocations;
+    QHash<QString, qint64> peakRss;
+    QStringList names;
+    foreach (const QVariant &entry, m_cycles) {
+        QVariantMap cycle = entry.toMap();
+        QString name = cycle.value("cycle").toString();
+        if (!names.contains(name)) {
+            names.append(name);
+        }
+        wallTimes[name].append(cycle.value("wallTime").toLongLong());
+        cpuTimes[name].append(cycle.value("cpuTime").toLongLong());
+        allocations[name].append(cycle.value("allocations").toLongLong());
+        peakRss[name] = qMax(peakRss.value(name), cycle.value("peakRss").toLongLong());
+    }
+
+    QVariantMap summary;
+    foreach (const QString &name, names) {
+        QList<qint64> walls = wallTimes.value(name);
+        QList<qint64> cpus = cpuTimes.value(name);
+        QVariantMap entry;
+        entry.insert("count", walls.count());
+        entry.insert("wallTimeMedian", median(walls));
+        entry.insert("wallTimeMax", *std::max_element(walls.constBegin(), walls.constEnd()));
+        entry.insert("cpuTimeMedian", median(cpus));
+        entry.insert("cpuTimeMax", *std::max_element(cpus.constBegin(), cpus.constEnd()));
+        entry.insert("allocationsMedian", median(allocations.value(name)));
+        entry.insert("peakRss", peakRss.value(name));
+        summary.insert(name, entry);
+    }
+
+    QVariantMap report;
+    report.insert("script", m_scriptFileName);
+    report.insert("settleTime", m_settleTimer->interval());
+    report.insert("cycles", m_cycles);
+    report.insert("summary", summary);
+
+    // The plugin's own per-transaction statistics, written whenever it went idle
+    QFile metricsFile(m_metricsFileName);
+    if (!m_metricsFileName.isEmpty() && metricsFile.open(QFile::ReadOnly)) {
+        report.insert("pluginMetrics", QJsonDocument::fromJson(metricsFile.readAll()).toVariant());
+    }
+    return report;
+}
+
+void Harness::onBusyChanged()
+{
+    if (m_controller->busy()) {
+        m_settleTimer->stop();
+    } else {
+        m_idleAt = m_wallTimer.elapsed();
+        m_settleTimer->start();
+    }
+}
+
+void Harness::sampleMemory()
+{
+    m_peakRss = qMax(m_peakRss, residentMemory());
+}
+
+void Harness::finishCycle()
+{
+    if (m_controller->busy()) {
+        return;
+    }
+    m_sampleTimer->stop();
+    m_timeoutTimer->stop();
+    sampleMemory();
+    // Before the harness allocates for the report itself
+    quint64 allocations = AllocationCounter::allocations() - m_allocationsStart;
+    quint64 allocatedBytes = AllocationCounter::allocatedBytes() - m_allocatedBytesStart;
+
+    if (m_cycle != "reset") {
+        QVariantList transactions = m_bus->log();
+        int hinted = 0;
+        int failed = 0;
+        QVariantMap methods;
+        foreach (const QVariant &entry, transactions) {
+            QVariantMap transaction = entry.toMap();
+            if (!transaction.value("hints").toList().isEmpty()) {
+                hinted++;
+            }
+            QString exit = transaction.value("exit").toString();
+            if (!exit.isEmpty() && exit != "Success") {
+                failed++;
+            }
+            // Transactions created but never started have no method
+            QString method = transaction.value("method", "None").toString();
+            methods.insert(method, methods.value(method).toInt() + 1);
+        }
+
+        QVariantMap cycle;
+        cycle.insert("cycle", m_cycle);
+        cycle.insert("iteration", m_iteration);
+        cycle.insert("wallTime", m_idleAt);
+        cycle.insert("cpuTime", cpuTime() - m_cpuStart);
+        cycle.insert("rssStart", m_rssStart);
+        cycle.insert("rssEnd", residentMemory());
+        cycle.insert("peakRss", m_peakRss);
+        cycle.insert("allocations", allocations);
+        cycle.insert("allocatedBytes", allocatedBytes);
+        cycle.insert("transactions", transactions.count());
+        cycle.insert("hintedTransactions", hinted);
+        cycle.insert("failedTransactions", failed);
+        cycle.insert("methods", methods);
+        cycle.insert("packages", m_controller->packages().count());
+        cycle.insert("updatablePackages", m_controller->updatablePackages().count());
+        m_cycles.append(cycle);
+        qInfo().nospace() << m_cycle << " #" << m_iteration << ": " << m_idleAt << " ms, " << cycle.value("cpuTime").toLongLong()
+                          << " ms CPU, " << m_peakRss / 1024 << " KiB peak RSS, " << allocations << " allocations, "
+                          << transactions.count() << " transactions";
+    }
+    if (m_cycle == "remove") {
+        m_iteration++;
+    }
+    startCycle();
+}
+
+void Harness::abort()
+{
+    qWarning() << "Cycle" << m_cycle << "didn't finish within" << m_timeoutTimer->interval() << "ms";
+    stop();
+}
+
+void Harness::stop()
+{
+    m_settleTimer->stop();
+    m_sampleTimer->stop();
+    m_timeoutTimer->stop();
+    emit finished(false);
+}
+
+void Harness::startCycle()
+{
+    if (m_queue.isEmpty()) {
+        emit finished(true);
+        return;
+    }
+    m_cycle = m_queue.takeFirst();
+
+    m_bus->clearLog();
+    m_idleAt = 0;
+    m_cpuStart = cpuTime();
+    m_rssStart = residentMemory();
+    m_peakRss = m_rssStart;
+    m_allocationsStart = AllocationCounter::allocations();
+    m_allocatedBytesStart = AllocationCounter::allocatedBytes();
+    m_wallTimer.start();
+    m_sampleTimer->start();
+    m_timeoutTimer->start();
+    // Stopped again as soon as the plugin gets busy. If it never does, the cycle had nothing to do.
+    m_settleTimer->start();
+
+    if (m_cycle == "startup") {
+        m_controller = new UpdateControllerPackageKit(this);
+        connect(m_controller, &UpdateControllerPackageKit::busyChanged, this, &Harness::onBusyChanged);
+        connect(m_controller, &UpdateControllerPackageKit::updateRunningChanged, this, &Harness::onBusyChanged);
+    } else if (m_cycle == "refresh") {
+        m_controller->checkForUpdates();
+    } else if (m_cycle == "update") {
+        m_controller->startUpdate();
+    } else if (m_cycle == "remove") {
+        QStringList installed;
+        foreach (const Package &package, m_controller->packages()) {
+            if (!package.installedVersion().isEmpty()) {
+                installed.append(package.packageId());
+            }
+        }
+        std::sort(installed.begin(), installed.end());
+        m_controller->removePackages(installed.mid(0, m_removeCount));
+    } else if (m_cycle == "reset") {
+        if (!m_bus->loadScript(m_scriptFileName)) {
+            qWarning() << "Cannot reload" << m_scriptFileName;
+            stop();
+        }
+    }
+}
+
+qint64 Harness::cpuTime()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000LL
+            + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000;
+}
+
+qint64 Harness::residentMemory()
+{
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QFile::ReadOnly)) {
+        return 0;
+    }
+    QList<QByteArray> fields = statm.readAll().split(' ');
+    return fields.count() > 1 ? fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE) : 0;
+}
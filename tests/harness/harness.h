@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HARNESS_H
+#define HARNESS_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QStringList>
+#include <QVariantMap>
+
+class QTimer;
+class MockPackageKitBus;
+class UpdateControllerPackageKit;
+
+// Drives refresh, update and remove cycles of the plugin against the mock PackageKit daemon and
+// measures every cycle from the outside: the wall time until the plugin is idle again, the CPU time,
+// memory and heap allocations of this process, which runs nothing but the plugin, and the
+// transactions the mock saw.
+//
+// A cycle is over once the plugin hasn't been busy for the settle time. Follow-up work like the
+// refresh after an update belongs to the cycle that caused it.
+class Harness : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Harness(MockPackageKitBus *bus, const QString &scriptFileName, QObject *parent = nullptr);
+
+    void setIterations(int iterations);
+    void setSettleTime(int milliseconds);
+    void setTimeout(int milliseconds);
+    void setRemoveCount(int count);
+    void setMetricsFileName(const QString &fileName);
+
+    void start();
+    QVariantMap report() const;
+
+signals:
+    void finished(bool success);
+
+private slots:
+    void onBusyChanged();
+    void sampleMemory();
+    void finishCycle();
+    void abort();
+
+private:
+    void startCycle();
+    void stop();
+
+    static qint64 cpuTime();
+    static qint64 residentMemory();
+
+    MockPackageKitBus *m_bus = nullptr;
+    UpdateControllerPackageKit *m_controller = nullptr;
+    QString m_scriptFileName;
+    QString m_metricsFileName;
+    int m_iterations = 3;
+    int m_removeCount = 10;
+
+    QTimer *m_settleTimer = nullptr;
+    QTimer *m_sampleTimer = nullptr;
+    QTimer *m_timeoutTimer = nullptr;
+
+    QStringList m_queue;
+    int m_iteration = 0;
+    QString m_cycle;
+    QElapsedTimer m_wallTimer;
+    qint64 m_idleAt = 0;
+    qint64 m_cpuStart = 0;
+    qint64 m_rssStart = 0;
+    qint64 m_peakRss = 0;
+    quint64 m_allocationsStart = 0;
+    quint64 m_allocatedBytesStart = 0;
+
+    QVariantList m_cycles;
+};
+
+#endif // HARNESS_H
@@ -0,0 +1,21 @@
+include(../testcommon.pri)
+include(../common/mockpackagekitbus.pri)
+include(../../nymea-update-plugin-packagekit.pri)
+
+# Benchmark driver run by hand, not part of "make check"
+CONFIG -= testcase
+QT -= testlib
+QT += network
+
+TARGET = harness
+
+DEFINES += HARNESS_SCRIPT=\\\"$$PWD/scripts/default.json\\\"
+
+SOURCES += \
+    main.cpp \
+    allocationcounter.cpp \
+    harness.cpp
+
+HEADERS += \
+    allocationcounter.h \
+    harness.h
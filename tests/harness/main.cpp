@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QLoggingCategory>
+#include <QSettings>
+#include <QTemporaryDir>
+#include <QTimer>
+
+#include "harness.h"
+#include "mockpackagekitbus.h"
+#include "nymeasettings.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+    // Makes NymeaSettings use /tmp/nymea-test instead of the real configuration
+    application.setOrganizationName("nymea-test");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Runs refresh, update and remove cycles of the PackageKit update plugin against "
+                                     "a scripted PackageKit on a private bus and reports their cost as JSON.");
+    parser.addHelpOption();
+    QCommandLineOption scriptOption("script", "Mock PackageKit script.", "file", HARNESS_SCRIPT);
+    QCommandLineOption iterationsOption("iterations", "Refresh, update and remove cycles to run.", "count", "3");
+    QCommandLineOption settleOption("settle", "Milliseconds the plugin has to be idle to end a cycle.", "ms", "2000");
+    QCommandLineOption timeoutOption("timeout", "Seconds after which a cycle is aborted.", "seconds", "300");
+    QCommandLineOption removeOption("remove", "Installed packages to remove per remove cycle.", "count", "10");
+    QCommandLineOption includeOption("include", "Comma separated include patterns of the plugin.", "patterns", "nymea");
+    QCommandLineOption outputOption("output", "File the JSON report is written to instead of stdout.", "file");
+    QCommandLineOption verboseOption("verbose", "Show the debug output of the plugin.");
+    parser.addOptions({scriptOption, iterationsOption, settleOption, timeoutOption, removeOption, includeOption, outputOption, verboseOption});
+    parser.process(application);
+
+    if (!parser.isSet(verboseOption)) {
+        QLoggingCategory::setFilterRules("*.debug=false");
+    }
+
+    QString scriptFileName = QFileInfo(parser.value(scriptOption)).absoluteFilePath();
+    MockPackageKitBus bus;
+    QString errorString;
+    if (!bus.start(scriptFileName, &errorString)) {
+        qWarning() << errorString;
+        return 1;
+    }
+
+    // Nothing of the plugin may touch the system: no dpkg database, no sources files, no cache
+    QTemporaryDir workDirectory;
+    QDir().mkpath(NymeaSettings::settingsPath());
+    QSettings settings(NymeaSettings::settingsPath() + "/updatepluginpackagekit.conf", QSettings::IniFormat);
+    settings.clear();
+    settings.setValue("PackageFilter/includePatterns", parser.value(includeOption).split(','));
+    settings.setValue("DpkgWatcher/enabled", false);
+    settings.setValue("NativeReader/enabled", false);
+    settings.setValue("UpdateScheduler/cpuPressureThreshold", 0);
+    settings.setValue("UpdateScheduler/ioPressureThreshold", 0);
+    settings.setValue("UpdateScheduler/loadThreshold", 0);
+    settings.setValue("RepositoryFiles/fileName", workDirectory.filePath("nymea.list"));
+    settings.setValue("Snapshot/fileName", workDirectory.filePath("updatepluginpackagekit.snapshot"));
+    settings.setValue("Metrics/exportFileName", workDirectory.filePath("metrics.json"));
+    settings.setValue("Tracing/enabled", false);
+    // Retries wait on a timer without any transaction running. Keep them within the settle time so they
+    // count towards the cycle that failed.
+    settings.setValue("Retry/initialDelay", 1);
+    settings.setValue("Retry/maximumDelay", 1);
+    settings.setValue("Retry/jitter", 0);
+    settings.sync();
+
+    Harness harness(&bus, scriptFileName);
+    harness.setIterations(parser.value(iterationsOption).toInt());
+    harness.setSettleTime(parser.value(settleOption).toInt());
+    harness.setTimeout(parser.value(timeoutOption).toInt() * 1000);
+    harness.setRemoveCount(parser.value(removeOption).toInt());
+    harness.setMetricsFileName(workDirectory.filePath("metrics.json"));
+
+    QString outputFileName = parser.value(outputOption);
+    QObject::connect(&harness, &Harness::finished, &application, [&harness, &application, outputFileName](bool success){
+        QByteArray report = QJsonDocument::fromVariant(harness.report()).toJson();
+        QFile output(outputFileName);
+        bool opened = outputFileName.isEmpty() ? output.open(stdout, QFile::WriteOnly) : output.open(QFile::WriteOnly);
+        if (!opened || output.write(report) != report.size()) {
+            qWarning() << "Cannot write the report:" << output.errorString();
+            success = false;
+        }
+        output.close();
+        application.exit(success ? 0 : 1);
+    });
+    QTimer::singleShot(0, &harness, &Harness::start);
+
+    return application.exec();
+}
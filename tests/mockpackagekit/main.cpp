@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QDBusError>
+#include <QDBusMetaType>
+#include <QDebug>
+
+#include <cstdio>
+
+#include "mockbackend.h"
+#include "mockdaemon.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Scripted replacement of packagekitd for benchmarks and tests. It takes over "
+                                     "org.freedesktop.PackageKit on the system bus, so run it on a private bus "
+                                     "by setting DBUS_SYSTEM_BUS_ADDRESS.");
+    parser.addHelpOption();
+    QCommandLineOption scriptOption("script", "JSON script with the packages, delays and errors.", "file");
+    parser.addOption(scriptOption);
+    parser.process(application);
+
+    qDBusRegisterMetaType<QList<QDBusObjectPath>>();
+
+    MockBackend backend;
+    if (parser.isSet(scriptOption)) {
+        QString errorString;
+        if (!backend.load(parser.value(scriptOption), &errorString)) {
+            qWarning() << errorString;
+            return 1;
+        }
+    }
+
+    QObject daemon;
+    new MockDaemon(&backend, &daemon);
+    new MockOffline(&daemon);
+    new MockControl(&backend, &daemon);
+
+    QDBusConnection bus = QDBusConnection::systemBus();
+    if (!bus.registerObject("/org/freedesktop/PackageKit", &daemon, QDBusConnection::ExportAdaptors)
+            || !bus.registerService("org.freedesktop.PackageKit")) {
+        qWarning() << "Cannot register on the system bus:" << bus.lastError().message();
+        return 1;
+    }
+
+    // Whoever started us can let clients connect now
+    fputs("ready\n", stdout);
+    fflush(stdout);
+
+    return application.exec();
+}
@@ -0,0 +1,305 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "mockbackend.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMetaEnum>
+
+#include <Transaction>
+
+static const char *defaultDistroId = "ubuntu;22.04;x86_64";
+
+QString MockBackend::MockPackage::installedId() const
+{
+    return QString("%1;%2;%3;installed").arg(name, installed, arch);
+}
+
+QString MockBackend::MockPackage::candidateId() const
+{
+    return QString("%1;%2;%3;%4").arg(name, candidate, arch, repository);
+}
+
+bool MockBackend::MockPackage::updateAvailable() const
+{
+    return !installed.isEmpty() && !candidate.isEmpty() && installed != candidate;
+}
+
+MockBackend::MockBackend(QObject *parent):
+    QObject(parent),
+    m_distroId(defaultDistroId)
+{
+    m_clock.start();
+}
+
+bool MockBackend::load(const QString &fileName, QString *errorString)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) {
+        *errorString = QString("Cannot open %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+    QJsonParseError parseError;
+    QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (parseError.error != QJsonParseError::NoError) {
+        *errorString = QString("Cannot parse %1: %2").arg(fileName, parseError.errorString());
+        return false;
+    }
+    QVariantMap script = document.toVariant().toMap();
+
+    m_distroId = script.value("distroId", defaultDistroId).toString();
+    m_updatesChanged = script.value("updatesChanged", true).toBool();
+
+    m_packages.clear();
+    foreach (const QVariant &entry, script.value("packages").toList()) {
+        QVariantMap map = entry.toMap();
+        MockPackage package;
+        package.name = map.value("name").toString();
+        package.arch = map.value("arch", package.arch).toString();
+        package.summary = map.value("summary").toString();
+        package.installed = map.value("installed").toString();
+        package.candidate = map.value("candidate").toString();
+        package.repository = map.value("repository", package.repository).toString();
+        package.updateInfo = map.value("updateInfo", package.updateInfo).toString();
+        package.changelog = map.value("changelog").toString();
+        package.size = map.value("size").toULongLong();
+        package.devel = map.value("devel").toBool();
+        if (package.name.isEmpty() || (package.installed.isEmpty() && package.candidate.isEmpty())) {
+            *errorString = QString("Package entry without name or version in %1").arg(fileName);
+            return false;
+        }
+        if (enumValue("Info", package.updateInfo) < 0) {
+            *errorString = QString("Unknown update info %1 of %2").arg(package.updateInfo, package.name);
+            return false;
+        }
+        m_packages.insert(package.name, package);
+    }
+
+    QVariantMap generate = script.value("generate").toMap();
+    int count = generate.value("count").toInt();
+    int installedCount = static_cast<int>(count * generate.value("installed").toDouble());
+    int updatesCount = qMin(installedCount, static_cast<int>(count * generate.value("updates").toDouble()));
+    QString prefix = generate.value("prefix", "nymea-plugin-generated-").toString();
+    for (int i = 0; i < count; i++) {
+        MockPackage package;
+        package.name = prefix + QString::number(i);
+        package.summary = QString("Generated package %1").arg(i);
+        package.size = 100000 + i * 10;
+        // The first packages are installed, the first of those have an update
+        if (i < installedCount) {
+            package.installed = QString("1.0.%1").arg(i % 10);
+        }
+        package.candidate = QString(i < updatesCount ? "1.1.%1" : "1.0.%1").arg(i % 10);
+        if (i < updatesCount) {
+            package.changelog = QString("Version 1.1.%1 of generated package %2").arg(i % 10).arg(i);
+        }
+        m_packages.insert(package.name, package);
+    }
+
+    m_repositories.clear();
+    foreach (const QVariant &entry, script.value("repositories").toList()) {
+        QVariantMap map = entry.toMap();
+        MockRepository repository;
+        repository.id = map.value("id").toString();
+        repository.description = map.value("description", repository.id).toString();
+        repository.enabled = map.value("enabled", true).toBool();
+        m_repositories.append(repository);
+    }
+
+    QVariantMap delays = script.value("delays").toMap();
+    m_defaultDelay = delays.value("default", 0).toInt();
+    m_packageDelay = delays.value("perPackage", 0).toInt();
+    m_delays.clear();
+    foreach (const QString &method, delays.keys()) {
+        m_delays.insert(method, delays.value(method).toInt());
+    }
+
+    m_errors.clear();
+    foreach (const QVariant &entry, script.value("errors").toList()) {
+        QVariantMap map = entry.toMap();
+        MockError error;
+        error.method = map.value("method").toString();
+        int code = enumValue("Error", map.value("code").toString());
+        if (code < 0) {
+            *errorString = QString("Unknown error code %1 for %2").arg(map.value("code").toString(), error.method);
+            return false;
+        }
+        error.code = code;
+        error.details = map.value("details", "Scripted failure").toString();
+        error.count = map.value("count", 1).toInt();
+        m_errors.append(error);
+    }
+
+    clearLog();
+    return true;
+}
+
+QString MockBackend::distroId() const
+{
+    return m_distroId;
+}
+
+QList<MockBackend::MockPackage> MockBackend::packages() const
+{
+    return m_packages.values();
+}
+
+bool MockBackend::contains(const QString &name) const
+{
+    return m_packages.contains(name);
+}
+
+MockBackend::MockPackage MockBackend::package(const QString &name) const
+{
+    return m_packages.value(name);
+}
+
+void MockBackend::setPackage(const MockPackage &package)
+{
+    m_packages.insert(package.name, package);
+}
+
+void MockBackend::removePackage(const QString &name)
+{
+    m_packages.remove(name);
+}
+
+QList<MockBackend::MockRepository> MockBackend::repositories() const
+{
+    return m_repositories;
+}
+
+bool MockBackend::setRepositoryEnabled(const QString &repositoryId, bool enabled)
+{
+    for (int i = 0; i < m_repositories.count(); i++) {
+        if (m_repositories.at(i).id == repositoryId) {
+            if (m_repositories.at(i).enabled != enabled) {
+                m_repositories[i].enabled = enabled;
+                emit repoListChanged();
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+int MockBackend::delay(const QString &method) const
+{
+    return m_delays.value(method, m_defaultDelay);
+}
+
+int MockBackend::packageDelay() const
+{
+    return m_packageDelay;
+}
+
+bool MockBackend::takeError(const QString &method, uint *code, QString *details)
+{
+    for (int i = 0; i < m_errors.count(); i++) {
+        if (m_errors.at(i).method == method) {
+            *code = m_errors.at(i).code;
+            *details = m_errors.at(i).details;
+            if (--m_errors[i].count <= 0) {
+                m_errors.removeAt(i);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void MockBackend::packagesModified()
+{
+    if (m_updatesChanged) {
+        emit updatesChanged();
+    }
+}
+
+int MockBackend::logTransaction(const QString &path)
+{
+    QVariantMap entry;
+    entry.insert("path", path);
+    entry.insert("created", m_clock.elapsed());
+    entry.insert("hints", QVariantList());
+    m_log.append(entry);
+    return m_log.count() - 1;
+}
+
+void MockBackend::updateLog(int index, const QString &key, const QVariant &value)
+{
+    // The log might have been cleared while the transaction was running
+    if (index < m_log.count() && m_log.at(index).value("path").isValid()) {
+        m_log[index].insert(key, value);
+    }
+}
+
+QVariantList MockBackend::log() const
+{
+    QVariantList log;
+    foreach (const QVariantMap &entry, m_log) {
+        if (!entry.isEmpty()) {
+            log.append(entry);
+        }
+    }
+    return log;
+}
+
+void MockBackend::clearLog()
+{
+    // Indices held by running transactions stay valid, their entries are dropped
+    for (int i = 0; i < m_log.count(); i++) {
+        m_log[i].clear();
+    }
+}
+
+qint64 MockBackend::elapsed() const
+{
+    return m_clock.elapsed();
+}
+
+int MockBackend::enumValue(const char *enumName, const QString &name)
+{
+    const QMetaObject &metaObject = PackageKit::Transaction::staticMetaObject;
+    QMetaEnum metaEnum = metaObject.enumerator(metaObject.indexOfEnumerator(enumName));
+
+    QString key = enumName;
+    foreach (const QString &part, name.split('-')) {
+        if (!part.isEmpty()) {
+            key.append(part.at(0).toUpper() + part.mid(1));
+        }
+    }
+    bool ok;
+    int value = metaEnum.keyToValue(key.toLatin1().constData(), &ok);
+    return ok ? value : -1;
+}
+
+QString MockBackend::enumName(const char *enumName, int value)
+{
+    const QMetaObject &metaObject = PackageKit::Transaction::staticMetaObject;
+    QMetaEnum metaEnum = metaObject.enumerator(metaObject.indexOfEnumerator(enumName));
+    return QString(metaEnum.valueToKey(value)).remove(0, qstrlen(enumName));
+}
@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MOCKBACKEND_H
+#define MOCKBACKEND_H
+
+#include <QElapsedTimer>
+#include <QMap>
+#include <QObject>
+#include <QStringList>
+#include <QVariantMap>
+
+// Package state of the mock PackageKit daemon, loaded from a JSON script:
+//
+// {
+//     "distroId": "ubuntu;22.04;x86_64",
+//     "packages": [
+//         { "name": "nymea", "installed": "1.9.0", "candidate": "1.10.0", "summary": "...",
+//           "arch": "amd64", "repository": "repository.nymea.io", "updateInfo": "security",
+//           "changelog": "...", "size": 1048576, "devel": false }
+//     ],
+//     "generate": { "prefix": "nymea-plugin-generated-", "count": 1000, "installed": 0.5, "updates": 0.2 },
+//     "repositories": [ { "id": "...", "description": "...", "enabled": true } ],
+//     "delays": { "default": 10, "perPackage": 2, "RefreshCache": 500 },
+//     "errors": [ { "method": "UpdatePackages", "code": "no-network", "details": "...", "count": 1 } ],
+//     "updatesChanged": true
+// }
+//
+// A package without "installed" is only available, one without "candidate" only installed. "devel"
+// marks the packages the devel and not-devel filters apply to (for aptcc: the -dev, -dbg and
+// -dbgsym packages and those in the devel and libdevel sections). "generate" adds
+// packages with deterministic names and versions, "installed" and "updates" being the fractions of
+// them which are installed and which have an update. Delays are milliseconds per D-Bus method,
+// "perPackage" is added for every package an update, install, remove or download processes.
+// Every error fails the next "count" calls of that method, codes are the PackageKit error names.
+//
+// Every transaction is logged with the hints it was given, the call and how it finished.
+class MockBackend : public QObject
+{
+    Q_OBJECT
+public:
+    class MockPackage
+    {
+    public:
+        QString name;
+        QString arch = "amd64";
+        QString summary;
+        QString installed;
+        QString candidate;
+        QString repository = "mock";
+        QString updateInfo = "normal";
+        QString changelog;
+        qulonglong size = 0;
+        bool devel = false;
+
+        QString installedId() const;
+        QString candidateId() const;
+        bool updateAvailable() const;
+    };
+
+    class MockRepository
+    {
+    public:
+        QString id;
+        QString description;
+        bool enabled = true;
+    };
+
+    explicit MockBackend(QObject *parent = nullptr);
+
+    // Replaces the whole state and clears the log
+    bool load(const QString &fileName, QString *errorString);
+
+    QString distroId() const;
+
+    QList<MockPackage> packages() const;
+    bool contains(const QString &name) const;
+    MockPackage package(const QString &name) const;
+    void setPackage(const MockPackage &package);
+    void removePackage(const QString &name);
+
+    QList<MockRepository> repositories() const;
+    bool setRepositoryEnabled(const QString &repositoryId, bool enabled);
+
+    int delay(const QString &method) const;
+    int packageDelay() const;
+
+    // Consumes one scripted failure of the method, if any is left
+    bool takeError(const QString &method, uint *code, QString *details);
+
+    // Tells clients the installed packages changed, like packagekitd does after a transaction
+    void packagesModified();
+
+    int logTransaction(const QString &path);
+    void updateLog(int index, const QString &key, const QVariant &value);
+    QVariantList log() const;
+    void clearLog();
+    qint64 elapsed() const;
+
+    // PackageKit names like "no-network" for the Transaction enum "Error", -1 if unknown
+    static int enumValue(const char *enumName, const QString &name);
+    static QString enumName(const char *enumName, int value);
+
+signals:
+    void updatesChanged();
+    void repoListChanged();
+
+private:
+    class MockError
+    {
+    public:
+        QString method;
+        uint code = 0;
+        QString details;
+        int count = 1;
+    };
+
+    QString m_distroId;
+    QMap<QString, MockPackage> m_packages;
+    QList<MockRepository> m_repositories;
+    QHash<QString, int> m_delays;
+    int m_defaultDelay = 0;
+    int m_packageDelay = 0;
+    QList<MockError> m_errors;
+    bool m_updatesChanged = true;
+
+    QElapsedTimer m_clock;
+    QList<QVariantMap> m_log;
+};
+
+#endif // MOCKBACKEND_H
@@ -0,0 +1,271 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "mockdaemon.h"
+#include "mocktransaction.h"
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QJsonDocument>
+
+#include <Daemon>
+
+using PackageKit::Transaction;
+
+MockDaemon::MockDaemon(MockBackend *backend, QObject *parent):
+    QDBusAbstractAdaptor(parent),
+    m_backend(backend)
+{
+    connect(m_backend, &MockBackend::updatesChanged, this, &MockDaemon::UpdatesChanged);
+    connect(m_backend, &MockBackend::repoListChanged, this, &MockDaemon::RepoListChanged);
+}
+
+uint MockDaemon::versionMajor() const
+{
+    return 1;
+}
+
+uint MockDaemon::versionMinor() const
+{
+    return 2;
+}
+
+uint MockDaemon::versionMicro() const
+{
+    return 5;
+}
+
+QString MockDaemon::backendName() const
+{
+    return "mock";
+}
+
+QString MockDaemon::backendDescription() const
+{
+    return "Scripted PackageKit replacement";
+}
+
+QString MockDaemon::backendAuthor() const
+{
+    return "nymea";
+}
+
+qulonglong MockDaemon::roles() const
+{
+    QList<Transaction::Role> roles;
+    roles << Transaction::RoleCancel << Transaction::RoleSearchName << Transaction::RoleGetPackages
+          << Transaction::RoleResolve << Transaction::RoleGetUpdates << Transaction::RoleGetRepoList
+          << Transaction::RoleRefreshCache << Transaction::RoleRepoEnable << Transaction::RoleGetDetails
+          << Transaction::RoleGetUpdateDetail << Transaction::RoleUpdatePackages << Transaction::RoleInstallPackages
+          << Transaction::RoleRemovePackages << Transaction::RoleDownloadPackages;
+    qulonglong bitfield = 0;
+    foreach (Transaction::Role role, roles) {
+        bitfield |= Q_UINT64_C(1) << role;
+    }
+    return bitfield;
+}
+
+qulonglong MockDaemon::groups() const
+{
+    return 0;
+}
+
+qulonglong MockDaemon::filters() const
+{
+    return Transaction::FilterInstalled | Transaction::FilterNotInstalled | Transaction::FilterDevel
+            | Transaction::FilterNotDevel | Transaction::FilterArch | Transaction::FilterNotArch
+            | Transaction::FilterSource | Transaction::FilterNotSource;
+}
+
+QStringList MockDaemon::mimeTypes() const
+{
+    return QStringList() << "application/x-deb";
+}
+
+bool MockDaemon::locked() const
+{
+    return false;
+}
+
+uint MockDaemon::networkState() const
+{
+    return PackageKit::Daemon::NetworkOnline;
+}
+
+QString MockDaemon::distroId() const
+{
+    return m_backend->distroId();
+}
+
+uint MockDaemon::CanAuthorize(const QString &actionId)
+{
+    Q_UNUSED(actionId)
+    return PackageKit::Daemon::AuthorizeYes;
+}
+
+QDBusObjectPath MockDaemon::CreateTransaction()
+{
+    QString path = QString("/%1_mock").arg(++m_transactionCount);
+    QObject *object = new QObject(this);
+    MockTransaction *transaction = new MockTransaction(m_backend, path, object);
+    connect(transaction, &MockTransaction::Destroy, this, [this, object, path](){
+        QDBusConnection::systemBus().unregisterObject(path);
+        m_transactions.removeAll(path);
+        emit TransactionListChanged(m_transactions);
+        object->deleteLater();
+    });
+    QDBusConnection::systemBus().registerObject(path, object, QDBusConnection::ExportAdaptors);
+
+    m_transactions.append(path);
+    emit TransactionListChanged(m_transactions);
+    return QDBusObjectPath(path);
+}
+
+uint MockDaemon::GetTimeSinceAction(uint role)
+{
+    Q_UNUSED(role)
+    return 0;
+}
+
+QList<QDBusObjectPath> MockDaemon::GetTransactionList()
+{
+    QList<QDBusObjectPath> transactions;
+    foreach (const QString &path, m_transactions) {
+        transactions.append(QDBusObjectPath(path));
+    }
+    return transactions;
+}
+
+QString MockDaemon::GetDaemonState()
+{
+    return QString("%1 transactions running").arg(m_transactions.count());
+}
+
+void MockDaemon::StateHasChanged(const QString &reason)
+{
+    Q_UNUSED(reason)
+}
+
+void MockDaemon::SuggestDaemonQuit()
+{
+}
+
+MockOffline::MockOffline(QObject *parent):
+    QDBusAbstractAdaptor(parent)
+{
+}
+
+bool MockOffline::updatePrepared() const
+{
+    return false;
+}
+
+bool MockOffline::updateTriggered() const
+{
+    return m_triggered;
+}
+
+bool MockOffline::upgradePrepared() const
+{
+    return false;
+}
+
+bool MockOffline::upgradeTriggered() const
+{
+    return false;
+}
+
+QVariantMap MockOffline::preparedUpgrade() const
+{
+    return QVariantMap();
+}
+
+QString MockOffline::triggerAction() const
+{
+    return m_triggerAction;
+}
+
+void MockOffline::Trigger(const QString &action)
+{
+    setTriggered(true, action);
+}
+
+void MockOffline::TriggerUpgrade(const QString &action)
+{
+    Q_UNUSED(action)
+}
+
+void MockOffline::Cancel()
+{
+    setTriggered(false, "unset");
+}
+
+void MockOffline::ClearResults()
+{
+}
+
+QStringList MockOffline::GetPrepared()
+{
+    return QStringList();
+}
+
+void MockOffline::setTriggered(bool triggered, const QString &action)
+{
+    m_triggered = triggered;
+    m_triggerAction = action;
+
+    QVariantMap properties;
+    properties.insert("UpdateTriggered", m_triggered);
+    properties.insert("TriggerAction", m_triggerAction);
+    QDBusMessage signal = QDBusMessage::createSignal("/org/freedesktop/PackageKit", "org.freedesktop.DBus.Properties", "PropertiesChanged");
+    signal << QString("org.freedesktop.PackageKit.Offline") << properties << QStringList();
+    QDBusConnection::systemBus().send(signal);
+}
+
+MockControl::MockControl(MockBackend *backend, QObject *parent):
+    QDBusAbstractAdaptor(parent),
+    m_backend(backend)
+{
+}
+
+bool MockControl::LoadScript(const QString &fileName)
+{
+    QString errorString;
+    if (!m_backend->load(fileName, &errorString)) {
+        qWarning() << errorString;
+        return false;
+    }
+    emit m_backend->updatesChanged();
+    return true;
+}
+
+QString MockControl::Log()
+{
+    return QString::fromUtf8(QJsonDocument::fromVariant(m_backend->log()).toJson(QJsonDocument::Compact));
+}
+
+void MockControl::ClearLog()
+{
+    m_backend->clearLog();
+}
@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MOCKDAEMON_H
+#define MOCKDAEMON_H
+
+#include <QDBusAbstractAdaptor>
+#include <QDBusObjectPath>
+#include <QStringList>
+#include <QVariantMap>
+
+#include "mockbackend.h"
+
+// org.freedesktop.PackageKit of the mock daemon. Reports an aptcc like backend, creates the
+// transaction objects and forwards the change notifications of the backend.
+class MockDaemon : public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.PackageKit")
+    Q_PROPERTY(uint VersionMajor READ versionMajor)
+    Q_PROPERTY(uint VersionMinor READ versionMinor)
+    Q_PROPERTY(uint VersionMicro READ versionMicro)
+    Q_PROPERTY(QString BackendName READ backendName)
+    Q_PROPERTY(QString BackendDescription READ backendDescription)
+    Q_PROPERTY(QString BackendAuthor READ backendAuthor)
+    Q_PROPERTY(qulonglong Roles READ roles)
+    Q_PROPERTY(qulonglong Groups READ groups)
+    Q_PROPERTY(qulonglong Filters READ filters)
+    Q_PROPERTY(QStringList MimeTypes READ mimeTypes)
+    Q_PROPERTY(bool Locked READ locked)
+    Q_PROPERTY(uint NetworkState READ networkState)
+    Q_PROPERTY(QString DistroId READ distroId)
+
+public:
+    explicit MockDaemon(MockBackend *backend, QObject *parent);
+
+    uint versionMajor() const;
+    uint versionMinor() const;
+    uint versionMicro() const;
+    QString backendName() const;
+    QString backendDescription() const;
+    QString backendAuthor() const;
+    qulonglong roles() const;
+    qulonglong groups() const;
+    qulonglong filters() const;
+    QStringList mimeTypes() const;
+    bool locked() const;
+    uint networkState() const;
+    QString distroId() const;
+
+public slots:
+    uint CanAuthorize(const QString &actionId);
+    QDBusObjectPath CreateTransaction();
+    uint GetTimeSinceAction(uint role);
+    QList<QDBusObjectPath> GetTransactionList();
+    QString GetDaemonState();
+    void StateHasChanged(const QString &reason);
+    void SuggestDaemonQuit();
+
+signals:
+    void TransactionListChanged(const QStringList &transactions);
+    void RestartSchedule();
+    void RepoListChanged();
+    void UpdatesChanged();
+
+private:
+    MockBackend *m_backend = nullptr;
+    int m_transactionCount = 0;
+    QStringList m_transactions;
+};
+
+// org.freedesktop.PackageKit.Offline of the mock daemon. Nothing is ever prepared, triggering
+// only sets the flag.
+class MockOffline : public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.PackageKit.Offline")
+    Q_PROPERTY(bool UpdatePrepared READ updatePrepared)
+    Q_PROPERTY(bool UpdateTriggered READ updateTriggered)
+    Q_PROPERTY(bool UpgradePrepared READ upgradePrepared)
+    Q_PROPERTY(bool UpgradeTriggered READ upgradeTriggered)
+    Q_PROPERTY(QVariantMap PreparedUpgrade READ preparedUpgrade)
+    Q_PROPERTY(QString TriggerAction READ triggerAction)
+
+public:
+    explicit MockOffline(QObject *parent);
+
+    bool updatePrepared() const;
+    bool updateTriggered() const;
+    bool upgradePrepared() const;
+    bool upgradeTriggered() const;
+    QVariantMap preparedUpgrade() const;
+    QString triggerAction() const;
+
+public slots:
+    void Trigger(const QString &action);
+    void TriggerUpgrade(const QString &action);
+    void Cancel();
+    void ClearResults();
+    QStringList GetPrepared();
+
+private:
+    void setTriggered(bool triggered, const QString &action);
+
+    bool m_triggered = false;
+    QString m_triggerAction = "unset";
+};
+
+// io.nymea.MockPackageKit, lets the harness load scripts and read the transaction log
+class MockControl : public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "io.nymea.MockPackageKit")
+
+public:
+    explicit MockControl(MockBackend *backend, QObject *parent);
+
+public slots:
+    bool LoadScript(const QString &fileName);
+    // JSON array of the transactions since the last script load or ClearLog()
+    QString Log();
+    void ClearLog();
+
+private:
+    MockBackend *m_backend = nullptr;
+};
+
+#endif // MOCKDAEMON_H
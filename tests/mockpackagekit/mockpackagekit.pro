@@ -0,0 +1,18 @@
+include(../testcommon.pri)
+
+# A stand-in for packagekitd used by the harness and the tests, not a test of its own
+CONFIG -= testcase
+QT -= testlib
+
+TARGET = mockpackagekit
+
+SOURCES += \
+    main.cpp \
+    mockbackend.cpp \
+    mockdaemon.cpp \
+    mocktransaction.cpp
+
+HEADERS += \
+    mockbackend.h \
+    mockdaemon.h \
+    mocktransaction.h
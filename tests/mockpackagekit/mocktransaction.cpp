@@ -0,0 +1,570 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "mocktransaction.h"
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QTimer>
+
+using PackageKit::Transaction;
+
+MockTransaction::MockTransaction(MockBackend *backend, const QString &path, QObject *parent):
+    QDBusAbstractAdaptor(parent),
+    m_backend(backend),
+    m_path(path)
+{
+    m_logIndex = m_backend->logTransaction(path);
+}
+
+uint MockTransaction::role() const
+{
+    return m_role;
+}
+
+uint MockTransaction::status() const
+{
+    return m_status;
+}
+
+QString MockTransaction::lastPackage() const
+{
+    return m_lastPackage;
+}
+
+uint MockTransaction::uid() const
+{
+    return 0;
+}
+
+QString MockTransaction::senderName() const
+{
+    return QString();
+}
+
+uint MockTransaction::percentage() const
+{
+    return m_percentage;
+}
+
+bool MockTransaction::allowCancel() const
+{
+    return !m_finished;
+}
+
+bool MockTransaction::callerActive() const
+{
+    return true;
+}
+
+uint MockTransaction::elapsedTime() const
+{
+    return m_timer.isValid() ? m_timer.elapsed() : 0;
+}
+
+uint MockTransaction::remainingTime() const
+{
+    return 0;
+}
+
+uint MockTransaction::speed() const
+{
+    return 0;
+}
+
+qulonglong MockTransaction::downloadSizeRemaining() const
+{
+    return 0;
+}
+
+qulonglong MockTransaction::transactionFlags() const
+{
+    return m_transactionFlags;
+}
+
+void MockTransaction::SetHints(const QStringList &hints)
+{
+    m_hints = hints;
+    m_backend->updateLog(m_logIndex, "hints", hints);
+}
+
+void MockTransaction::Cancel()
+{
+    if (m_role == Transaction::RoleUnknown || m_finished) {
+        return;
+    }
+    m_backend->updateLog(m_logIndex, "cancelled", true);
+    emit ErrorCode(Transaction::ErrorTransactionCancelled, "The task was stopped successfully");
+    finish(Transaction::ExitCancelled);
+}
+
+void MockTransaction::SearchNames(qulonglong filter, const QStringList &values)
+{
+    if (!begin(Transaction::RoleSearchName, "SearchNames", QVariantList() << filter << values)) {
+        return;
+    }
+    run([this, filter, values](){
+        foreach (const MockBackend::MockPackage &package, m_backend->packages()) {
+            bool matches = true;
+            foreach (const QString &value, values) {
+                if (!package.name.contains(value, Qt::CaseInsensitive)) {
+                    matches = false;
+                    break;
+                }
+            }
+            if (matches) {
+                emitPackage(package, filter, false);
+            }
+        }
+        finish(Transaction::ExitSuccess);
+    });
+}
+
+void MockTransaction::GetPackages(qulonglong filter)
+{
+    if (!begin(Transaction::RoleGetPackages, "GetPackages", QVariantList() << filter)) {
+        return;
+    }
+    run([this, filter](){
+        foreach (const MockBackend::MockPackage &package, m_backend->packages()) {
+            emitPackage(package, filter, false);
+        }
+        finish(Transaction::ExitSuccess);
+    });
+}
+
+void MockTransaction::Resolve(qulonglong filter, const QStringList &packages)
+{
+    if (!begin(Transaction::RoleResolve, "Resolve", QVariantList() << filter << packages)) {
+        return;
+    }
+    run([this, filter, packages](){
+        // Unknown names are skipped, like aptcc does
+        foreach (const QString &package, packages) {
+            QString name = package.section(';', 0, 0);
+            if (m_backend->contains(name)) {
+                emitPackage(m_backend->package(name), filter, true);
+            }
+        }
+        finish(Transaction::ExitSuccess);
+    });
+}
+
+void MockTransaction::GetUpdates(qulonglong filter)
+{
+    if (!begin(Transaction::RoleGetUpdates, "GetUpdates", QVariantList() << filter)) {
+        return;
+    }
+    run([this, filter](){
+        foreach (const MockBackend::MockPackage &package, m_backend->packages()) {
+            if (package.updateAvailable() && matchesDevelFilter(package, filter)) {
+                emit Package(MockBackend::enumValue("Info", package.updateInfo), package.candidateId(), package.summary);
+            }
+        }
+        finish(Transaction::ExitSuccess);
+    });
+}
+
+void MockTransaction::GetRepoList(qulonglong filter)
+{
+    if (!begin(Transaction::RoleGetRepoList, "GetRepoList", QVariantList() << filter)) {
+        return;
+    }
+    run([this](){
+        foreach (const MockBackend::MockRepository &repository, m_backend->repositories()) {
+            emit RepoDetail(repository.id, repository.description, repository.enabled);
+        }
+        finish(Transaction::ExitSuccess);
+    });
+}
+
+void MockTransaction::RefreshCache(bool force)
+{
+    if (!begin(Transaction::RoleRefreshCache, "RefreshCache", QVariantList() << force)) {
+        return;
+    }
+    setStatus(Transaction::StatusRefreshCache);
+    run([this](){
+        finish(Transaction::ExitSuccess);
+    });
+}
+
+void MockTransaction::RepoEnable(const QString &repoId, bool enabled)
+{
+    if (!begin(Transaction::RoleRepoEnable, "RepoEnable", QVariantList() << repoId << enabled)) {
+        return;
+    }
+    run([this, repoId, enabled](){
+        if (!m_backend->setRepositoryEnabled(repoId, enabled)) {
+            fail(Transaction::ErrorRepoNotFound, QString("Repository %1 not found").arg(repoId));
+            return;
+        }
+        finish(Transaction::ExitSuccess);
+    });
+}
+
+void MockTransaction::GetDetails(const QStringList &packageIds)
+{
+    if (!begin(Transaction::RoleGetDetails, "GetDetails", QVariantList() << packageIds)) {
+        return;
+    }
+    run([this, packageIds](){
+        foreach (const QString &packageId, packageIds) {
+            QString name = packageId.section(';', 0, 0);
+            if (!m_backend->contains(name)) {
+                continue;
+            }
+            MockBackend::MockPackage package = m_backend->package(name);
+            QVariantMap details;
+            details.insert("package-id", packageId);
+            details.insert("summary", package.summary);
+            details.insert("description", package.summary);
+            details.insert("url", "https://nymea.io");
+            details.insert("license", "GPL-3.0+");
+            details.insert("group", static_cast<uint>(Transaction::GroupUnknown));
+            details.insert("size", package.size);
+            details.insert("download-size", package.size / 3);
+            emit Details(details);
+        }
+        finish(Transaction::ExitSuccess);
+    });
+}
+
+void MockTransaction::GetUpdateDetail(const QStringList &packageIds)
+{
+    if (!begin(Transaction::RoleGetUpdateDetail, "GetUpdateDetail", QVariantList() << packageIds)) {
+        return;
+    }
+    run([this, packageIds](){
+        foreach (const QString &packageId, packageIds) {
+            QString name = packageId.section(';', 0, 0);
+            if (!m_backend->contains(name)) {
+                continue;
+            }
+            MockBackend::MockPackage package = m_backend->package(name);
+            QStringList updates;
+            if (!package.installed.isEmpty()) {
+                updates.append(package.installedId());
+            }
+            emit UpdateDetail(packageId, updates, QStringList(), QStringList(), QStringList(), QStringList(),
+                              Transaction::RestartNone, QString("Update to version %1").arg(packageId.section(';', 1, 1)),
+                              package.changelog, Transaction::UpdateStateStable, QString(), QString());
+        }
+        finish(Transaction::ExitSuccess);
+    });
+}
+
+void MockTransaction::UpdatePackages(qulonglong transactionFlags, const QStringList &packageIds)
+{
+    m_transactionFlags = transactionFlags;
+    if (!begin(Transaction::RoleUpdatePackages, "UpdatePackages", QVariantList() << transactionFlags << packageIds)) {
+        return;
+    }
+    if (!validate(OperationUpdate, packageIds)) {
+        return;
+    }
+    if (transactionFlags & Transaction::TransactionFlagSimulate) {
+        run([this, packageIds](){
+            foreach (const QString &packageId, packageIds) {
+                emit Package(Transaction::InfoUpdating, packageId, m_backend->package(packageId.section(';', 0, 0)).summary);
+            }
+            finish(Transaction::ExitSuccess);
+        });
+        return;
+    }
+    startOperation(transactionFlags & Transaction::TransactionFlagOnlyDownload ? OperationDownload : OperationUpdate, packageIds);
+}
+
+void MockTransaction::InstallPackages(qulonglong transactionFlags, const QStringList &packageIds)
+{
+    m_transactionFlags = transactionFlags;
+    if (!begin(Transaction::RoleInstallPackages, "InstallPackages", QVariantList() << transactionFlags << packageIds)) {
+        return;
+    }
+    if (!validate(OperationInstall, packageIds)) {
+        return;
+    }
+    if (transactionFlags & Transaction::TransactionFlagSimulate) {
+        run([this, packageIds](){
+            foreach (const QString &packageId, packageIds) {
+                emit Package(Transaction::InfoInstalling, packageId, m_backend->package(packageId.section(';', 0, 0)).summary);
+            }
+            finish(Transaction::ExitSuccess);
+        });
+        return;
+    }
+    startOperation(transactionFlags & Transaction::TransactionFlagOnlyDownload ? OperationDownload : OperationInstall, packageIds);
+}
+
+void MockTransaction::RemovePackages(qulonglong transactionFlags, const QStringList &packageIds, bool allowDeps, bool autoremove)
+{
+    m_transactionFlags = transactionFlags;
+    if (!begin(Transaction::RoleRemovePackages, "RemovePackages", QVariantList() << transactionFlags << packageIds << allowDeps << autoremove)) {
+        return;
+    }
+    if (!validate(OperationRemove, packageIds)) {
+        return;
+    }
+    if (transactionFlags & Transaction::TransactionFlagSimulate) {
+        run([this, packageIds](){
+            foreach (const QString &packageId, packageIds) {
+                emit Package(Transaction::InfoRemoving, packageId, m_backend->package(packageId.section(';', 0, 0)).summary);
+            }
+            finish(Transaction::ExitSuccess);
+        });
+        return;
+    }
+    startOperation(OperationRemove, packageIds);
+}
+
+void MockTransaction::DownloadPackages(bool storeInCache, const QStringList &packageIds)
+{
+    if (!begin(Transaction::RoleDownloadPackages, "DownloadPackages", QVariantList() << storeInCache << packageIds)) {
+        return;
+    }
+    if (!validate(OperationDownload, packageIds)) {
+        return;
+    }
+    startOperation(OperationDownload, packageIds);
+}
+
+bool MockTransaction::begin(Transaction::Role role, const QString &method, const QVariantList &arguments)
+{
+    if (m_role != Transaction::RoleUnknown) {
+        qWarning() << "Transaction" << m_path << "already used for" << m_method << "- ignoring" << method;
+        return false;
+    }
+    m_role = role;
+    m_method = method;
+    m_timer.start();
+    m_backend->updateLog(m_logIndex, "method", method);
+    m_backend->updateLog(m_logIndex, "role", MockBackend::enumName("Role", role));
+    m_backend->updateLog(m_logIndex, "arguments", arguments);
+    m_backend->updateLog(m_logIndex, "started", m_backend->elapsed());
+
+    QVariantMap properties;
+    properties.insert("Role", static_cast<uint>(m_role));
+    propertiesChanged(properties);
+    setStatus(Transaction::StatusRunning);
+
+    uint code;
+    QString details;
+    if (m_backend->takeError(method, &code, &details)) {
+        run([this, code, details](){
+            fail(static_cast<Transaction::Error>(code), details);
+        });
+        return false;
+    }
+    return true;
+}
+
+void MockTransaction::run(const std::function<void()> &function)
+{
+    QTimer::singleShot(m_backend->delay(m_method), this, [this, function](){
+        // Cancelled in the meantime
+        if (!m_finished) {
+            function();
+        }
+    });
+}
+
+void MockTransaction::fail(Transaction::Error error, const QString &details)
+{
+    m_backend->updateLog(m_logIndex, "error", MockBackend::enumName("Error", error));
+    emit ErrorCode(error, details);
+    finish(Transaction::ExitFailed);
+}
+
+void MockTransaction::finish(Transaction::Exit exit)
+{
+    if (m_finished) {
+        return;
+    }
+    m_finished = true;
+    m_status = Transaction::StatusFinished;
+    m_percentage = 100;
+
+    QVariantMap properties;
+    properties.insert("Status", static_cast<uint>(m_status));
+    properties.insert("Percentage", m_percentage);
+    propertiesChanged(properties);
+
+    uint runtime = m_timer.elapsed();
+    m_backend->updateLog(m_logIndex, "exit", MockBackend::enumName("Exit", exit));
+    m_backend->updateLog(m_logIndex, "runtime", runtime);
+    emit Finished(exit, runtime);
+
+    // packagekitd keeps finished transactions around for a moment before destroying them
+    QTimer::singleShot(100, this, &MockTransaction::Destroy);
+}
+
+void MockTransaction::setStatus(Transaction::Status status)
+{
+    m_status = status;
+    QVariantMap properties;
+    properties.insert("Status", static_cast<uint>(m_status));
+    propertiesChanged(properties);
+}
+
+void MockTransaction::propertiesChanged(const QVariantMap &properties)
+{
+    QDBusMessage signal = QDBusMessage::createSignal(m_path, "org.freedesktop.DBus.Properties", "PropertiesChanged");
+    signal << QString("org.freedesktop.PackageKit.Transaction") << properties << QStringList();
+    QDBusConnection::systemBus().send(signal);
+}
+
+bool MockTransaction::matchesDevelFilter(const MockBackend::MockPackage &package, qulonglong filter)
+{
+    if (filter & Transaction::FilterDevel) {
+        return package.devel;
+    }
+    if (filter & Transaction::FilterNotDevel) {
+        return !package.devel;
+    }
+    return true;
+}
+
+void MockTransaction::emitPackage(const MockBackend::MockPackage &package, qulonglong filter, bool bothVersions)
+{
+    if (!matchesDevelFilter(package, filter)) {
+        return;
+    }
+    bool installed = !package.installed.isEmpty();
+    if (installed && !(filter & Transaction::FilterNotInstalled)) {
+        emit Package(Transaction::InfoInstalled, package.installedId(), package.summary);
+    }
+    if (filter & Transaction::FilterInstalled) {
+        return;
+    }
+    if (!package.candidate.isEmpty() && (!installed || (bothVersions && package.updateAvailable()))) {
+        emit Package(Transaction::InfoAvailable, package.candidateId(), package.summary);
+    }
+}
+
+bool MockTransaction::validate(Operation operation, const QStringList &packageIds)
+{
+    foreach (const QString &packageId, packageIds) {
+        QStringList parts = packageId.split(';');
+        MockBackend::MockPackage package = m_backend->package(parts.first());
+        QString version = operation == OperationRemove ? package.installed : package.candidate;
+        if (parts.count() != 4 || version.isEmpty() || parts.at(1) != version) {
+            Transaction::Error error = operation == OperationRemove ? Transaction::ErrorPackageNotInstalled : Transaction::ErrorPackageNotFound;
+            run([this, error, packageId](){
+                fail(error, QString("Package %1 not found").arg(packageId));
+            });
+            return false;
+        }
+    }
+    return true;
+}
+
+void MockTransaction::startOperation(Operation operation, const QStringList &packageIds)
+{
+    m_operation = operation;
+    m_operationIds = packageIds;
+    m_operationIndex = 0;
+
+    switch (operation) {
+    case OperationUpdate:
+        setStatus(Transaction::StatusUpdate);
+        break;
+    case OperationInstall:
+        setStatus(Transaction::StatusInstall);
+        break;
+    case OperationRemove:
+        setStatus(Transaction::StatusRemove);
+        break;
+    case OperationDownload:
+        setStatus(Transaction::StatusDownload);
+        break;
+    }
+    run([this](){
+        processNext();
+    });
+}
+
+void MockTransaction::processNext()
+{
+    if (m_finished) {
+        return;
+    }
+    if (m_operationIndex >= m_operationIds.count()) {
+        if (m_operation != OperationDownload) {
+            m_backend->packagesModified();
+        }
+        finish(Transaction::ExitSuccess);
+        return;
+    }
+
+    QString packageId = m_operationIds.at(m_operationIndex++);
+    QStringList parts = packageId.split(';');
+    MockBackend::MockPackage package = m_backend->package(parts.first());
+
+    Transaction::Info info = Transaction::InfoUpdating;
+    switch (m_operation) {
+    case OperationUpdate:
+        info = Transaction::InfoUpdating;
+        break;
+    case OperationInstall:
+        info = Transaction::InfoInstalling;
+        break;
+    case OperationRemove:
+        info = Transaction::InfoRemoving;
+        break;
+    case OperationDownload:
+        info = Transaction::InfoDownloading;
+        break;
+    }
+    m_lastPackage = packageId;
+    emit Package(info, packageId, package.summary);
+    emit ItemProgress(packageId, m_status, 100);
+
+    // Another transaction might have removed it in the meantime
+    switch (m_backend->contains(package.name) ? m_operation : OperationDownload) {
+    case OperationUpdate:
+    case OperationInstall:
+        package.installed = parts.at(1);
+        m_backend->setPackage(package);
+        break;
+    case OperationRemove:
+        package.installed.clear();
+        if (package.candidate.isEmpty()) {
+            m_backend->removePackage(package.name);
+        } else {
+            m_backend->setPackage(package);
+        }
+        break;
+    case OperationDownload:
+        break;
+    }
+    emit Package(Transaction::InfoFinished, packageId, package.summary);
+
+    m_percentage = m_operationIndex * 100 / m_operationIds.count();
+    QVariantMap properties;
+    properties.insert("LastPackage", m_lastPackage);
+    properties.insert("Percentage", m_percentage);
+    propertiesChanged(properties);
+
+    QTimer::singleShot(m_backend->packageDelay(), this, &MockTransaction::processNext);
+}
@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MOCKTRANSACTION_H
+#define MOCKTRANSACTION_H
+
+#include <QDBusAbstractAdaptor>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QVariantMap>
+
+#include <functional>
+
+#include <Transaction>
+
+#include "mockbackend.h"
+
+// org.freedesktop.PackageKit.Transaction of the mock daemon.
+//
+// Like in packagekitd, every transaction object runs exactly one role. Results are emitted after
+// the scripted delay of the method, updates, installs, removals and downloads process their packages
+// one by one with the per package delay and report progress in between. Searches behave like the
+// aptcc backend: one package per name, the installed version or else the candidate. Resolve emits
+// both.
+class MockTransaction : public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.PackageKit.Transaction")
+    Q_PROPERTY(uint Role READ role)
+    Q_PROPERTY(uint Status READ status)
+    Q_PROPERTY(QString LastPackage READ lastPackage)
+    Q_PROPERTY(uint Uid READ uid)
+    Q_PROPERTY(QString Sender READ senderName)
+    Q_PROPERTY(uint Percentage READ percentage)
+    Q_PROPERTY(bool AllowCancel READ allowCancel)
+    Q_PROPERTY(bool CallerActive READ callerActive)
+    Q_PROPERTY(uint ElapsedTime READ elapsedTime)
+    Q_PROPERTY(uint RemainingTime READ remainingTime)
+    Q_PROPERTY(uint Speed READ speed)
+    Q_PROPERTY(qulonglong DownloadSizeRemaining READ downloadSizeRemaining)
+    Q_PROPERTY(qulonglong TransactionFlags READ transactionFlags)
+
+public:
+    explicit MockTransaction(MockBackend *backend, const QString &path, QObject *parent);
+
+    uint role() const;
+    uint status() const;
+    QString lastPackage() const;
+    uint uid() const;
+    QString senderName() const;
+    uint percentage() const;
+    bool allowCancel() const;
+    bool callerActive() const;
+    uint elapsedTime() const;
+    uint remainingTime() const;
+    uint speed() const;
+    qulonglong downloadSizeRemaining() const;
+    qulonglong transactionFlags() const;
+
+public slots:
+    void SetHints(const QStringList &hints);
+    void Cancel();
+
+    void SearchNames(qulonglong filter, const QStringList &values);
+    void GetPackages(qulonglong filter);
+    void Resolve(qulonglong filter, const QStringList &packages);
+    void GetUpdates(qulonglong filter);
+    void GetRepoList(qulonglong filter);
+    void RefreshCache(bool force);
+    void RepoEnable(const QString &repoId, bool enabled);
+    void GetDetails(const QStringList &packageIds);
+    void GetUpdateDetail(const QStringList &packageIds);
+    void UpdatePackages(qulonglong transactionFlags, const QStringList &packageIds);
+    void InstallPackages(qulonglong transactionFlags, const QStringList &packageIds);
+    void RemovePackages(qulonglong transactionFlags, const QStringList &packageIds, bool allowDeps, bool autoremove);
+    void DownloadPackages(bool storeInCache, const QStringList &packageIds);
+
+signals:
+    void Package(uint info, const QString &packageId, const QString &summary);
+    void Details(const QVariantMap &data);
+    void UpdateDetail(const QString &packageId, const QStringList &updates, const QStringList &obsoletes,
+                      const QStringList &vendorUrls, const QStringList &bugzillaUrls, const QStringList &cveUrls,
+                      uint restart, const QString &updateText, const QString &changelog, uint state,
+                      const QString &issued, const QString &updated);
+    void RepoDetail(const QString &repoId, const QString &description, bool enabled);
+    void ItemProgress(const QString &itemId, uint status, uint percentage);
+    void ErrorCode(uint code, const QString &details);
+    void Finished(uint exit, uint runtime);
+    void Destroy();
+
+private:
+    enum Operation {
+        OperationUpdate,
+        OperationInstall,
+        OperationRemove,
+        OperationDownload
+    };
+
+    bool begin(PackageKit::Transaction::Role role, const QString &method, const QVariantList &arguments);
+    void run(const std::function<void()> &function);
+    void fail(PackageKit::Transaction::Error error, const QString &details);
+    void finish(PackageKit::Transaction::Exit exit);
+    void setStatus(PackageKit::Transaction::Status status);
+    void propertiesChanged(const QVariantMap &properties);
+
+    static bool matchesDevelFilter(const MockBackend::MockPackage &package, qulonglong filter);
+    void emitPackage(const MockBackend::MockPackage &package, qulonglong filter, bool bothVersions);
+    bool validate(Operation operation, const QStringList &packageIds);
+    void startOperation(Operation operation, const QStringList &packageIds);
+    void processNext();
+
+    MockBackend *m_backend = nullptr;
+    QString m_path;
+    QStringList m_hints;
+    int m_logIndex = -1;
+    QElapsedTimer m_timer;
+
+    QString m_method;
+    PackageKit::Transaction::Role m_role = PackageKit::Transaction::RoleUnknown;
+    PackageKit::Transaction::Status m_status = PackageKit::Transaction::StatusWait;
+    QString m_lastPackage;
+    uint m_percentage = 0;
+    qulonglong m_transactionFlags = 0;
+    bool m_finished = false;
+
+    Operation m_operation = OperationUpdate;
+    QStringList m_operationIds;
+    int m_operationIndex = 0;
+};
+
+#endif // MOCKTRANSACTION_H
@@ -0,0 +1,23 @@
+# Shared setup of the test and benchmark executables. They build the plugin sources they
+# exercise directly, so they don't depend on an installed plugin.
+
+QT += testlib dbus
+QT -= gui
+
+CONFIG += testcase link_pkgconfig
+CONFIG -= app_bundle
+PKGCONFIG += nymea
+
+greaterThan(QT_MAJOR_VERSION, 5) {
+    CONFIG *= c++17
+    INCLUDEPATH += /usr/include/packagekitqt6/PackageKit
+    LIBS += -lpackagekitqt6
+} else {
+    CONFIG *= c++11
+    DEFINES += QT_DISABLE_DEPRECATED_UP_TO=0x050F00
+    INCLUDEPATH += /usr/include/packagekitqt5/PackageKit
+    LIBS += -lpackagekitqt5
+}
+
+PLUGIN_SOURCE_DIR = $$PWD/..
+INCLUDEPATH += $$PLUGIN_SOURCE_DIR
@@ -0,0 +1,10 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    mockpackagekit \
+    auto \
+    benchmarks \
+    harness
+
+auto.depends = mockpackagekit
+harness.depends = mockpackagekit
@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "transactiongraph.h"
+#include "loggingcategories.h"
+
+TransactionGraph::TransactionGraph(const QString &name, QObject *parent):
+    QObject(parent),
+    m_name(name)
+{
+
+}
+
+QString TransactionGraph::name() const
+{
+    return m_name;
+}
+
+int TransactionGraph::addStep(const QString &name, const Factory &factory, const QList<int> &dependencies)
+{
+    Q_ASSERT_X(!m_finished, "TransactionGraph", "Steps can't be added to a finished graph");
+    Step step;
+    step.name = name;
+    step.factory = factory;
+    step.dependencies = dependencies;
+    m_steps.append(step);
+    return m_steps.count() - 1;
+}
+
+void TransactionGraph::start()
+{
+    m_started = true;
+    startReadySteps();
+}
+
+void TransactionGraph::setGate(const Gate &gate)
+{
+    m_gate = gate;
+}
+
+void TransactionGraph::resume()
+{
+    if (m_started && !m_finished) {
+        startReadySteps();
+    }
+}
+
+bool TransactionGraph::succeeded() const
+{
+    foreach (const Step &step, m_steps) {
+        if (step.state != StepStateSucceeded) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TransactionGraph::succeeded(int step) const
+{
+    return step >= 0 && step < m_steps.count() && m_steps.at(step).state == StepStateSucceeded;
+}
+
+QStringList TransactionGraph::errors() const
+{
+    return m_errors;
+}
+
+void TransactionGraph::startReadySteps()
+{
+    m_gated = false;
+    for (int i = 0; i < m_steps.count(); i++) {
+        if (m_steps.at(i).state != StepStatePending) {
+            continue;
+        }
+
+        bool ready = true;
+        bool skip = false;
+        foreach (int dependency, m_steps.at(i).dependencies) {
+            StepState dependencyState = m_steps.at(dependency).state;
+            if (dependencyState == StepStateFailed || dependencyState == StepStateSkipped) {
+                skip = true;
+            } else if (dependencyState != StepStateSucceeded) {
+                ready = false;
+            }
+        }
+        if (skip) {
+            qCDebug(dcPlatformUpdate()) << "Skipping step" << m_steps.at(i).name << "of" << m_name << "because a dependency failed";
+            m_steps[i].state = StepStateSkipped;
+            // Might unblock or skip steps we've already passed
+            i = -1;
+            continue;
+        }
+        if (!ready) {
+            continue;
+        }
+
+        if (m_gate && !m_gate(m_steps.at(i).name)) {
+            m_gated = true;
+            continue;
+        }
+
+        // The factory may add steps, which can move the step we're looking at
+        Factory factory = m_steps.at(i).factory;
+        PackageKit::Transaction *transaction = factory();
+        if (!transaction) {
+            qCDebug(dcPlatformUpdate()) << "Nothing to do for step" << m_steps.at(i).name << "of" << m_name;
+            m_steps[i].state = StepStateSucceeded;
+            i = -1;
+            continue;
+        }
+
+        m_steps[i].state = StepStateRunning;
+        m_steps[i].transaction = transaction;
+        m_runningSteps++;
+
+        connect(transaction, &PackageKit::Transaction::errorCode, this, [this, i](PackageKit::Transaction::Error error, const QString &details){
+            m_errors.append(QString("%1: %2 (%3)").arg(m_steps.at(i).name).arg(details).arg(error));
+        });
+        connect(transaction, &PackageKit::Transaction::finished, this, [this, i](PackageKit::Transaction::Exit status, uint runtime){
+            Q_UNUSED(runtime)
+            finishStep(i, status == PackageKit::Transaction::ExitSuccess);
+        });
+        emit transactionStarted(transaction, m_steps.at(i).name);
+    }
+
+    if (m_runningSteps == 0 && !m_gated && !m_finished) {
+        m_finished = true;
+        bool success = succeeded();
+        qCDebug(dcPlatformUpdate()) << "Transaction graph" << m_name << "finished" << (success ? "successfully" : "with errors") << m_errors;
+        emit finished(success);
+        deleteLater();
+    }
+}
+
+void TransactionGraph::finishStep(int step, bool success)
+{
+    // libpackagekitqt5 < 1.0 has a bug and emits the finished singal twice on getPackages.
+    // We need to make sure we only handle it once. Could probably go away when everyone is upgraded
+    // to libpackagekitqt5 >= 1.0.
+    if (m_steps.at(step).state != StepStateRunning) {
+        qCWarning(dcPlatformUpdate) << "Transaction emitted finished twice! Ignoring second event. (Old packagekitqt version?)";
+        return;
+    }
+
+    m_steps[step].state = success ? StepStateSucceeded : StepStateFailed;
+    m_runningSteps--;
+    startReadySteps();
+}
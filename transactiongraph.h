@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef TRANSACTIONGRAPH_H
+#define TRANSACTIONGRAPH_H
+
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+
+#include <functional>
+
+#include <Transaction>
+
+// Runs a set of PackageKit transactions as a dependency graph.
+//
+// Each step is created by its factory once all of its dependencies have finished successfully, so
+// independent steps run concurrently. Factories may return nullptr if there is nothing to do for a
+// step. If a step fails, steps depending on it are skipped.
+//
+// The graph deletes itself after emitting finished(). State shared between the steps should be captured
+// by the factories and connected to transaction signals with the graph as context object. That way it
+// lives exactly as long as the graph, no matter in which step an error occurs.
+//
+// Steps may also be added while the graph is running, e.g. by a factory splitting its work into
+// several steps. A gate can hold back steps which are ready; call resume() once it would let them pass.
+class TransactionGraph : public QObject
+{
+    Q_OBJECT
+public:
+    typedef std::function<PackageKit::Transaction*()> Factory;
+    typedef std::function<bool(const QString &step)> Gate;
+
+    explicit TransactionGraph(const QString &name, QObject *parent = nullptr);
+
+    QString name() const;
+
+    int addStep(const QString &name, const Factory &factory, const QList<int> &dependencies = QList<int>());
+    void start();
+
+    void setGate(const Gate &gate);
+    void resume();
+
+    bool succeeded() const;
+    bool succeeded(int step) const;
+    QStringList errors() const;
+
+signals:
+    void transactionStarted(PackageKit::Transaction *transaction, const QString &step);
+    void finished(bool success);
+
+private:
+    enum StepState {
+        StepStatePending,
+        StepStateRunning,
+        StepStateSucceeded,
+        StepStateFailed,
+        StepStateSkipped
+    };
+
+    class Step {
+    public:
+        QString name;
+        Factory factory;
+        QList<int> dependencies;
+        StepState state = StepStatePending;
+        QPointer<PackageKit::Transaction> transaction;
+    };
+
+    void startReadySteps();
+    void finishStep(int step, bool success);
+
+    QString m_name;
+    QList<Step> m_steps;
+    QStringList m_errors;
+    int m_runningSteps = 0;
+    Gate m_gate;
+    bool m_gated = false;
+    bool m_started = false;
+    bool m_finished = false;
+};
+
+#endif // TRANSACTIONGRAPH_H
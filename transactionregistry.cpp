@@ -0,0 +1,288 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "transactionregistry.h"
+#include "loggingcategories.h"
+
+#include <QMetaEnum>
+#include <QSaveFile>
+#include <QJsonDocument>
+
+#include <algorithm>
+
+qint64 TransactionRegistry::Record::duration() const
+{
+    return finishedAt < 0 ? -1 : finishedAt - createdAt;
+}
+
+qint64 TransactionRegistry::Record::queueWait() const
+{
+    if (activeAt >= 0) {
+        return activeAt - createdAt;
+    }
+    // Never saw the daemon working on it, it was queued the whole time
+    return duration();
+}
+
+QVariantMap TransactionRegistry::Record::toVariantMap() const
+{
+    QVariantMap map;
+    map.insert("role", role);
+    map.insert("started", started.toString(Qt::ISODateWithMs));
+    map.insert("duration", duration());
+    map.insert("queueWait", queueWait());
+    map.insert("packages", packages);
+    map.insert("repositories", repositories);
+    map.insert("errors", errors);
+    map.insert("exit", exit);
+    return map;
+}
+
+QVariantMap TransactionRegistry::Cycle::toVariantMap() const
+{
+    QVariantMap map;
+    map.insert("name", name);
+    map.insert("wallTime", wallTime);
+    map.insert("packages", packages);
+    map.insert("success", success);
+    return map;
+}
+
+TransactionRegistry::TransactionRegistry(QObject *parent):
+    QObject(parent)
+{
+    m_clock.start();
+    m_clockStart = QDateTime::currentDateTime();
+}
+
+int TransactionRegistry::windowSize() const
+{
+    return m_windowSize;
+}
+
+void TransactionRegistry::setWindowSize(int windowSize)
+{
+    m_windowSize = qMax(1, windowSize);
+}
+
+void TransactionRegistry::track(PackageKit::Transaction *transaction)
+{
+    if (m_running.contains(transaction)) {
+        return;
+    }
+
+    Record record;
+    record.started = QDateTime::currentDateTime();
+    record.createdAt = m_clock.elapsed();
+    m_running.insert(transaction, record);
+
+    connect(transaction, &PackageKit::Transaction::statusChanged, this, [this, transaction](){
+        if (!m_running.contains(transaction) || m_running.value(transaction).activeAt >= 0) {
+            return;
+        }
+        switch (transaction->status()) {
+        case PackageKit::Transaction::StatusUnknown:
+        case PackageKit::Transaction::StatusWait:
+        case PackageKit::Transaction::StatusSetup:
+        case PackageKit::Transaction::StatusWaitingForLock:
+            break;
+        default:
+            m_running[transaction].activeAt = m_clock.elapsed();
+        }
+    });
+    connect(transaction, &PackageKit::Transaction::package, this, [this, transaction](){
+        if (m_running.contains(transaction)) {
+            m_running[transaction].packages++;
+        }
+    });
+    connect(transaction, &PackageKit::Transaction::repoDetail, this, [this, transaction](){
+        if (m_running.contains(transaction)) {
+            m_running[transaction].repositories++;
+        }
+    });
+    connect(transaction, &PackageKit::Transaction::errorCode, this, [this, transaction](PackageKit::Transaction::Error error, const QString &details){
+        if (m_running.contains(transaction)) {
+            m_running[transaction].errors.append(QString("%1: %2").arg(enumToString("Error", error)).arg(details));
+        }
+    });
+    connect(transaction, &PackageKit::Transaction::finished, this, [this, transaction](PackageKit::Transaction::Exit status){
+        finish(transaction, status);
+    });
+}
+
+quint64 TransactionRegistry::beginCycle(const QString &name)
+{
+    RunningCycle cycle;
+    cycle.name = name;
+    cycle.startedAt = m_clock.elapsed();
+
+    quint64 id = m_nextCycle++;
+    m_runningCycles.insert(id, cycle);
+    return id;
+}
+
+void TransactionRegistry::endCycle(quint64 cycle, bool success, int packages)
+{
+    if (!m_runningCycles.contains(cycle)) {
+        return;
+    }
+    RunningCycle runningCycle = m_runningCycles.take(cycle);
+
+    Cycle result;
+    result.name = runningCycle.name;
+    result.wallTime = m_clock.elapsed() - runningCycle.startedAt;
+    result.packages = packages;
+    result.success = success;
+
+    appendToWindow(m_cycleWallTimes[result.name], result.wallTime, m_windowSize);
+    m_cycles.append(result);
+    while (m_cycles.count() > m_windowSize) {
+        m_cycles.removeFirst();
+    }
+
+    qCDebug(dcPlatformUpdate()) << "Cycle" << result.name << (success ? "succeeded" : "failed") << "after" << result.wallTime << "ms," << packages << "packages";
+    emit cycleFinished(result);
+}
+
+int TransactionRegistry::runningCount() const
+{
+    return m_running.count();
+}
+
+QVariantList TransactionRegistry::history() const
+{
+    QVariantList ret;
+    foreach (const Record &record, m_history) {
+        ret.append(record.toVariantMap());
+    }
+    return ret;
+}
+
+QVariantMap TransactionRegistry::statistics() const
+{
+    QVariantMap roles;
+    foreach (const QString &role, m_totals.keys()) {
+        QVariantMap entry;
+        entry.insert("count", m_totals.value(role));
+        entry.insert("failures", m_failures.value(role));
+        entry.insert("duration", percentiles(m_durations.value(role)));
+        entry.insert("queueWait", percentiles(m_queueWaits.value(role)));
+        roles.insert(role, entry);
+    }
+    QVariantMap cycles;
+    foreach (const QString &name, m_cycleWallTimes.keys()) {
+        QVariantMap entry;
+        entry.insert("wallTime", percentiles(m_cycleWallTimes.value(name)));
+        cycles.insert(name, entry);
+    }
+    QVariantMap ret;
+    ret.insert("since", m_clockStart.toString(Qt::ISODateWithMs));
+    ret.insert("running", m_running.count());
+    ret.insert("roles", roles);
+    ret.insert("cycles", cycles);
+    return ret;
+}
+
+QByteArray TransactionRegistry::exportJson() const
+{
+    QVariantMap map = statistics();
+    map.insert("history", history());
+    QVariantList cycles;
+    foreach (const Cycle &cycle, m_cycles) {
+        cycles.append(cycle.toVariantMap());
+    }
+    map.insert("cycleHistory", cycles);
+    return QJsonDocument::fromVariant(map).toJson(QJsonDocument::Indented);
+}
+
+bool TransactionRegistry::exportToFile(const QString &fileName) const
+{
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly) || file.write(exportJson()) < 0 || !file.commit()) {
+        qCWarning(dcPlatformUpdate()) << "Failed to export transaction metrics to" << fileName << ":" << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+void TransactionRegistry::finish(PackageKit::Transaction *transaction, PackageKit::Transaction::Exit status)
+{
+    // Old packagekitqt versions may emit finished twice
+    if (!m_running.contains(transaction)) {
+        return;
+    }
+
+    Record record = m_running.take(transaction);
+    record.finishedAt = m_clock.elapsed();
+    record.role = enumToString("Role", transaction->role());
+    record.exit = enumToString("Exit", status);
+
+    m_totals[record.role]++;
+    if (status != PackageKit::Transaction::ExitSuccess) {
+        m_failures[record.role]++;
+    }
+
+    appendToWindow(m_durations[record.role], record.duration(), m_windowSize);
+    appendToWindow(m_queueWaits[record.role], record.queueWait(), m_windowSize);
+
+    m_history.append(record);
+    while (m_history.count() > m_windowSize) {
+        m_history.removeFirst();
+    }
+
+    qCDebug(dcPlatformUpdate()) << "Transaction" << record.role << record.exit << "after" << record.duration() << "ms (queued" << record.queueWait() << "ms," << record.packages << "packages," << record.repositories << "repositories)";
+    emit transactionFinished(record);
+}
+
+QVariantMap TransactionRegistry::percentiles(QList<qint64> values)
+{
+    QVariantMap ret;
+    if (values.isEmpty()) {
+        return ret;
+    }
+    std::sort(values.begin(), values.end());
+    int last = values.count() - 1;
+    ret.insert("p50", values.at(last * 50 / 100));
+    ret.insert("p95", values.at(last * 95 / 100));
+    ret.insert("p99", values.at(last * 99 / 100));
+    ret.insert("max", values.at(last));
+    return ret;
+}
+
+void TransactionRegistry::appendToWindow(QList<qint64> &window, qint64 value, int windowSize)
+{
+    window.append(value);
+    while (window.count() > windowSize) {
+        window.removeFirst();
+    }
+}
+
+QString TransactionRegistry::enumToString(const char *enumName, int value)
+{
+    const QMetaObject &metaObject = PackageKit::Transaction::staticMetaObject;
+    QMetaEnum metaEnum = metaObject.enumerator(metaObject.indexOfEnumerator(enumName));
+    const char *key = metaEnum.valueToKey(value);
+    return key ? QString(key) : QString::number(value);
+}
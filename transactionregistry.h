@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef TRANSACTIONREGISTRY_H
+#define TRANSACTIONREGISTRY_H
+
+#include <QObject>
+#include <QHash>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QVariantMap>
+
+#include <Transaction>
+
+// Records timing and outcome of every PackageKit transaction we start.
+//
+// For each role the durations and queue wait times of the most recent transactions are kept in a
+// rolling window, from which percentiles are computed on request. The history of finished
+// transactions is bounded as well.
+class TransactionRegistry : public QObject
+{
+    Q_OBJECT
+public:
+    class Record {
+    public:
+        QString role;
+        QDateTime started;
+        qint64 createdAt = 0;   // ms since registry start
+        qint64 activeAt = -1;   // when the daemon started working on it, -1 while queued
+        qint64 finishedAt = -1;
+        quint32 packages = 0;
+        quint32 repositories = 0;
+        QStringList errors;
+        QString exit;
+
+        qint64 duration() const;
+        qint64 queueWait() const;
+        QVariantMap toVariantMap() const;
+    };
+
+    // Duration of a whole pipeline run (refresh, update, remove). CPU time and memory can't be
+    // attributed to a cycle from inside nymead, cycles overlap and share the process with everything
+    // else. The benchmark harness in tests/harness measures those for isolated cycles.
+    class Cycle {
+    public:
+        QString name;
+        qint64 wallTime = 0; // ms
+        int packages = 0;
+        bool success = false;
+
+        QVariantMap toVariantMap() const;
+    };
+
+    explicit TransactionRegistry(QObject *parent = nullptr);
+
+    int windowSize() const;
+    void setWindowSize(int windowSize);
+
+    void track(PackageKit::Transaction *transaction);
+
+    quint64 beginCycle(const QString &name);
+    void endCycle(quint64 cycle, bool success, int packages);
+
+    int runningCount() const;
+    QVariantList history() const;
+    QVariantMap statistics() const;
+
+    QByteArray exportJson() const;
+    bool exportToFile(const QString &fileName) const;
+
+    static QString enumToString(const char *enumName, int value);
+
+signals:
+    void transactionFinished(const TransactionRegistry::Record &record);
+    void cycleFinished(const TransactionRegistry::Cycle &cycle);
+
+private:
+    void finish(PackageKit::Transaction *transaction, PackageKit::Transaction::Exit status);
+    static QVariantMap percentiles(QList<qint64> values);
+    static void appendToWindow(QList<qint64> &window, qint64 value, int windowSize);
+
+    class RunningCycle {
+    public:
+        QString name;
+        qint64 startedAt = 0;
+    };
+
+    QElapsedTimer m_clock;
+    QDateTime m_clockStart;
+    int m_windowSize = 100;
+
+    QHash<PackageKit::Transaction*, Record> m_running;
+    QList<Record> m_history;
+    QHash<QString, QList<qint64> > m_durations;  // <role, rolling window>
+    QHash<QString, QList<qint64> > m_queueWaits; // <role, rolling window>
+    QHash<QString, quint32> m_totals;
+    QHash<QString, quint32> m_failures;
+
+    quint64 m_nextCycle = 1;
+    QHash<quint64, RunningCycle> m_runningCycles;
+    QList<Cycle> m_cycles;
+    QHash<QString, QList<qint64> > m_cycleWallTimes; // <name, rolling window>
+};
+
+#endif // TRANSACTIONREGISTRY_H
@@ -24,23 +24,107 @@
 
 #include "updatecontrollerpackagekit.h"
 #include "loggingcategories.h"
+#include "nymeasettings.h"
+#include "packagesnapshot.h"
+#include "nativepackagereader.h"
 
 #include <Daemon>
 #include <Details>
+#include <Offline>
 
 #include <QTimer>
 #include <QPointer>
-#include <QFile>
-#include <QRegularExpression>
+#include <QSettings>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <QDBusPendingCallWatcher>
+
+#include <limits>
+
+// QSet::fromList() is gone in Qt 6 and the range constructor needs Qt 5.14
+static QSet<QString> toSet(const QStringList &list)
+{
+    QSet<QString> set;
+    foreach (const QString &entry, list) {
+        set.insert(entry);
+    }
+    return set;
+}
 
 UpdateControllerPackageKit::UpdateControllerPackageKit(QObject *parent):
     PlatformUpdateController(parent)
 {
     m_refreshTimer = new QTimer(this);
     m_refreshTimer->setSingleShot(true);
-    m_refreshTimer->setInterval(6 * 60 * 60 * 1000); // every 6 hours
     connect(m_refreshTimer, &QTimer::timeout, this, &UpdateControllerPackageKit::checkForUpdates);
 
+    m_refreshScheduler = new RefreshScheduler(this);
+    connect(m_refreshScheduler, &RefreshScheduler::refreshRequested, this, &UpdateControllerPackageKit::refreshFromPackageKit);
+    connect(m_refreshScheduler, &RefreshScheduler::packagesRefreshRequested, this, &UpdateControllerPackageKit::refreshPackages);
+
+    m_transactionRegistry = new TransactionRegistry(this);
+    m_tracer = new UpdateTracer(this);
+
+    m_repositoryBatchTimer = new QTimer(this);
+    m_repositoryBatchTimer->setSingleShot(true);
+    m_repositoryBatchTimer->setInterval(200);
+    connect(m_repositoryBatchTimer, &QTimer::timeout, this, &UpdateControllerPackageKit::applyRepositoryChanges);
+
+    // PlatformUpdateController has no progress member, nymead only sees updateRunning(). The rate limited progress is logged.
+    m_updateProgress = new UpdateProgress(this);
+    connect(m_updateProgress, &UpdateProgress::progressChanged, this, [this](){
+        QVariantMap progress = m_updateProgress->toVariantMap();
+        qCDebug(dcPlatformUpdate()) << "Progress of" << progress.value("operation").toString() << progress.value("percentage").toInt() << "%"
+                                    << progress.value("phase").toString() << progress.value("bytesRemaining").toULongLong() << "bytes remaining at"
+                                    << progress.value("speed").toUInt() << "bytes/s";
+    });
+
+    m_retryTimer = new QTimer(this);
+    m_retryTimer->setSingleShot(true);
+    connect(m_retryTimer, &QTimer::timeout, this, [this](){
+        QSharedPointer<UpdatePlan> plan = m_retryPlan;
+        m_retryPlan.clear();
+        qCDebug(dcPlatformUpdate()) << "Retrying update, attempt" << plan->attempt;
+        executeUpdatePlan(plan);
+        notifyUpdateRunning();
+    });
+
+    m_packageDetails = new PackageDetailsCache(this);
+    connect(m_packageDetails, &PackageDetailsCache::transactionStarted, this, &UpdateControllerPackageKit::trackTransaction);
+    connect(m_packageDetails, &PackageDetailsCache::detailsReady, this, [this](const QString &packageId, const QVariantMap &details){
+        QString packageName = PackageId(packageId).name().toString();
+        // Versions might have changed while fetching
+        if (m_updateIds.value(packageName) == packageId) {
+            PackageChangeset changeset;
+            applyChangelog(packageName, details, &changeset);
+            emitChangeset(changeset);
+        }
+    });
+
+    m_updateScheduler = new UpdateScheduler(this);
+    connect(m_updateScheduler, &UpdateScheduler::ready, this, &UpdateControllerPackageKit::resumeHeldGraph);
+
+    loadSettings();
+    loadSnapshot();
+    // Packages are readable right away, PackageKit only fills in what needs it (update IDs, repositories) once it's up
+    if (m_nativeReaderEnabled) {
+        readNativePackages();
+    }
+
+    if (m_dpkgWatcherEnabled) {
+        m_dpkgStatusWatcher = new DpkgStatusWatcher("/var/lib/dpkg/status", m_cacheRefreshPolicy.listsDirectory(), this);
+        m_dpkgStatusWatcher->setFilter(m_nameFilter);
+        connect(m_dpkgStatusWatcher, &DpkgStatusWatcher::packagesChanged, this, [this](const QStringList &packageNames){
+            // PackageKit notices the change too and emits updatesChanged. That one is left to this refresh.
+            m_watcherChangePending = true;
+            m_refreshScheduler->schedulePackages(packageNames);
+        });
+        connect(m_dpkgStatusWatcher, &DpkgStatusWatcher::listsChanged, this, [this](){
+            m_refreshScheduler->schedule(RefreshScheduler::TriggerListsChanged);
+        });
+        m_dpkgStatusWatcher->start();
+    }
+
     connect(PackageKit::Daemon::global(), &PackageKit::Daemon::isRunningChanged, this, [this](){
         if (PackageKit::Daemon::isRunning()) {
             qCDebug(dcPlatformUpdate) << "Connected to PackageKit";
@@ -49,7 +133,7 @@ UpdateControllerPackageKit::UpdateControllerPackageKit(QObject *parent):
             m_available = true;
             emit availableChanged();
 
-            refreshFromPackageKit();
+            m_refreshScheduler->schedule(RefreshScheduler::TriggerDaemonStarted);
 
         } else {
             qCWarning(dcPlatformUpdate()) << "Connection to PackageKit lost";
@@ -59,7 +143,17 @@ UpdateControllerPackageKit::UpdateControllerPackageKit(QObject *parent):
 
     connect(PackageKit::Daemon::global(), &PackageKit::Daemon::updatesChanged, this, [this]() {
         qCDebug(dcPlatformUpdate) << "Packagekit updatesChanged notification received";
-        refreshFromPackageKit();
+        // A dpkg run outside of PackageKit has been picked up by the status watcher already, which only
+        // refreshes what changed. The notification belongs to that run if the managed packages are still
+        // exactly what the watcher has seen. Only the first notification following it is attributed to it.
+        if (m_watcherChangePending) {
+            m_watcherChangePending = false;
+            if (m_dpkgStatusWatcher->statusUnchanged()) {
+                qCDebug(dcPlatformUpdate) << "Leaving the change to the dpkg status watcher";
+                return;
+            }
+        }
+        m_refreshScheduler->schedule(RefreshScheduler::TriggerUpdatesChanged);
     });
     connect(PackageKit::Daemon::global(), &PackageKit::Daemon::changed, this, [this](){
         qCDebug(dcPlatformUpdate) << "PackageKit ready" << PackageKit::Daemon::distroID();
@@ -80,370 +174,1275 @@ bool UpdateControllerPackageKit::updateManagementAvailable() const
 
 bool UpdateControllerPackageKit::checkForUpdates()
 {
-    qCDebug(dcPlatformUpdate()) << "Refreshing system package cache...";
-    PackageKit::Transaction *refreshCache = PackageKit::Daemon::refreshCache(true);
-    connect(refreshCache, &PackageKit::Transaction::finished, this, [this](){
-        qCDebug(dcPlatformUpdate()) << "System package cache refreshed. Next update is at" << QDateTime::currentDateTime().addMSecs(m_refreshTimer->interval());
-        m_refreshTimer->start();
-        refreshFromPackageKit();
+    // Only re-download all indices if they are outdated, otherwise apt only fetches what changed
+    bool force = m_cacheRefreshPolicy.forceRefresh();
+    qCInfo(dcPlatformUpdate()) << "Checking for updates. Metadata is" << m_cacheRefreshPolicy.metadataAge() << "seconds old," << (force ? "forcing a full refresh." : "refreshing what changed.");
+    refreshCache(force);
+    return true;
+}
+
+void UpdateControllerPackageKit::refreshCache(bool force)
+{
+    qCDebug(dcPlatformUpdate()) << "Refreshing system package cache..." << (force ? "(forced)" : "");
+    // The refresh rewrites the lists, the package refresh following it covers that already
+    if (m_dpkgStatusWatcher) {
+        m_dpkgStatusWatcher->suspendLists();
+    }
+    PackageKit::Transaction *refreshCache = PackageKit::Daemon::refreshCache(force);
+    connect(refreshCache, &PackageKit::Transaction::finished, this, [this](PackageKit::Transaction::Exit status){
+        if (m_dpkgStatusWatcher) {
+            m_dpkgStatusWatcher->resumeLists();
+        }
+        if (status == PackageKit::Transaction::ExitSuccess) {
+            // The policy is updated once the refresh tells whether new updates showed up
+            m_cacheRefreshPending = true;
+            m_cacheRefreshGeneration = m_refreshScheduler->generation();
+            m_refreshScheduler->schedule(RefreshScheduler::TriggerCacheRefreshed);
+        } else {
+            m_cacheRefreshPolicy.refreshFailed();
+        }
+        scheduleCacheRefresh();
     });
+    m_tracer->traceTransaction(refreshCache, "refreshCache", "cache");
     trackTransaction(refreshCache);
-    return true;
+}
+
+void UpdateControllerPackageKit::scheduleCacheRefresh()
+{
+    qint64 delay = m_cacheRefreshPolicy.nextDelay();
+    m_refreshTimer->start(static_cast<int>(qMin<qint64>(delay, std::numeric_limits<int>::max())));
+    qCInfo(dcPlatformUpdate()) << "Metadata is" << m_cacheRefreshPolicy.metadataAge() << "seconds old. Next system package cache refresh is at" << QDateTime::currentDateTime().addMSecs(delay).toString(Qt::ISODate);
 }
 
 bool UpdateControllerPackageKit::busy() const
 {
-    return m_runningTransactions.count() > 0 || m_updateTransactions.count() > 0;
+    return m_runningTransactions.count() > 0 || updateRunning();
 }
 
 bool UpdateControllerPackageKit::updateRunning() const
 {
-    return m_updateTransactions.count() > 0;
+    // An update held back by the scheduler or waiting for a retry has been started as far as the user is concerned
+    return m_updateTransactions.count() > 0 || m_heldGraphs.count() > 0 || m_retryTimer->isActive();
 }
 
 QList<Package> UpdateControllerPackageKit::packages() const
 {
-    return m_packages.values();
+    return m_packageStore.packages();
+}
+
+QList<Package> UpdateControllerPackageKit::updatablePackages() const
+{
+    return m_packageStore.updatablePackages();
+}
+
+QList<Package> UpdateControllerPackageKit::removablePackages() const
+{
+    return m_packageStore.removablePackages();
+}
+
+QList<Package> UpdateControllerPackageKit::installedPackages() const
+{
+    return m_packageStore.installedPackages();
 }
 
 QList<Repository> UpdateControllerPackageKit::repositories() const
 {
-    return m_repositories.values();
+    return m_repositories.repositories();
 }
 
 bool UpdateControllerPackageKit::startUpdate(const QStringList &packageIds)
 {
     qCDebug(dcPlatformUpdate) << "Starting to update" << packageIds;
-    QHash<QString, QString> *upgradeIds = new QHash<QString, QString>; // <packageName, packageId>
 
-    // First, fetch packages with those ids. Installed and not installed ones. if packageIds is empty, this will be a no-op
-    PackageKit::Transaction *getPackages = PackageKit::Daemon::getPackages(PackageKit::Transaction::FilterArch);
-    m_unfinishedTransactions.append(getPackages);
+    // The staging download would only compete with the upgrade for the package manager lock. Whatever it
+    // downloaded so far stays in the package cache and is picked up by the upgrade.
+    if (!m_stagingTransaction.isNull()) {
+        qCDebug(dcPlatformUpdate()) << "Cancelling background download of updates";
+        m_stagingTransaction->cancel();
+    }
+
+    // Installing while nymead is running would restart it mid-transaction. Prepare the update and install it on the next reboot instead.
+    // Only updates can be installed offline, packages which aren't installed yet are installed right away.
+    QStringList onlineNames = packageIds;
+    if (m_offlineUpdatesEnabled) {
+        if (packageIds.isEmpty()) {
+            return startOfflineUpdate(QStringList());
+        }
+        QStringList offlineNames;
+        onlineNames.clear();
+        foreach (const QString &packageName, packageIds) {
+            (m_updateIds.contains(packageName) ? offlineNames : onlineNames).append(packageName);
+        }
+        if (!offlineNames.isEmpty()) {
+            startOfflineUpdate(offlineNames);
+        }
+        if (onlineNames.isEmpty()) {
+            return true;
+        }
+        qCDebug(dcPlatformUpdate()) << "Installing" << onlineNames << "right away, they're not updates";
+    }
 
-    connect(getPackages, &PackageKit::Transaction::package, this, [upgradeIds, packageIds](PackageKit::Transaction::Info info, const QString &packageID, const QString &summary){
-        Q_UNUSED(info)
-        Q_UNUSED(summary)
-        if (packageIds.contains(PackageKit::Daemon::packageName(packageID))) {
-            qCDebug(dcPlatformUpdate) << "Adding package to be installed:" << packageID;
-            upgradeIds->insert(PackageKit::Daemon::packageName(packageID), packageID);
+    // Resolving the requested packages and fetching the updates are independent, so run them concurrently
+    // and start the upgrade once both are done. Updating everything doesn't need to resolve anything.
+    QSharedPointer<UpdatePlan> plan(new UpdatePlan);
+    foreach (const QString &packageId, onlineNames) {
+        plan->requestedNames.insert(packageId);
+    }
+
+    // The simulation after the last refresh already knows the update IDs of the managed packages
+    if (!plan->requestedNames.isEmpty() && simulatedUpdateCurrent()) {
+        foreach (const QString &packageName, plan->requestedNames) {
+            if (!m_simulatedUpdate.updateIds.contains(packageName)) {
+                plan->updateIds.clear();
+                break;
+            }
+            plan->updateIds.insert(packageName, m_simulatedUpdate.updateIds.value(packageName));
+        }
+        plan->fromSimulation = !plan->updateIds.isEmpty();
+        if (plan->fromSimulation) {
+            qCDebug(dcPlatformUpdate()) << "Reusing the package set of the simulated update";
         }
+    }
+
+    // A new request supersedes a retry of an earlier one
+    if (m_retryTimer->isActive()) {
+        qCDebug(dcPlatformUpdate()) << "Dropping pending retry of the previous update";
+        m_retryTimer->stop();
+        m_retryPlan.clear();
+    }
+
+    executeUpdatePlan(plan);
+    notifyUpdateRunning();
+    return true;
+}
+
+void UpdateControllerPackageKit::executeUpdatePlan(QSharedPointer<UpdatePlan> plan)
+{
+    TransactionGraph *graph = new TransactionGraph("update", this);
+    connect(graph, &TransactionGraph::transactionStarted, this, &UpdateControllerPackageKit::trackUpdateTransaction);
+    trackProgress(graph, "upgrade");
+    // Errors of every step decide whether the update is retried, not only those of the upgrade itself
+    connect(graph, &TransactionGraph::transactionStarted, graph, [graph, plan](PackageKit::Transaction *transaction, const QString &step){
+        connect(transaction, &PackageKit::Transaction::errorCode, graph, [plan, step](PackageKit::Transaction::Error error, const QString &details){
+            qCDebug(dcPlatformUpdate) << "Update error in step" << step << ":" << error << details << "-" << UpdateRetryPolicy::classify(error);
+            plan->errors.append(error);
+        });
     });
-    connect(getPackages, &PackageKit::Transaction::finished, this, [this, packageIds, upgradeIds, getPackages](){
 
-        if (!m_unfinishedTransactions.contains(getPackages)) {
-            qCWarning(dcPlatformUpdate) << "Transaction emitted finished twice! Ignoring second event. (Old packagekitqt version?)";
-            return;
+    // Only when retrying after an error caused by outdated metadata
+    int refreshStep = graph->addStep("refresh", [plan]() -> PackageKit::Transaction* {
+        if (!plan->refreshMetadata) {
+            return nullptr;
         }
-        m_unfinishedTransactions.removeAll(getPackages);
+        return PackageKit::Daemon::refreshCache(false);
+    });
+
+    int resolveStep = graph->addStep("resolve", [this, graph, plan]() -> PackageKit::Transaction* {
+        if (plan->requestedNames.isEmpty() || plan->fromSimulation) {
+            return nullptr;
+        }
+        PackageKit::Transaction *resolve = PackageKit::Daemon::resolve(plan->requestedNames.values(), PackageKit::Transaction::FilterArch);
+        connect(resolve, &PackageKit::Transaction::package, graph, [this, plan](PackageKit::Transaction::Info info, const QString &packageID, const QString &summary){
+            Q_UNUSED(summary)
+            // Installed versions are reported too, we're only interested in what could be installed
+            if (info == PackageKit::Transaction::InfoInstalled) {
+                return;
+            }
+            QString packageName = m_packageStore.stringPool().intern(PackageId(packageID).name());
+            if (plan->requestedNames.contains(packageName)) {
+                qCDebug(dcPlatformUpdate) << "Adding package to be installed:" << packageID;
+                plan->resolvedIds.insert(packageName, packageID);
+            }
+        });
+        return resolve;
+    }, {refreshStep});
 
-        // OK, we've got packages for all the packageIds. Now get potential updates.
+    int updatesStep = graph->addStep("updates", [this, graph, plan]() -> PackageKit::Transaction* {
+        if (plan->fromSimulation) {
+            return nullptr;
+        }
         PackageKit::Transaction *getUpdates = PackageKit::Daemon::getUpdates();
-        m_unfinishedTransactions.append(getUpdates);
-        connect(getUpdates, &PackageKit::Transaction::package, this, [packageIds, upgradeIds](PackageKit::Transaction::Info info, const QString &packageID, const QString &summary){
+        connect(getUpdates, &PackageKit::Transaction::package, graph, [this, plan](PackageKit::Transaction::Info info, const QString &packageID, const QString &summary){
             qCDebug(dcPlatformUpdate()) << "Found package:" << packageID << info << summary;
-            if ((packageIds.isEmpty() || packageIds.contains(PackageKit::Daemon::packageName(packageID))) /*&& (info == PackageKit::Transaction::InfoNormal)*/) {
+            QString packageName = m_packageStore.stringPool().intern(PackageId(packageID).name());
+            if ((plan->requestedNames.isEmpty() || plan->requestedNames.contains(packageName)) /*&& (info == PackageKit::Transaction::InfoNormal)*/) {
                 qCDebug(dcPlatformUpdate) << "Adding package to be updated:" << packageID;
-                upgradeIds->insert(PackageKit::Daemon::packageName(packageID), packageID);
+                plan->updateIds.insert(packageName, packageID);
             }
         });
-        connect(getUpdates, &PackageKit::Transaction::finished, this, [this, upgradeIds, getUpdates](){
-            if (!m_unfinishedTransactions.contains(getUpdates)) {
-                qCWarning(dcPlatformUpdate) << "Transaction emitted finished twice! Ignoring second event. (Old packagekitqt version?)";
-                return;
+        return getUpdates;
+    }, {refreshStep});
+
+    plan->upgradeStep = graph->addStep("upgrade", [this, graph, plan]() -> PackageKit::Transaction* {
+        return createUpgradeTransaction(graph, plan);
+    }, {resolveStep, updatesStep});
+
+    connect(graph, &TransactionGraph::finished, this, [this, plan](bool success){
+        if (!success) {
+            retryUpdate(plan);
+            notifyUpdateRunning();
+        }
+    });
+
+    gateGraph(graph, "upgrade", [plan](){
+        return !plan->resolvedIds.isEmpty() || !plan->updateIds.isEmpty();
+    });
+    instrumentGraph(graph);
+    graph->start();
+}
+
+void UpdateControllerPackageKit::retryUpdate(QSharedPointer<UpdatePlan> plan)
+{
+    UpdateRetryPolicy::ErrorClass errorClass = UpdateRetryPolicy::ErrorClassTransient;
+    foreach (PackageKit::Transaction::Error error, plan->errors) {
+        errorClass = qMax(errorClass, UpdateRetryPolicy::classify(error));
+    }
+    if (plan->errors.isEmpty() || errorClass == UpdateRetryPolicy::ErrorClassPermanent) {
+        qCWarning(dcPlatformUpdate()) << "Update failed permanently:" << plan->errors;
+        return;
+    }
+    if (plan->attempt >= m_retryPolicy.maximumAttempts()) {
+        qCWarning(dcPlatformUpdate()) << "Update failed" << plan->attempt << "times. Giving up.";
+        return;
+    }
+
+    QSharedPointer<UpdatePlan> retry(new UpdatePlan);
+    retry->attempt = plan->attempt + 1;
+    if (plan->upgradeIds.isEmpty()) {
+        // Failed while looking the packages up. Start over, with the package set of the simulation if it was used.
+        retry->requestedNames = plan->requestedNames;
+        if (plan->fromSimulation) {
+            retry->updateIds = plan->updateIds;
+        }
+    } else {
+        // Resume with whatever hasn't been installed yet
+        for (QHash<QString, QString>::const_iterator it = plan->upgradeIds.constBegin(); it != plan->upgradeIds.constEnd(); ++it) {
+            if (!plan->finishedNames.contains(it.key())) {
+                retry->requestedNames.insert(it.key());
+                retry->updateIds.insert(it.key(), it.value());
             }
-            m_unfinishedTransactions.removeAll(getUpdates);
+        }
+        if (retry->requestedNames.isEmpty()) {
+            qCDebug(dcPlatformUpdate()) << "All packages have been installed despite the error. Not retrying.";
+            return;
+        }
+    }
 
-            qCDebug(dcPlatformUpdate()) << "List of packages to be upgraded:\n" << qUtf8Printable(upgradeIds->values().join('\n'));
+    if (errorClass == UpdateRetryPolicy::ErrorClassStaleMetadata) {
+        // The versions we know might not exist any more. Look them up again after refreshing.
+        retry->refreshMetadata = true;
+        retry->updateIds.clear();
+    }
+    retry->fromSimulation = !retry->updateIds.isEmpty();
 
-            PackageKit::Transaction *upgrade = PackageKit::Daemon::updatePackages(upgradeIds->values());
-            delete upgradeIds;
-            connect(upgrade, &PackageKit::Transaction::errorCode, this, [this](PackageKit::Transaction::Error error, const QString &details){
-                qCDebug(dcPlatformUpdate) << "Upgrade error:" << error << details;
-                if (error == PackageKit::Transaction::ErrorPackageDownloadFailed) {
-                    // Download failed... looks like the server doesn't host the .deb files (any more). Let's refresh the cache.
-                    checkForUpdates();
-                }
-            });
-            connect(upgrade, &PackageKit::Transaction::package, this, [this](PackageKit::Transaction::Info info, const QString &packageID, const QString &summary){
-                qCDebug(dcPlatformUpdate) << "Upgrading package:" << packageID << info << summary;
-                if (info == PackageKit::Transaction::InfoFinished) {
-                    QString id = PackageKit::Daemon::packageName(packageID);
-                    m_packages[id].setInstalledVersion(PackageKit::Daemon::packageVersion(packageID));
-                    m_packages[id].setCandidateVersion(QString());
-                    m_packages[id].setUpdateAvailable(false);
-                    emit packageChanged(m_packages[id]);
-                }
-            });
-            connect(upgrade, &PackageKit::Transaction::finished, this, [](){
-                qCDebug(dcPlatformUpdate) << "Upgrade finished";
-            });
-            trackUpdateTransaction(upgrade);
+    qint64 delay = m_retryPolicy.delay(plan->attempt);
+    if (plan->upgradeIds.isEmpty()) {
+        qCDebug(dcPlatformUpdate()) << "Retrying the lookup of the update in" << delay / 1000 << "seconds" << (retry->refreshMetadata ? "after refreshing the metadata" : "");
+    } else {
+        qCDebug(dcPlatformUpdate()) << "Retrying update of" << retry->requestedNames.count() << "of" << plan->upgradeIds.count() << "packages in" << delay / 1000 << "seconds" << (retry->refreshMetadata ? "after refreshing the metadata" : "");
+    }
+    m_retryPlan = retry;
+    m_retryTimer->start(delay);
+}
 
-        });
-        trackUpdateTransaction(getUpdates);
+PackageKit::Transaction *UpdateControllerPackageKit::createUpgradeTransaction(TransactionGraph *graph, QSharedPointer<UpdatePlan> plan)
+{
+    // Updates take precedence over the resolved candidates, which are used to install packages which aren't installed yet
+    QHash<QString, QString> upgradeIds = plan->resolvedIds; // <packageName, packageId>
+    for (QHash<QString, QString>::const_iterator it = plan->updateIds.constBegin(); it != plan->updateIds.constEnd(); ++it) {
+        upgradeIds.insert(it.key(), it.value());
+    }
+
+    if (upgradeIds.isEmpty()) {
+        qCDebug(dcPlatformUpdate()) << "All requested packages are up to date. Nothing to upgrade.";
+        return nullptr;
+    }
+    qCDebug(dcPlatformUpdate()) << "List of packages to be upgraded:\n" << qUtf8Printable(upgradeIds.values().join('\n'));
+    plan->upgradeIds = upgradeIds;
+    int staged = 0;
+    foreach (const QString &packageId, upgradeIds) {
+        if (m_stagedPackageIds.contains(packageId)) {
+            staged++;
+        }
+    }
+    qCDebug(dcPlatformUpdate()) << staged << "of" << upgradeIds.count() << "packages have been downloaded already";
+
+    int batchSize = m_updateScheduler->batchSize();
+    if (batchSize <= 0 || upgradeIds.count() <= batchSize) {
+        return createUpgradeBatch(graph, plan, upgradeIds.values());
+    }
+
+    // Install in a stable order, one batch after the other. Each batch passes the scheduler on its own,
+    // so high load pauses the update between batches.
+    QStringList packageNames = upgradeIds.keys();
+    packageNames.sort();
+    int batchCount = (packageNames.count() + batchSize - 1) / batchSize;
+    qCDebug(dcPlatformUpdate()) << "Splitting upgrade into" << batchCount << "batches";
+    int previousStep = plan->upgradeStep;
+    for (int batch = 0; batch < batchCount; batch++) {
+        QStringList batchIds;
+        foreach (const QString &packageName, packageNames.mid(batch * batchSize, batchSize)) {
+            batchIds.append(upgradeIds.value(packageName));
+        }
+        previousStep = graph->addStep(QString("upgrade %1/%2").arg(batch + 1).arg(batchCount), [this, graph, plan, batchIds]() -> PackageKit::Transaction* {
+            return createUpgradeBatch(graph, plan, batchIds);
+        }, {previousStep});
+    }
+    return nullptr;
+}
 
+PackageKit::Transaction *UpdateControllerPackageKit::createUpgradeBatch(TransactionGraph *graph, QSharedPointer<UpdatePlan> plan, const QStringList &packageIds)
+{
+    std::function<PackageKit::Transaction*()> factory = [packageIds]() {
+        return PackageKit::Daemon::updatePackages(packageIds);
+    };
+    PackageKit::Transaction *upgrade = m_updateScheduler->lowPriority() ? createBackgroundTransaction(factory) : factory();
+    // Announced together when the batch is done
+    QSharedPointer<PackageChangeset> changeset(new PackageChangeset);
+    connect(upgrade, &PackageKit::Transaction::package, graph, [this, plan, changeset](PackageKit::Transaction::Info info, const QString &packageID, const QString &summary){
+        qCDebug(dcPlatformUpdate) << "Upgrading package:" << packageID << info << summary;
+        if (info == PackageKit::Transaction::InfoFinished) {
+            PackageId parsedId(packageID);
+            QString id = m_packageStore.stringPool().intern(parsedId.name());
+            plan->finishedNames.insert(id);
+            if (!m_packageStore.contains(id)) {
+                return;
+            }
+            Package package = m_packageStore.package(id);
+            package.setInstalledVersion(m_packageStore.stringPool().intern(parsedId.version()));
+            package.setCandidateVersion(QString());
+            package.setUpdateAvailable(false);
+            if (m_packageStore.insert(package)) {
+                changeset->changed.append(package);
+            }
+        }
     });
-    trackUpdateTransaction(getPackages);
-    return true;
+    connect(upgrade, &PackageKit::Transaction::finished, graph, [this, changeset](){
+        qCDebug(dcPlatformUpdate) << "Upgrade finished";
+        emitChangeset(*changeset);
+        m_refreshScheduler->schedule(RefreshScheduler::TriggerUpdateFinished);
+    });
+    return upgrade;
 }
 
 bool UpdateControllerPackageKit::removePackages(const QStringList &packageIds)
 {
     qCDebug(dcPlatformUpdate) << "Starting removal of packages:" << packageIds;
-    QStringList *removeIds = new QStringList();
-    PackageKit::Transaction *getPackages = PackageKit::Daemon::getPackages(PackageKit::Transaction::FilterInstalled);
-    m_unfinishedTransactions.append(getPackages);
+    QSharedPointer<QStringList> removeIds(new QStringList());
 
-    connect(getPackages, &PackageKit::Transaction::package, this, [packageIds, removeIds](PackageKit::Transaction::Info info, const QString &packageID, const QString &summary){
-        Q_UNUSED(info)
-        Q_UNUSED(summary)
-        if (packageIds.contains(PackageKit::Daemon::packageName(packageID))) {
-            removeIds->append(packageID);
-        }
+    TransactionGraph *graph = new TransactionGraph("remove", this);
+    connect(graph, &TransactionGraph::transactionStarted, this, &UpdateControllerPackageKit::trackUpdateTransaction);
+    trackProgress(graph, "remove");
+
+    int resolveStep = graph->addStep("resolve", [this, graph, packageIds, removeIds]() -> PackageKit::Transaction* {
+        PackageKit::Transaction *resolve = PackageKit::Daemon::resolve(packageIds, PackageKit::Transaction::FilterInstalled);
+        connect(resolve, &PackageKit::Transaction::package, graph, [this, packageIds, removeIds](PackageKit::Transaction::Info info, const QString &packageID, const QString &summary){
+            Q_UNUSED(info)
+            Q_UNUSED(summary)
+            if (packageIds.contains(m_packageStore.stringPool().intern(PackageId(packageID).name()))) {
+                removeIds->append(packageID);
+            }
+        });
+        return resolve;
     });
-    connect(getPackages, &PackageKit::Transaction::finished, this, [this, removeIds, getPackages](){
 
-        if (!m_unfinishedTransactions.contains(getPackages)) {
-            qCWarning(dcPlatformUpdate) << "Transaction emitted finished twice! Ignoring second event. (Old packagekitqt version?)";
-            return;
+    graph->addStep("remove", [this, graph, removeIds]() -> PackageKit::Transaction* {
+        if (removeIds->isEmpty()) {
+            qCDebug(dcPlatformUpdate) << "None of the packages to be removed is installed.";
+            return nullptr;
         }
-        m_unfinishedTransactions.removeAll(getPackages);
-
         qCDebug(dcPlatformUpdate) << "List of packages to be removed:\n" << removeIds->join('\n');
 
         PackageKit::Transaction *remove = PackageKit::Daemon::removePackages(*removeIds);
-        delete removeIds;
-
-        connect(remove, &PackageKit::Transaction::errorCode, this, [](PackageKit::Transaction::Error error, const QString &details){
+        connect(remove, &PackageKit::Transaction::errorCode, graph, [](PackageKit::Transaction::Error error, const QString &details){
             qCDebug(dcPlatformUpdate) << "Remove error:" << details << error;
         });
-        connect(remove, &PackageKit::Transaction::package, this, [this](PackageKit::Transaction::Info info, const QString &packageID, const QString &summary){
+        QSharedPointer<PackageChangeset> changeset(new PackageChangeset);
+        connect(remove, &PackageKit::Transaction::package, graph, [this, changeset](PackageKit::Transaction::Info info, const QString &packageID, const QString &summary){
             qCDebug(dcPlatformUpdate) << "Removing package:" << packageID << info << summary;
             if (info == PackageKit::Transaction::InfoFinished) {
-                QString id = PackageKit::Daemon::packageName(packageID);
-                m_packages[id].setInstalledVersion(QString());
-                m_packages[id].setCandidateVersion(PackageKit::Daemon::packageVersion(packageID));
-                m_packages[id].setCanRemove(true);
-                emit packageChanged(m_packages[id]);
+                PackageId parsedId(packageID);
+                QString id = m_packageStore.stringPool().intern(parsedId.name());
+                if (!m_packageStore.contains(id)) {
+                    return;
+                }
+                Package package = m_packageStore.package(id);
+                package.setInstalledVersion(QString());
+                package.setCandidateVersion(m_packageStore.stringPool().intern(parsedId.version()));
+                package.setCanRemove(true);
+                if (m_packageStore.insert(package)) {
+                    changeset->changed.append(package);
+                }
             }
         });
-        connect(remove, &PackageKit::Transaction::finished, this, [](){
+        connect(remove, &PackageKit::Transaction::finished, graph, [this, changeset](){
             qCDebug(dcPlatformUpdate) << "Remove packages finished";
+            emitChangeset(*changeset);
+            m_refreshScheduler->schedule(RefreshScheduler::TriggerUpdateFinished);
         });
+        return remove;
+    }, {resolveStep});
 
-        trackUpdateTransaction(remove);
+    instrumentGraph(graph);
+    gateGraph(graph, "remove", [removeIds](){
+        return !removeIds->isEmpty();
     });
-
-    trackUpdateTransaction(getPackages);
+    graph->start();
     return true;
 }
 
 bool UpdateControllerPackageKit::enableRepository(const QString &repositoryId, bool enabled)
 {
-    if (repositoryId.startsWith("virtual_")) {
-        bool success = addRepoManually(repositoryId);
-        if (success) {
-            m_repositories[repositoryId].setEnabled(enabled);
-            emit repositoryChanged(m_repositories.value(repositoryId));
-        }
-        return success;
+    if (!m_repositories.contains(repositoryId)) {
+        qCWarning(dcPlatformUpdate()) << "Cannot" << (enabled ? "enable" : "disable") << "unknown repository" << repositoryId;
+        return false;
     }
 
-    qCDebug(dcPlatformUpdate) << "Enabling repo:" << repositoryId << enabled;
-    PackageKit::Transaction *repoTransaction = PackageKit::Daemon::repoEnable(repositoryId, enabled);
-    connect(repoTransaction, &PackageKit::Transaction::finished, this, [repositoryId, enabled](){
-        qCDebug(dcPlatformUpdate) << "Repository" << repositoryId << (enabled ? "enabled" : "disabled");
-    });
-    connect(repoTransaction, &PackageKit::Transaction::errorCode, this, [repositoryId, enabled](PackageKit::Transaction::Error error, const QString &details){
-        qCDebug(dcPlatformUpdate) << "Error" << (enabled ? "enabling" : "disabling") << "repository" << repositoryId << "(" << error << details << ")";
-    });
-    trackTransaction(repoTransaction);
-
-    m_repositories[repositoryId].setEnabled(enabled);
-    emit repositoryChanged(m_repositories.value(repositoryId));
-
-    checkForUpdates();
-
+    // Toggles arriving in quick succession are applied together, followed by a single refresh.
+    // A successful change is announced with repositoryChanged(), a failed one re-announces the unchanged
+    // repository. repositoryChangeFinished() additionally carries the error for code using the plugin directly.
+    qCDebug(dcPlatformUpdate) << "Queueing" << (enabled ? "enabling" : "disabling") << "of repository" << repositoryId;
+    m_pendingRepositoryChanges.insert(repositoryId, enabled);
+    if (!m_repositoryBatchRunning) {
+        m_repositoryBatchTimer->start();
+    }
     return true;
 }
 
-void UpdateControllerPackageKit::refreshFromPackageKit()
+void UpdateControllerPackageKit::applyRepositoryChanges()
 {
-    if (m_runningTransactions.count() > 0) {
+    if (m_repositoryBatchRunning || m_pendingRepositoryChanges.isEmpty()) {
         return;
     }
-    QHash<QString, Package>* newPackageList = new QHash<QString, Package>();
-
-    qCDebug(dcPlatformUpdate) << "Reading installed/available packages from backend...";
-    PackageKit::Transaction *getInstalled = PackageKit::Daemon::getPackages(PackageKit::Transaction::FilterNotDevel);
-
-    m_unfinishedTransactions.append(getInstalled);
+    QHash<QString, bool> changes = m_pendingRepositoryChanges;
+    m_pendingRepositoryChanges.clear();
+    m_repositoryBatchRunning = true;
+    qCDebug(dcPlatformUpdate()) << "Applying" << changes.count() << "repository changes";
+
+    QSharedPointer<QHash<QString, QString>> errors(new QHash<QString, QString>());
+    QHash<QString, int> steps;
+    bool sourcesAdded = false;
+
+    TransactionGraph *graph = new TransactionGraph("repositories", this);
+    connect(graph, &TransactionGraph::transactionStarted, this, &UpdateControllerPackageKit::trackTransaction);
+
+    for (QHash<QString, bool>::const_iterator it = changes.constBegin(); it != changes.constEnd(); ++it) {
+        QString repositoryId = it.key();
+        bool enabled = it.value();
+
+        if (m_channelMatcher.virtualRepositoryChannel(repositoryId) >= 0) {
+            // Virtual repositories are added to or removed from our sources file. Once a refresh finds
+            // the real repository, it replaces the virtual one and is toggled through PackageKit instead.
+            QString error;
+            if (!setVirtualSource(repositoryId, enabled, &error)) {
+                errors->insert(repositoryId, error);
+            } else {
+                sourcesAdded |= enabled;
+            }
+            continue;
+        }
 
-    connect(getInstalled, &PackageKit::Transaction::package, this, [this, newPackageList](PackageKit::Transaction::Info info, const QString &packageID, const QString &summary) {
-        if (PackageKit::Daemon::packageName(packageID).contains("nymea") && !PackageKit::Daemon::packageName(packageID).contains("dbgsym")) {
-//            qCDebug(dcPlatformUpdate) << "Have installed package:" << PackageKit::Daemon::packageName(packageID) << PackageKit::Daemon::packageVersion(packageID);
+        int step = graph->addStep(repositoryId, [graph, repositoryId, enabled, errors]() -> PackageKit::Transaction* {
+            qCDebug(dcPlatformUpdate) << (enabled ? "Enabling" : "Disabling") << "repository" << repositoryId;
+            PackageKit::Transaction *repoTransaction = PackageKit::Daemon::repoEnable(repositoryId, enabled);
+            connect(repoTransaction, &PackageKit::Transaction::errorCode, graph, [repositoryId, enabled, errors](PackageKit::Transaction::Error error, const QString &details){
+                qCDebug(dcPlatformUpdate) << "Error" << (enabled ? "enabling" : "disabling") << "repository" << repositoryId << "(" << error << details << ")";
+                errors->insert(repositoryId, details);
+            });
+            return repoTransaction;
+        });
+        steps.insert(repositoryId, step);
+    }
 
-            // Note: We're using packageName as ID because packageId is different for different versions of a package.
-            // However, in nymea we handle things differently, a package ID should identify a package without version info
-            // Given that packagekit backends (e.g. apt, rpm) also handle package installs via name, that should be just fine.
-            QString packageName = PackageKit::Daemon::packageName(packageID);
-            if (newPackageList->contains(packageName)) {
-                if (info == PackageKit::Transaction::InfoInstalled) {
-                    (*newPackageList)[packageName].setInstalledVersion(PackageKit::Daemon::packageVersion(packageID));
-                    (*newPackageList)[packageName].setCandidateVersion(PackageKit::Daemon::packageVersion(packageID));
-                    (*newPackageList)[packageName].setCanRemove(true);
+    connect(graph, &TransactionGraph::finished, this, [this, graph, changes, steps, errors, sourcesAdded](){
+        bool changed = false;
+        bool repositoryEnabled = false;
+        for (QHash<QString, bool>::const_iterator it = changes.constBegin(); it != changes.constEnd(); ++it) {
+            bool success = !errors->contains(it.key()) && (!steps.contains(it.key()) || graph->succeeded(steps.value(it.key())));
+            if (success) {
+                changed = true;
+                repositoryEnabled |= it.value() && steps.contains(it.key());
+                if (m_repositories.setEnabled(it.key(), it.value())) {
+                    emit repositoryChanged(m_repositories.repository(it.key()));
                 }
             } else {
-                Package package(packageName, packageName);
-                package.setSummary(summary);
-                if (info == PackageKit::Transaction::InfoInstalled) {
-                    package.setInstalledVersion(PackageKit::Daemon::packageVersion(packageID));
-                    package.setCanRemove(true);
+                if (!errors->contains(it.key())) {
+                    errors->insert(it.key(), "Transaction failed");
+                }
+                // nymead only knows repositoryChanged(). Re-announcing the unchanged state lets
+                // clients drop the toggle they've shown optimistically.
+                if (m_repositories.contains(it.key())) {
+                    emit repositoryChanged(m_repositories.repository(it.key()));
                 }
-                package.setCandidateVersion(PackageKit::Daemon::packageVersion(packageID));
-                newPackageList->insert(packageName, package);
             }
+            qCDebug(dcPlatformUpdate) << "Repository" << it.key() << (it.value() ? "enabled" : "disabled") << (success ? "" : ("failed: " + errors->value(it.key())));
+            emit repositoryChangeFinished(it.key(), success, errors->value(it.key()));
+        }
+        m_repositoryBatchRunning = false;
+
+        // Exactly one refresh for the entire batch. Newly enabled repositories need their metadata,
+        // sources we've added ourselves can be fetched on their own, anything else only needs a re-read.
+        if (repositoryEnabled) {
+            refreshCache(true);
+        } else if (sourcesAdded) {
+            if (!m_targetedRepositoryRefresh || !refreshRepositorySources()) {
+                refreshCache(true);
+            }
+        } else if (changed) {
+            m_refreshScheduler->schedule(RefreshScheduler::TriggerRepositoriesChanged);
         }
-    });
-    connect(getInstalled, &PackageKit::Transaction::finished, this, [this, newPackageList, getInstalled](){
 
-        if (!m_unfinishedTransactions.contains(getInstalled)) {
-            qCWarning(dcPlatformUpdate) << "Transaction emitted finished twice! Ignoring second event. (Old packagekitqt version?)";
-            return;
+        if (!m_pendingRepositoryChanges.isEmpty()) {
+            m_repositoryBatchTimer->start();
         }
-        m_unfinishedTransactions.removeAll(getInstalled);
+    });
+
+    instrumentGraph(graph);
+    graph->start();
+}
 
-        qCDebug(dcPlatformUpdate) << "Fetching installed/available packages finished. Fetching list of possible updates from backend...";
+QVariantMap UpdateControllerPackageKit::refreshStatistics() const
+{
+    return m_refreshScheduler->statistics();
+}
+
+void UpdateControllerPackageKit::refreshFromPackageKit()
+{
+    // Packages, updates and repositories don't depend on each other. Fetch them concurrently
+    // and merge the updates into the package list once everything is in.
+    QSharedPointer<RefreshState> state(new RefreshState);
+    quint64 generation = m_refreshScheduler->generation();
+
+    TransactionGraph *graph = new TransactionGraph("refresh", this);
+    connect(graph, &TransactionGraph::transactionStarted, this, &UpdateControllerPackageKit::trackTransaction);
+
+    // Backends only return packages matching all terms of a search, so search for each include pattern on its
+    // own. The searches run concurrently and packages found by several of them are merged by collectPackage().
+    QList<int> packagesSteps;
+    if (m_filteredQuery && !m_nameFilter.searchTerms().isEmpty()) {
+        foreach (const QString &searchTerm, m_nameFilter.searchTerms()) {
+            packagesSteps.append(graph->addStep("packages " + searchTerm, [this, graph, state, searchTerm]() -> PackageKit::Transaction* {
+                qCDebug(dcPlatformUpdate) << "Searching installed/available packages matching" << searchTerm << "in backend...";
+                PackageKit::Transaction *searchNames = PackageKit::Daemon::searchNames(searchTerm, PackageKit::Transaction::FilterNotDevel);
+                connect(searchNames, &PackageKit::Transaction::package, graph, [this, state](PackageKit::Transaction::Info info, const QString &packageID, const QString &summary) {
+                    collectPackage(state.data(), info, packageID, summary);
+                });
+                return searchNames;
+            }));
+        }
+    } else {
+        packagesSteps.append(graph->addStep("packages", [this, graph, state]() -> PackageKit::Transaction* {
+            qCDebug(dcPlatformUpdate) << "Reading installed/available packages from backend...";
+            PackageKit::Transaction *getPackages = PackageKit::Daemon::getPackages(PackageKit::Transaction::FilterNotDevel);
+            connect(getPackages, &PackageKit::Transaction::package, graph, [this, state](PackageKit::Transaction::Info info, const QString &packageID, const QString &summary) {
+                collectPackage(state.data(), info, packageID, summary);
+            });
+            return getPackages;
+        }));
+    }
 
+    int updatesStep = graph->addStep("updates", [this, graph, state]() -> PackageKit::Transaction* {
+        qCDebug(dcPlatformUpdate) << "Fetching list of possible updates from backend...";
         PackageKit::Transaction *getUpdates = PackageKit::Daemon::getUpdates();
-        m_unfinishedTransactions.append(getUpdates);
-        connect(getUpdates, &PackageKit::Transaction::package, this, [this, newPackageList](PackageKit::Transaction::Info info, const QString &packageID, const QString &summary){
+        connect(getUpdates, &PackageKit::Transaction::package, graph, [this, state](PackageKit::Transaction::Info info, const QString &packageID, const QString &summary){
             Q_UNUSED(info)
-            if (PackageKit::Daemon::packageName(packageID).contains("nymea")) {
-                qCDebug(dcPlatformUpdate) << "Update available for package:" << PackageKit::Daemon::packageName(packageID) << PackageKit::Daemon::packageVersion(packageID);
-                QString packageName = PackageKit::Daemon::packageName(packageID);
-                if (!newPackageList->contains(packageName)) { // Might happen for -dev and -dbg packages as we filter them in the previous call
-                    (*newPackageList)[packageName] = Package(packageName, packageName);
-                }
-                (*newPackageList)[packageName].setSummary(summary);
-                (*newPackageList)[packageName].setCandidateVersion(PackageKit::Daemon::packageVersion(packageID));
-                (*newPackageList)[packageName].setUpdateAvailable(true);
+            PackageId parsedId(packageID);
+            if (m_nameFilter.isIncluded(parsedId.name())) {
+                QString packageName = m_packageStore.stringPool().intern(parsedId.name());
+                QString packageVersion = m_packageStore.stringPool().intern(parsedId.version());
+                qCDebug(dcPlatformUpdate) << "Update available for package:" << packageName << packageVersion;
+                UpdateInfo update;
+                update.packageId = packageID;
+                update.version = packageVersion;
+                update.summary = summary;
+                state->updates.insert(packageName, update);
             }
         });
-        connect(getUpdates, &PackageKit::Transaction::finished, this, [this, newPackageList, getUpdates](){
+        return getUpdates;
+    });
 
-            if (!m_unfinishedTransactions.contains(getUpdates)) {
-                qCWarning(dcPlatformUpdate) << "Transaction emitted finished twice! Ignoring second event. (Old packagekitqt version?)";
-                return;
+    int repositoriesStep = graph->addStep("repositories", [this, graph, state]() -> PackageKit::Transaction* {
+        qCDebug(dcPlatformUpdate()) << "Fetching list of repositories from backend...";
+        PackageKit::Transaction *getRepos = PackageKit::Daemon::getRepoList(PackageKit::Transaction::FilterNotSource);
+        connect(getRepos, &PackageKit::Transaction::repoDetail, graph, [this, state](const QString &repoId, const QString &description, bool enabled){
+            int channel = m_channelMatcher.match(repoId);
+            if (channel >= 0) {
+                qCDebug(dcPlatformUpdate) << "Found repository enabled in system:" << repoId << description << (enabled ? "(enabled)" : "(disabled)");
+                state->repositories.append(Repository(repoId, m_channelMatcher.channel(channel).displayName, enabled));
             }
-            m_unfinishedTransactions.removeAll(getUpdates);
+        });
+        return getRepos;
+    });
 
-            qCDebug(dcPlatformUpdate) << "Fetching possible updates finished.";
-            QStringList packagesToRemove;
-            foreach (const QString &id, m_packages.keys()) {
-                if (!newPackageList->contains(id)) {
-                    packagesToRemove.append(id);
+    connect(graph, &TransactionGraph::finished, this, [this, graph, state, generation, packagesSteps, updatesStep, repositoriesStep](){
+        // Don't apply a partial package list, it would look like packages have been removed
+        bool packagesSucceeded = graph->succeeded(updatesStep);
+        foreach (int packagesStep, packagesSteps) {
+            packagesSucceeded &= graph->succeeded(packagesStep);
+        }
+        if (packagesSucceeded) {
+            qCDebug(dcPlatformUpdate) << "Fetching packages and possible updates finished.";
+            QHash<QString, QString> previousUpdateIds = m_updateIds;
+            m_updateIds.clear();
+            for (QHash<QString, UpdateInfo>::const_iterator it = state->updates.constBegin(); it != state->updates.constEnd(); ++it) {
+                QHash<QString, Package>::iterator package = state->packages.find(it.key());
+                if (package == state->packages.end()) { // Might happen for -dev and -dbg packages as we filter them in the packages step
+                    package = state->packages.insert(it.key(), Package(it.key(), it.key()));
                 }
+                package->setSummary(it.value().summary);
+                package->setCandidateVersion(it.value().version);
+                package->setUpdateAvailable(true);
+                m_updateIds.insert(it.key(), it.value().packageId);
             }
-            while (!packagesToRemove.isEmpty()) {
-                Package p = m_packages.take(packagesToRemove.takeFirst());
-                qCDebug(dcPlatformUpdate) << "Removed package" << p.packageId();
-                emit packageRemoved(p.packageId());
-            }
-
-            foreach (const QString &id, newPackageList->keys()) {
-                if (!m_packages.contains(id)) {
-                    m_packages.insert(id, newPackageList->value(id));
-                    qCDebug(dcPlatformUpdate) << "Added package" << id;
-                    emit packageAdded(newPackageList->value(id));
-                } else {
-                    if (m_packages.value(id) != newPackageList->value(id)) {
-                        m_packages[id] = newPackageList->value(id);
-                        qCDebug(dcPlatformUpdate) << "Package" << id << "changed";
-                        emit packageChanged(m_packages[id]);
+            // A refresh which started before the cache refresh finished might not have seen the new metadata yet.
+            // The cache refresh scheduled a follow-up refresh, which will.
+            if (m_cacheRefreshPending && generation > m_cacheRefreshGeneration) {
+                m_cacheRefreshPending = false;
+                bool newUpdates = false;
+                for (QHash<QString, QString>::const_iterator it = m_updateIds.constBegin(); it != m_updateIds.constEnd(); ++it) {
+                    if (previousUpdateIds.value(it.key()) != it.value()) {
+                        newUpdates = true;
+                        break;
                     }
                 }
+                m_cacheRefreshPolicy.refreshSucceeded(newUpdates);
+                qCDebug(dcPlatformUpdate()) << (newUpdates ? "New updates appeared." : "No new updates.") << "Cache refresh interval is now" << m_cacheRefreshPolicy.interval() << "seconds";
+                scheduleCacheRefresh();
+            }
+
+            quint64 diffSpan = m_tracer->beginSpan("diff", "refresh");
+            PackageChangeset changeset = m_packageStore.apply(state->packages);
+            emitChangeset(changeset);
+            m_tracer->endSpan(diffSpan, {{"changes", changeset.count()}});
+        } else {
+            qCWarning(dcPlatformUpdate()) << "Failed to fetch packages from backend. Keeping the previous package list.";
+        }
+
+        if (graph->succeeded(repositoriesStep)) {
+            applyRepositories(state->repositories);
+            updateVirtualRepositories();
+        }
+
+        // A failed refresh leaves the stores partially outdated, the snapshot keeps the last complete state
+        if (packagesSucceeded && graph->succeeded(repositoriesStep)) {
+            saveSnapshot();
+        }
+        m_refreshScheduler->refreshFinished();
+        fetchChangelogs();
+
+        if (m_simulationEnabled) {
+            simulateUpdates();
+        }
+
+        if (m_offlineUpdatesEnabled) {
+            // Preparing downloads everything too, no need to stage. A triggered update must not be replaced with
+            // a different package set, the next reboot would install that instead.
+            QStringList updateIds = m_updateIds.values();
+            if (!updateIds.isEmpty() && !offlineUpdatePrepared(updateIds) && !PackageKit::Daemon::offline()->updateTriggered()) {
+                prepareOfflineUpdate(updateIds, false);
             }
-            delete newPackageList;
+        } else if (m_stagingEnabled) {
+            stageUpdates();
+        }
+    });
+
+    instrumentGraph(graph);
+    graph->start();
+}
+
+QStringList UpdateControllerPackageKit::stagedPackages() const
+{
+    return m_stagedPackageIds.values();
+}
+
+void UpdateControllerPackageKit::fetchChangelogs()
+{
+    // Package::changelog is how nymea clients learn what an update brings
+    PackageChangeset changeset;
+    for (QHash<QString, QString>::const_iterator it = m_updateIds.constBegin(); it != m_updateIds.constEnd(); ++it) {
+        if (!m_packageStore.contains(it.key()) || !m_packageStore.package(it.key()).changelog().isEmpty()) {
+            continue;
+        }
+        if (m_packageDetails->contains(it.value())) {
+            applyChangelog(it.key(), m_packageDetails->details(it.value()), &changeset);
+        } else {
+            m_packageDetails->fetch(it.value(), true);
+        }
+    }
+    emitChangeset(changeset);
+}
+
+void UpdateControllerPackageKit::applyChangelog(const QString &packageName, const QVariantMap &details, PackageChangeset *changeset)
+{
+    if (!m_updateIds.contains(packageName) || !m_packageStore.contains(packageName)) {
+        return;
+    }
+    // Not every backend fills in the changelog, the update text describes the changes too
+    QString changelog = details.value("changelog").toString();
+    if (changelog.isEmpty()) {
+        changelog = details.value("updateText").toString();
+    }
+    if (changelog.isEmpty()) {
+        return;
+    }
+    Package package = m_packageStore.package(packageName);
+    package.setChangelog(changelog);
+    if (m_packageStore.insert(package)) {
+        changeset->changed.append(package);
+    }
+}
+
+bool UpdateControllerPackageKit::simulatedUpdateCurrent() const
+{
+    return m_simulatedUpdate.valid && m_simulatedUpdate.generation == m_packageStore.generation();
+}
+
+void UpdateControllerPackageKit::simulateUpdates()
+{
+    if (simulatedUpdateCurrent() || m_simulationRunning || updateRunning()) {
+        return;
+    }
+
+    QSharedPointer<SimulatedUpdate> simulation(new SimulatedUpdate);
+    simulation->generation = m_packageStore.generation();
+    simulation->updateIds = m_updateIds;
+    if (m_updateIds.isEmpty()) {
+        simulation->valid = true;
+        m_simulatedUpdate = *simulation;
+        return;
+    }
+
+    qCDebug(dcPlatformUpdate()) << "Simulating update of" << m_updateIds.count() << "packages";
+    m_simulationRunning = true;
+
+    // Like staging this doesn't set the busy flag
+    TransactionGraph *graph = new TransactionGraph("simulate", this);
+    connect(graph, &TransactionGraph::transactionStarted, this, [this](PackageKit::Transaction *transaction, const QString &step){
+        m_transactionRegistry->track(transaction);
+        m_tracer->traceTransaction(transaction, step, "simulate");
+    });
+
+    int simulateStep = graph->addStep("simulate", [this, graph, simulation]() -> PackageKit::Transaction* {
+        QStringList packageIds = simulation->updateIds.values();
+        PackageKit::Transaction *simulate = createBackgroundTransaction([packageIds](){
+            return PackageKit::Daemon::updatePackages(packageIds, PackageKit::Transaction::TransactionFlagSimulate);
         });
-        trackTransaction(getUpdates);
+        connect(simulate, &PackageKit::Transaction::package, graph, [simulation](PackageKit::Transaction::Info info, const QString &packageID, const QString &summary){
+            Q_UNUSED(summary)
+            simulation->packages.insert(packageID, info);
+        });
+        return simulate;
     });
-    trackTransaction(getInstalled);
 
+    // The simulation only reports the new versions of upgraded packages, the sizes of the replaced ones come from these
+    int installedStep = graph->addStep("installed", [graph, simulation]() -> PackageKit::Transaction* {
+        QStringList packageNames;
+        for (QHash<QString, PackageKit::Transaction::Info>::const_iterator it = simulation->packages.constBegin(); it != simulation->packages.constEnd(); ++it) {
+            if (it.value() == PackageKit::Transaction::InfoUpdating) {
+                packageNames.append(PackageId(it.key()).name().toString());
+            }
+        }
+        if (packageNames.isEmpty()) {
+            return nullptr;
+        }
+        PackageKit::Transaction *resolve = PackageKit::Daemon::resolve(packageNames, PackageKit::Transaction::FilterInstalled);
+        connect(resolve, &PackageKit::Transaction::package, graph, [simulation](PackageKit::Transaction::Info info, const QString &packageID, const QString &summary){
+            Q_UNUSED(info)
+            Q_UNUSED(summary)
+            simulation->replacedIds.insert(packageID);
+        });
+        return resolve;
+    }, {simulateStep});
 
-    qCDebug(dcPlatformUpdate()) << "Fetching list of repositories from backend...";
-    PackageKit::Transaction *getRepos = PackageKit::Daemon::getRepoList(PackageKit::Transaction::FilterNotSource);
-    connect(getRepos, &PackageKit::Transaction::repoDetail, this, [this](const QString &repoId, const QString &description, bool enabled){
-        QRegularExpression repoRegExp(".*(ci-repo|repository).nymea.io/(landing|landing-silo|experimental|experimental-silo).*");
-        if (repoRegExp.match(repoId).hasMatch() && !repoId.contains("deb-src")) {
-            qCDebug(dcPlatformUpdate) << "Found repository enabled in system:" << repoId << description << (enabled ? "(enabled)" : "(disabled)");
-            if (m_repositories.contains(repoId)) {
-                m_repositories[repoId].setEnabled(enabled);
-                qCDebug(dcPlatformUpdate) << "Updating existing repository in state cache:" << repoId << (enabled ? "(enabled)" : "(disabled)");
-                emit repositoryChanged(m_repositories.value(repoId));
-            } else {
-                QString description = repoId;
-                if (repoId.contains("experimental")) {
-                    description = "Experimental";
-                } else if (repoId.contains("landing")) {
-                    description = "Testing";
-                }
-                Repository repo(repoId, description, enabled);
-                m_repositories.insert(repoId, repo);
-                qCDebug(dcPlatformUpdate) << "Adding new repository to state cache:" << repoId << description << (enabled ? "(enabled)" : "(disabled)");
-                emit repositoryAdded(repo);
+    graph->addStep("details", [graph, simulation]() -> PackageKit::Transaction* {
+        if (simulation->packages.isEmpty()) {
+            return nullptr;
+        }
+        QStringList packageIds = simulation->packages.keys();
+        foreach (const QString &packageId, simulation->replacedIds) {
+            packageIds.append(packageId);
+        }
+        PackageKit::Transaction *getDetails = PackageKit::Daemon::getDetails(packageIds);
+        connect(getDetails, &PackageKit::Transaction::details, graph, [simulation](const PackageKit::Details &details){
+            PackageKit::Transaction::Info info = simulation->packages.value(details.packageId(), PackageKit::Transaction::InfoUnknown);
+            if (info == PackageKit::Transaction::InfoRemoving || info == PackageKit::Transaction::InfoObsoleting
+                    || simulation->replacedIds.contains(details.packageId())) {
+                simulation->installedSizeDelta -= details.size();
+                return;
             }
+            // Older PackageKit versions don't report the download size separately, the installed size is no substitute
+            if (!details.contains("download-size")) {
+                simulation->downloadSize = -1;
+            } else if (simulation->downloadSize >= 0) {
+                simulation->downloadSize += details.value("download-size").toLongLong();
+            }
+            if (info == PackageKit::Transaction::InfoInstalling || info == PackageKit::Transaction::InfoUpdating) {
+                simulation->installedSizeDelta += details.size();
+            }
+        });
+        return getDetails;
+    }, {installedStep});
+
+    connect(graph, &TransactionGraph::finished, this, [this, simulation](bool success){
+        m_simulationRunning = false;
+        if (!success) {
+            qCWarning(dcPlatformUpdate()) << "Simulating the update failed.";
+            return;
+        }
+        if (simulation->generation != m_packageStore.generation()) {
+            qCDebug(dcPlatformUpdate()) << "Packages changed while simulating the update. Discarding the result.";
+            return;
         }
+        simulation->valid = true;
+        m_simulatedUpdate = *simulation;
+        qCDebug(dcPlatformUpdate()) << "Updating would touch" << m_simulatedUpdate.packages.count() << "packages, download"
+                                    << (m_simulatedUpdate.downloadSize < 0 ? QString("an unknown number of") : QString::number(m_simulatedUpdate.downloadSize))
+                                    << "bytes and change the installed size by" << m_simulatedUpdate.installedSizeDelta << "bytes";
     });
-    connect(getRepos, &PackageKit::Transaction::finished, this, [this](){
-        if (m_distro.isEmpty()) {
-            qCWarning(dcPlatformUpdate) << "Running on an unknown distro. Not adding testing/experimental repository";
+
+    graph->start();
+}
+
+void UpdateControllerPackageKit::stageUpdates()
+{
+    // Forget about staged versions which aren't an update any more (installed or superseded)
+    QSet<QString> currentUpdateIds;
+    foreach (const QString &packageId, m_updateIds) {
+        currentUpdateIds.insert(packageId);
+    }
+    m_stagedPackageIds.intersect(currentUpdateIds);
+
+    if (!m_stagingTransaction.isNull() || updateRunning()) {
+        return;
+    }
+
+    QStringList toStage;
+    foreach (const QString &packageId, currentUpdateIds) {
+        if (!m_stagedPackageIds.contains(packageId)) {
+            toStage.append(packageId);
+        }
+    }
+    if (toStage.isEmpty()) {
+        return;
+    }
+
+    qCDebug(dcPlatformUpdate()) << "Downloading" << toStage.count() << "updates in the background:" << toStage;
+    QSharedPointer<QStringList> downloaded(new QStringList());
+    PackageKit::Transaction *stage = createBackgroundTransaction([toStage](){
+        return PackageKit::Daemon::updatePackages(toStage, PackageKit::Transaction::TransactionFlagOnlyTrusted | PackageKit::Transaction::TransactionFlagOnlyDownload);
+    });
+    m_stagingTransaction = stage;
+    connect(stage, &PackageKit::Transaction::package, this, [downloaded](PackageKit::Transaction::Info info, const QString &packageID){
+        if (info == PackageKit::Transaction::InfoFinished) {
+            downloaded->append(packageID);
+        }
+    });
+    connect(stage, &PackageKit::Transaction::finished, this, [this, toStage, downloaded](PackageKit::Transaction::Exit status){
+        // Packages are reported as finished once downloaded. If the transaction succeeded, everything is in the cache.
+        QStringList staged = status == PackageKit::Transaction::ExitSuccess ? toStage : *downloaded;
+        foreach (const QString &packageId, staged) {
+            m_stagedPackageIds.insert(packageId);
+        }
+        qCDebug(dcPlatformUpdate()) << "Background download of updates finished:" << status << "-" << m_stagedPackageIds.count() << "updates ready to be installed";
+    });
+    m_transactionRegistry->track(stage);
+    m_tracer->traceTransaction(stage, "stage", "staging");
+}
+
+bool UpdateControllerPackageKit::startOfflineUpdate(const QStringList &packageNames)
+{
+    QStringList packageIds;
+    if (packageNames.isEmpty()) {
+        packageIds = m_updateIds.values();
+    } else {
+        foreach (const QString &packageName, packageNames) {
+            if (m_updateIds.contains(packageName)) {
+                packageIds.append(m_updateIds.value(packageName));
+            }
+        }
+    }
+    if (packageIds.isEmpty()) {
+        qCDebug(dcPlatformUpdate()) << "No updates available for" << packageNames;
+        return false;
+    }
+
+    // Everything prepared is installed on reboot, so the prepared set has to match the request exactly
+    if (offlineUpdatePrepared(packageIds) && m_offlinePrepareTransaction.isNull()) {
+        triggerOfflineUpdate();
+    } else {
+        prepareOfflineUpdate(packageIds, true);
+    }
+    return true;
+}
+
+void UpdateControllerPackageKit::prepareOfflineUpdate(const QStringList &packageIds, bool trigger)
+{
+    if (trigger) {
+        m_offlineTriggerPending = true;
+    }
+    if (!m_offlinePrepareTransaction.isNull()) {
+        if (toSet(packageIds) == m_offlinePreparingIds) {
+            qCDebug(dcPlatformUpdate()) << "Offline update is already being prepared";
             return;
         }
-        bool foundTesting = false;
-        bool foundExperimental = false;
-        foreach (const QString &repoId, m_repositories.keys()) {
-            if (repoId.contains(".nymea.io/landing")) {
-                if (m_repositories.contains("virtual_testing")) {
-                    qCDebug(dcPlatformUpdate) << "Replacing virtual_testing with real landing";
-                    m_repositories.remove("virtual_testing");
-                    emit repositoryRemoved("virtual_testing");
-                }
-                foundTesting = true;
-                continue;
+        // The running preparation would leave a different package set behind. Replace it once it's cancelled.
+        qCDebug(dcPlatformUpdate()) << "Replacing the offline update being prepared with" << packageIds.count() << "packages";
+        m_offlineQueuedIds = packageIds;
+        m_offlinePrepareTransaction->cancel();
+        return;
+    }
+    m_offlinePreparingIds = toSet(packageIds);
+
+    // Downloading an update makes packagekitd record it as the prepared offline update. Only run it with low
+    // priority while nobody is waiting for it.
+    qCDebug(dcPlatformUpdate()) << "Preparing offline update of" << packageIds.count() << "packages";
+    std::function<PackageKit::Transaction*()> factory = [packageIds](){
+        return PackageKit::Daemon::updatePackages(packageIds, PackageKit::Transaction::TransactionFlagOnlyTrusted | PackageKit::Transaction::TransactionFlagOnlyDownload);
+    };
+    PackageKit::Transaction *prepare = trigger ? factory() : createBackgroundTransaction(factory);
+    m_offlinePrepareTransaction = prepare;
+    connect(prepare, &PackageKit::Transaction::errorCode, this, [](PackageKit::Transaction::Error error, const QString &details){
+        qCWarning(dcPlatformUpdate()) << "Failed to prepare offline update:" << error << details;
+    });
+    connect(prepare, &PackageKit::Transaction::finished, this, [this](PackageKit::Transaction::Exit status){
+        qCDebug(dcPlatformUpdate()) << "Preparing offline update finished:" << status;
+        m_offlinePreparingIds.clear();
+        if (!m_offlineQueuedIds.isEmpty()) {
+            QStringList packageIds = m_offlineQueuedIds;
+            m_offlineQueuedIds.clear();
+            prepareOfflineUpdate(packageIds, m_offlineTriggerPending);
+            return;
+        }
+        bool trigger = m_offlineTriggerPending;
+        m_offlineTriggerPending = false;
+        if (status == PackageKit::Transaction::ExitSuccess && trigger) {
+            triggerOfflineUpdate();
+        }
+    });
+    if (trigger) {
+        trackTransaction(prepare);
+    } else {
+        m_transactionRegistry->track(prepare);
+    }
+    m_tracer->traceTransaction(prepare, "prepare", "offline");
+}
+
+void UpdateControllerPackageKit::triggerOfflineUpdate()
+{
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(PackageKit::Daemon::offline()->trigger(PackageKit::Offline::ActionReboot), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [](QDBusPendingCallWatcher *watcher){
+        watcher->deleteLater();
+        if (watcher->isError()) {
+            qCWarning(dcPlatformUpdate()) << "Failed to trigger the offline update:" << watcher->error().message();
+        } else {
+            qCDebug(dcPlatformUpdate()) << "Offline update will be installed on the next reboot";
+        }
+    });
+}
+
+bool UpdateControllerPackageKit::offlineUpdatePrepared(const QStringList &packageIds) const
+{
+    PackageKit::Offline *offline = PackageKit::Daemon::offline();
+    if (!offline->updatePrepared()) {
+        return false;
+    }
+    // Exactly these packages, anything else prepared would be installed too
+    return toSet(offline->preparedUpdates()) == toSet(packageIds);
+}
+
+PackageKit::Transaction *UpdateControllerPackageKit::createBackgroundTransaction(const std::function<PackageKit::Transaction *()> &factory)
+{
+    // The background hint makes packagekitd run the backend with low CPU and I/O priority. The global hints are
+    // only read once the transaction has been created on the bus, which is asynchronous, so changing them
+    // temporarily wouldn't reach it. Set them on the transaction itself before it's sent its first call instead.
+    PackageKit::Transaction *transaction = factory();
+    transaction->setHints(PackageKit::Daemon::hints() + QStringList{"background=true"});
+    return transaction;
+}
+
+void UpdateControllerPackageKit::collectPackage(RefreshState *state, PackageKit::Transaction::Info info, const QString &packageID, const QString &summary)
+{
+    // Note: We're using packageName as ID because packageId is different for different versions of a package.
+    // However, in nymea we handle things differently, a package ID should identify a package without version info
+    // Given that packagekit backends (e.g. apt, rpm) also handle package installs via name, that should be just fine.
+    PackageId parsedId(packageID);
+
+    // Backends match search terms loosely (e.g. also on descriptions), so filter again.
+    // This is done on the view, so packages we don't manage never allocate anything.
+    if (!m_nameFilter.matches(parsedId.name())) {
+        return;
+    }
+
+    QString packageName = m_packageStore.stringPool().intern(parsedId.name());
+    QString packageVersion = m_packageStore.stringPool().intern(parsedId.version());
+    QHash<QString, Package>::iterator it = state->packages.find(packageName);
+    if (it != state->packages.end()) {
+        if (info == PackageKit::Transaction::InfoInstalled) {
+            it->setInstalledVersion(packageVersion);
+            it->setCandidateVersion(packageVersion);
+            it->setCanRemove(true);
+        }
+    } else {
+        Package package(packageName, packageName);
+        package.setSummary(summary);
+        if (info == PackageKit::Transaction::InfoInstalled) {
+            package.setInstalledVersion(packageVersion);
+            package.setCanRemove(true);
+        }
+        package.setCandidateVersion(packageVersion);
+        state->packages.insert(packageName, package);
+    }
+}
+
+void UpdateControllerPackageKit::refreshPackages(const QStringList &packageNames)
+{
+    if (!m_updateTransactions.isEmpty()) {
+        // The update in progress updates the packages itself and refreshes when done
+        m_refreshScheduler->refreshFinished();
+        return;
+    }
+    qCDebug(dcPlatformUpdate()) << "Refreshing changed packages" << packageNames;
+
+    QSharedPointer<RefreshState> state(new RefreshState);
+    TransactionGraph *graph = new TransactionGraph("partial", this);
+    connect(graph, &TransactionGraph::transactionStarted, this, &UpdateControllerPackageKit::trackTransaction);
+
+    int packagesStep = graph->addStep("packages", [this, graph, state, packageNames]() -> PackageKit::Transaction* {
+        PackageKit::Transaction *resolve = PackageKit::Daemon::resolve(packageNames, PackageKit::Transaction::FilterNotDevel);
+        connect(resolve, &PackageKit::Transaction::package, graph, [this, state](PackageKit::Transaction::Info info, const QString &packageID, const QString &summary) {
+            collectPackage(state.data(), info, packageID, summary);
+        });
+        return resolve;
+    });
+
+    int updatesStep = graph->addStep("updates", [this, graph, state, packageNames]() -> PackageKit::Transaction* {
+        PackageKit::Transaction *getUpdates = PackageKit::Daemon::getUpdates();
+        connect(getUpdates, &PackageKit::Transaction::package, graph, [this, state, packageNames](PackageKit::Transaction::Info info, const QString &packageID, const QString &summary){
+            Q_UNUSED(info)
+            PackageId parsedId(packageID);
+            QString packageName = m_packageStore.stringPool().intern(parsedId.name());
+            if (!packageNames.contains(packageName)) {
+                return;
             }
-            if (repoId.contains(".nymea.io/experimental")) {
-                if (m_repositories.contains("virtual_experimental")) {
-                    qCDebug(dcPlatformUpdate) << "Replacing virtual_experimental with real experimental";
-                    m_repositories.remove("virtual_experimental");
-                    emit repositoryRemoved("virtual_experimental");
+            UpdateInfo update;
+            update.packageId = packageID;
+            update.version = m_packageStore.stringPool().intern(parsedId.version());
+            update.summary = summary;
+            state->updates.insert(packageName, update);
+        });
+        return getUpdates;
+    });
+
+    connect(graph, &TransactionGraph::finished, this, [this, graph, state, packageNames, packagesStep, updatesStep](){
+        if (!graph->succeeded(packagesStep) || !graph->succeeded(updatesStep)) {
+            qCWarning(dcPlatformUpdate()) << "Failed to refresh changed packages. Falling back to a full refresh.";
+            m_refreshScheduler->schedule(RefreshScheduler::TriggerUpdatesChanged);
+            m_refreshScheduler->refreshFinished();
+            return;
+        }
+
+        PackageChangeset changeset;
+        foreach (const QString &packageName, packageNames) {
+            QHash<QString, Package>::iterator package = state->packages.find(packageName);
+            if (package == state->packages.end()) {
+                m_updateIds.remove(packageName);
+                if (m_packageStore.remove(packageName)) {
+                    changeset.removed.append(packageName);
                 }
-                foundExperimental = true;
                 continue;
             }
+            if (state->updates.contains(packageName)) {
+                UpdateInfo update = state->updates.value(packageName);
+                package->setSummary(update.summary);
+                package->setCandidateVersion(update.version);
+                package->setUpdateAvailable(true);
+                m_updateIds.insert(packageName, update.packageId);
+            } else {
+                m_updateIds.remove(packageName);
+            }
+            bool known = m_packageStore.contains(packageName);
+            if (m_packageStore.insert(package.value())) {
+                (known ? changeset.changed : changeset.added).append(package.value());
+            }
         }
+        qCDebug(dcPlatformUpdate()) << "Refreshed changed packages:" << changeset.count() << "changes";
+        emitChangeset(changeset);
+        saveSnapshot();
+        m_refreshScheduler->refreshFinished();
+        fetchChangelogs();
+    });
+
+    instrumentGraph(graph);
+    graph->start();
+}
 
-        if (!foundTesting && !m_repositories.contains("virtual_testing")) {
-            QString id = "virtual_testing";
-            Repository repository(id, "Testing", false);
-            m_repositories.insert(id, repository);
-            qCDebug(dcPlatformUpdate) << "Testing not found. Adding virtual repo:" << id;
+void UpdateControllerPackageKit::applyRepositories(const QList<Repository> &repositories)
+{
+    // The backend's list replaces what we knew, e.g. from the snapshot. Virtual repositories
+    // are never reported by the backend, updateVirtualRepositories() takes care of those.
+    QSet<QString> reported;
+    foreach (const Repository &repository, repositories) {
+        reported.insert(repository.id());
+        if (!m_repositories.contains(repository.id())) {
+            m_repositories.insert(repository);
+            qCDebug(dcPlatformUpdate) << "Adding new repository to state cache:" << repository.id() << repository.displayName() << (repository.enabled() ? "(enabled)" : "(disabled)");
             emit repositoryAdded(repository);
+        } else if (m_repositories.repository(repository.id()).enabled() != repository.enabled()) {
+            m_repositories.setEnabled(repository.id(), repository.enabled());
+            qCDebug(dcPlatformUpdate) << "Updating existing repository in state cache:" << repository.id() << (repository.enabled() ? "(enabled)" : "(disabled)");
+            emit repositoryChanged(m_repositories.repository(repository.id()));
         }
-        if (!foundExperimental && !m_repositories.contains("virtual_experimental")) {
-            QString id = "virtual_experimental";
-            Repository repository(id, "Experimental", false);
-            m_repositories.insert(id, repository);
-            qCDebug(dcPlatformUpdate) << "Experimental not found. Adding virtual repo:" << id;
-            emit repositoryAdded(repository);
+    }
+    foreach (const QString &repositoryId, m_repositories.repositoryIds()) {
+        if (!reported.contains(repositoryId) && m_channelMatcher.virtualRepositoryChannel(repositoryId) < 0) {
+            qCDebug(dcPlatformUpdate) << "Repository" << repositoryId << "is gone. Removing it from state cache.";
+            m_repositories.remove(repositoryId);
+            emit repositoryRemoved(repositoryId);
         }
+    }
+}
+
+void UpdateControllerPackageKit::updateVirtualRepositories()
+{
+    if (m_distro.isEmpty()) {
+        qCWarning(dcPlatformUpdate) << "Running on an unknown distro. Not adding virtual channel repositories";
+        return;
+    }
+    QVector<bool> found(m_channelMatcher.channels().count(), false);
+    foreach (const QString &repoId, m_repositories.repositoryIds()) {
+        int channel = m_channelMatcher.match(repoId);
+        if (channel < 0) {
+            continue;
+        }
+        found[channel] = true;
+        QString virtualId = m_channelMatcher.virtualRepositoryId(channel);
+        if (!virtualId.isEmpty() && m_repositories.contains(virtualId)) {
+            qCDebug(dcPlatformUpdate) << "Replacing" << virtualId << "with real repository" << repoId;
+            m_repositories.remove(virtualId);
+            emit repositoryRemoved(virtualId);
+        }
+    }
+
+    for (int channel = 0; channel < found.count(); channel++) {
+        QString id = m_channelMatcher.virtualRepositoryId(channel);
+        if (found.at(channel) || id.isEmpty() || m_repositories.contains(id)) {
+            continue;
+        }
+        Repository repository(id, m_channelMatcher.channel(channel).displayName, false);
+        m_repositories.insert(repository);
+        qCDebug(dcPlatformUpdate) << m_channelMatcher.channel(channel).displayName << "not found. Adding virtual repo:" << id;
+        emit repositoryAdded(repository);
+    }
+}
+
+QVariantMap UpdateControllerPackageKit::transactionStatistics() const
+{
+    return m_transactionRegistry->statistics();
+}
+
+bool UpdateControllerPackageKit::exportTransactionMetrics(const QString &fileName) const
+{
+    return m_transactionRegistry->exportToFile(fileName);
+}
+
+bool UpdateControllerPackageKit::dumpTrace(const QString &fileName) const
+{
+    if (!m_tracer->enabled()) {
+        qCWarning(dcPlatformUpdate()) << "Tracing is disabled. Enable it in the [Tracing] section of the settings.";
+        return false;
+    }
+    return m_tracer->dump(fileName.isEmpty() ? m_traceFileName : fileName);
+}
+
+QVariantMap UpdateControllerPackageKit::updateSchedule() const
+{
+    return m_updateScheduler->status();
+}
+
+void UpdateControllerPackageKit::trackProgress(TransactionGraph *graph, const QString &mainStep)
+{
+    // Looking up packages is quick compared to the actual download and installation.
+    // Batches of the main step ("upgrade 2/3") share its range.
+    int operation = m_updateProgress->start(graph->name());
+    connect(graph, &TransactionGraph::transactionStarted, this, [this, operation, mainStep](PackageKit::Transaction *transaction, const QString &step){
+        if (step == mainStep) {
+            m_updateProgress->attach(operation, transaction, 10, 100);
+        } else if (step.startsWith(mainStep + " ")) {
+            QString batch = step.mid(mainStep.length() + 1);
+            int index = batch.section('/', 0, 0).toInt();
+            int count = qMax(1, batch.section('/', 1, 1).toInt());
+            m_updateProgress->attach(operation, transaction, 10 + 90 * (index - 1) / count, 10 + 90 * index / count);
+        } else {
+            m_updateProgress->attach(operation, transaction, 0, 10);
+        }
+    });
+    connect(graph, &TransactionGraph::finished, this, [this, operation](bool success){
+        m_updateProgress->finish(operation, success);
+    });
+}
+
+void UpdateControllerPackageKit::gateGraph(TransactionGraph *graph, const QString &mainStep, const std::function<bool()> &hasWork)
+{
+    // Only installing and removing compete with the automation engine, lookups may always run.
+    // If the lookups found nothing to do, the main step finishes right away without waiting.
+    graph->setGate([this, graph, mainStep, hasWork](const QString &step){
+        if (!step.startsWith(mainStep) || (step == mainStep && !hasWork())) {
+            return true;
+        }
+        if (m_updateScheduler->requestStart()) {
+            // The transaction starting right away keeps updateRunning set, no need to announce anything
+            m_heldGraphs.removeAll(graph);
+            return true;
+        }
+        if (!m_heldGraphs.contains(graph)) {
+            m_heldGraphs.append(graph);
+            notifyUpdateRunning();
+        }
+        return false;
+    });
+    connect(graph, &TransactionGraph::finished, this, [this, graph](){
+        m_heldGraphs.removeAll(graph);
+        notifyUpdateRunning();
+        // The scheduler only signals readiness once. Whatever else is held back gets its turn now.
+        resumeHeldGraph();
     });
-    trackTransaction(getRepos);
+}
+
+void UpdateControllerPackageKit::resumeHeldGraph()
+{
+    // Resuming all at once would let every held update pass the scheduler's checks at the same moment.
+    // The next one is resumed when this one is done, or when the scheduler is ready again.
+    if (!m_heldGraphs.isEmpty()) {
+        m_heldGraphs.first()->resume();
+    }
+}
+
+void UpdateControllerPackageKit::notifyUpdateRunning()
+{
+    if (updateRunning() == m_updateRunning) {
+        return;
+    }
+    m_updateRunning = updateRunning();
+    emit updateRunningChanged();
+    emit busyChanged();
+}
 
+void UpdateControllerPackageKit::instrumentGraph(TransactionGraph *graph)
+{
+    quint64 cycle = m_transactionRegistry->beginCycle(graph->name());
+    quint64 span = m_tracer->beginSpan(graph->name(), graph->name());
+    connect(graph, &TransactionGraph::transactionStarted, this, [this, graph](PackageKit::Transaction *transaction, const QString &step){
+        m_tracer->traceTransaction(transaction, step, graph->name() + "/" + step);
+    });
+    connect(graph, &TransactionGraph::finished, this, [this, cycle, span](bool success){
+        m_tracer->endSpan(span, {{"success", success}});
+        m_transactionRegistry->endCycle(cycle, success, m_packageStore.count());
+    });
 }
 
 void UpdateControllerPackageKit::trackTransaction(PackageKit::Transaction *transaction)
 {
+    m_transactionRegistry->track(transaction);
     m_runningTransactions.append(transaction);
     qCDebug(dcPlatformUpdate) << "Started transaction" << transaction << "(" << m_runningTransactions.count() << "running)";
     if (m_runningTransactions.count() > 0) {
@@ -454,24 +1453,163 @@ void UpdateControllerPackageKit::trackTransaction(PackageKit::Transaction *trans
         qCDebug(dcPlatformUpdate) << "Transaction" << transaction << " finished (" << m_runningTransactions.count() << "running)";
         if (m_runningTransactions.count() == 0) {
             emit busyChanged();
+            exportDiagnosticsIfIdle();
         }
     });
 }
 
 void UpdateControllerPackageKit::trackUpdateTransaction(PackageKit::Transaction *transaction)
 {
+    m_transactionRegistry->track(transaction);
     m_updateTransactions.append(transaction);
     qCDebug(dcPlatformUpdate) << "Started update transaction" << transaction << "(" << m_updateTransactions.count() << "running)";
     if (m_updateTransactions.count() == 1) {
-        emit updateRunningChanged();
+        // Our own changes are refreshed once the update is done, they mustn't trigger refreshes of their own
+        if (m_dpkgStatusWatcher) {
+            m_dpkgStatusWatcher->setSuspended(true);
+        }
     }
+    notifyUpdateRunning();
     connect(transaction, &PackageKit::Transaction::finished, this, [this, transaction](){
         m_updateTransactions.removeAll(transaction);
         qCDebug(dcPlatformUpdate) << "Update Transaction" << transaction << "finished (" << m_updateTransactions.count() << "running)";
         if (m_updateTransactions.count() == 0) {
-            emit updateRunningChanged();
+            if (m_dpkgStatusWatcher) {
+                m_dpkgStatusWatcher->setSuspended(false);
+            }
+            notifyUpdateRunning();
+            exportDiagnosticsIfIdle();
+        }
+    });
+}
+
+void UpdateControllerPackageKit::exportDiagnosticsIfIdle()
+{
+    if (busy()) {
+        return;
+    }
+    if (!m_metricsExportFileName.isEmpty()) {
+        m_transactionRegistry->exportToFile(m_metricsExportFileName);
+    }
+    if (m_tracer->enabled()) {
+        m_tracer->dump(m_traceFileName);
+    }
+}
+
+void UpdateControllerPackageKit::loadSettings()
+{
+    QSettings settings(NymeaSettings::settingsPath() + "/updatepluginpackagekit.conf", QSettings::IniFormat);
+    qCDebug(dcPlatformUpdate()) << "Loading PackageKit update plugin settings from" << settings.fileName();
+
+    m_nameFilter = PackageNameFilter::fromSettings(settings);
+    m_channelMatcher = RepositoryChannelMatcher::fromSettings(settings);
+    m_cacheRefreshPolicy.load(settings);
+    m_updateScheduler->load(settings);
+    m_retryPolicy.load(settings);
+    m_filteredQuery = settings.value("PackageFilter/filteredQuery", true).toBool();
+    m_perPackageSignals = settings.value("Notifications/perPackageSignals", true).toBool();
+    m_snapshotFileName = settings.value("Snapshot/fileName", NymeaSettings::cachePath() + "/updatepluginpackagekit.snapshot").toString();
+    m_transactionRegistry->setWindowSize(settings.value("Metrics/windowSize", 100).toInt());
+    m_metricsExportFileName = settings.value("Metrics/exportFileName").toString();
+    m_tracer->setCapacity(settings.value("Tracing/capacity", 4096).toInt());
+    m_tracer->setEnabled(settings.value("Tracing/enabled", false).toBool());
+    m_updateProgress->setMaximumRate(settings.value("Progress/maximumRate", 2).toInt());
+    m_stagingEnabled = settings.value("Staging/enabled", false).toBool();
+    m_offlineUpdatesEnabled = settings.value("OfflineUpdates/enabled", false).toBool();
+    m_simulationEnabled = settings.value("UpdatePlan/enabled", true).toBool();
+    m_dpkgWatcherEnabled = settings.value("DpkgWatcher/enabled", true).toBool();
+    m_nativeReaderEnabled = settings.value("NativeReader/enabled", false).toBool();
+    m_packageDetails->setCapacity(settings.value("Details/cacheSize", 256).toInt());
+    m_traceFileName = settings.value("Tracing/fileName", NymeaSettings::cachePath() + "/updatepluginpackagekit-trace.json").toString();
+
+    m_repositoryFiles = new RepositoryFileManager(settings.value("RepositoryFiles/fileName", "/etc/apt/sources.list.d/nymea.list").toString(), this);
+    m_targetedRepositoryRefresh = settings.value("RepositoryFiles/targetedRefresh", true).toBool();
+    connect(m_repositoryFiles, &RepositoryFileManager::refreshFinished, this, [this](bool success){
+        if (m_dpkgStatusWatcher) {
+            m_dpkgStatusWatcher->resumeLists();
+        }
+        if (success) {
+            m_refreshScheduler->schedule(RefreshScheduler::TriggerRepositoriesChanged);
+        } else {
+            qCDebug(dcPlatformUpdate()) << "Falling back to a full cache refresh.";
+            refreshCache(true);
         }
     });
+    qCDebug(dcPlatformUpdate()) << "Managing packages matching" << m_nameFilter.includePatterns() << "excluding" << m_nameFilter.excludePatterns() << (m_filteredQuery ? "(filtered query)" : "(full enumeration)");
+}
+
+void UpdateControllerPackageKit::loadSnapshot()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QList<Package> packages;
+    QList<Repository> repositories;
+    if (!PackageSnapshot::load(m_snapshotFileName, &packages, &repositories)) {
+        qCDebug(dcPlatformUpdate()) << "No usable package snapshot found. Waiting for PackageKit...";
+        return;
+    }
+
+    foreach (const Package &package, packages) {
+        m_packageStore.insert(package);
+    }
+    foreach (const Repository &repository, repositories) {
+        m_repositories.insert(repository);
+    }
+    m_snapshotPackageGeneration = m_packageStore.generation();
+    m_snapshotRepositoryGeneration = m_repositories.generation();
+    qCDebug(dcPlatformUpdate()) << "Loaded" << m_packageStore.count() << "packages and" << m_repositories.count() << "repositories from snapshot in" << timer.elapsed() << "ms";
+}
+
+void UpdateControllerPackageKit::readNativePackages()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    NativePackageReader reader("/var/lib/dpkg/status", m_cacheRefreshPolicy.listsDirectory());
+    reader.setFilter(m_nameFilter);
+    QHash<QString, Package> packages;
+    if (!reader.read(&packages, &m_packageStore.stringPool())) {
+        qCWarning(dcPlatformUpdate()) << "Cannot read the dpkg database:" << reader.errorString() << "Waiting for PackageKit...";
+        return;
+    }
+    PackageChangeset changeset = m_packageStore.apply(packages);
+    qCDebug(dcPlatformUpdate()) << "Read" << m_packageStore.count() << "packages from the dpkg and apt databases in" << timer.elapsed() << "ms," << changeset.count() << "differ from the snapshot";
+}
+
+void UpdateControllerPackageKit::saveSnapshot()
+{
+    if (m_packageStore.generation() == m_snapshotPackageGeneration && m_repositories.generation() == m_snapshotRepositoryGeneration) {
+        qCDebug(dcPlatformUpdate()) << "Package snapshot is up to date";
+        return;
+    }
+    if (!PackageSnapshot::save(m_snapshotFileName, m_packageStore.packages(), m_repositories.repositories())) {
+        return;
+    }
+    m_snapshotPackageGeneration = m_packageStore.generation();
+    m_snapshotRepositoryGeneration = m_repositories.generation();
+    qCDebug(dcPlatformUpdate()) << "Package snapshot written to" << m_snapshotFileName;
+}
+
+void UpdateControllerPackageKit::emitChangeset(const PackageChangeset &changeset)
+{
+    if (changeset.isEmpty()) {
+        return;
+    }
+    qCDebug(dcPlatformUpdate()) << "Packages changed:" << changeset.added.count() << "added," << changeset.changed.count() << "changed," << changeset.removed.count() << "removed";
+
+    if (m_perPackageSignals) {
+        foreach (const QString &packageId, changeset.removed) {
+            emit packageRemoved(packageId);
+        }
+        foreach (const Package &package, changeset.added) {
+            emit packageAdded(package);
+        }
+        foreach (const Package &package, changeset.changed) {
+            emit packageChanged(package);
+        }
+    }
+    emit packagesChanged(changeset);
 }
 
 void UpdateControllerPackageKit::readDistro()
@@ -520,39 +1658,40 @@ void UpdateControllerPackageKit::readDistro()
     m_distro = knownDistros.value(distroVersion);
 }
 
-bool UpdateControllerPackageKit::addRepoManually(const QString &repo)
+bool UpdateControllerPackageKit::refreshRepositorySources()
 {
-    if (m_distro.isEmpty()) {
-        qCWarning(dcPlatformUpdate()) << "Error reading distro info. Cannot add repository" << repo;
+    // Like refreshCache(), apt-get update rewrites lists the following package refresh covers already
+    if (m_dpkgStatusWatcher) {
+        m_dpkgStatusWatcher->suspendLists();
+    }
+    if (!m_repositoryFiles->refreshSources()) {
+        if (m_dpkgStatusWatcher) {
+            m_dpkgStatusWatcher->resumeLists();
+        }
         return false;
     }
-    QHash<QString, QString> repos;
-    repos.insert("virtual_testing", "deb http://repository.nymea.io/landing " + m_distro + " " + m_component);
-    repos.insert("virtual_experimental", "deb http://repository.nymea.io/experimental " + m_distro + " " + m_component);
+    return true;
+}
 
-    if (!repos.contains(repo)) {
-        qCWarning(dcPlatformUpdate()) << "Cannot add unknown repo" << repo;
+bool UpdateControllerPackageKit::setVirtualSource(const QString &repo, bool enabled, QString *error)
+{
+    if (m_distro.isEmpty()) {
+        *error = "Error reading distro info. Cannot " + QString(enabled ? "add" : "remove") + " repository " + repo;
         return false;
     }
-
-    QString fileName("/etc/apt/sources.list.d/nymea.list");
-    QFile sourcesList(fileName);
-    if (!sourcesList.open(QFile::ReadWrite)) {
-        qCWarning(dcPlatformUpdate()) << "Failed to open" << fileName << "for writing. Not adding repo.";
+    int channel = m_channelMatcher.virtualRepositoryChannel(repo);
+    if (channel < 0) {
+        *error = "Cannot " + QString(enabled ? "add" : "remove") + " unknown repository " + repo;
         return false;
     }
-    bool ok;
-    ok = sourcesList.seek(sourcesList.size());
-    QString line = QString("\n\n%1\n").arg(repos.value(repo));
-    qint64 ret = sourcesList.write(line.toUtf8());
-    ok &= (ret == line.length());
-    if (!ok) {
-        qCWarning(dcPlatformUpdate()) << "Failed to write repository to file" << fileName;
+    QString source = m_channelMatcher.virtualSource(channel, m_distro, m_component);
+    if (enabled && !m_repositoryFiles->addSource(source)) {
+        *error = "Failed to add repository " + source + " to " + m_repositoryFiles->fileName();
+        return false;
+    }
+    if (!enabled && !m_repositoryFiles->removeSource(source)) {
+        *error = "Failed to remove repository " + source + " from " + m_repositoryFiles->fileName();
         return false;
     }
-    qCDebug(dcPlatform()) << "Added repository" << repos.value(repo);
-
-    checkForUpdates();
-
     return true;
 }
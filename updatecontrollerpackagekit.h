@@ -30,8 +30,31 @@
 #include <QNetworkAccessManager>
 #include <Transaction>
 #include <QTimer>
+#include <QSet>
+#include <QSharedPointer>
+#include <QPointer>
+
+#include <functional>
 
 #include "platform/platformupdatecontroller.h"
+#include "transactiongraph.h"
+#include "packagenamefilter.h"
+#include "repositorychannelmatcher.h"
+#include "repositoryfilemanager.h"
+#include "cacherefreshpolicy.h"
+#include "packagechangeset.h"
+#include "packageid.h"
+#include "packagestore.h"
+#include "repositorystore.h"
+#include "refreshscheduler.h"
+#include "transactionregistry.h"
+#include "updatetracer.h"
+#include "updateprogress.h"
+#include "updatescheduler.h"
+#include "updateretrypolicy.h"
+#include "dpkgstatuswatcher.h"
+#include "simulatedupdate.h"
+#include "packagedetailscache.h"
 
 class UpdateControllerPackageKit: public PlatformUpdateController
 {
@@ -53,37 +76,199 @@ public:
     QList<Package> packages() const override;
     QList<Repository> repositories() const override;
 
+    // Served from the secondary indices of the package store
+    QList<Package> updatablePackages() const;
+    QList<Package> removablePackages() const;
+    QList<Package> installedPackages() const;
+
     bool startUpdate(const QStringList &packageIds = QStringList()) override;
     bool removePackages(const QStringList &packageIds) override;
 
     bool enableRepository(const QString &repositoryId, bool enabled) override;
 
+    QVariantMap refreshStatistics() const;
+
+    QVariantMap transactionStatistics() const;
+    bool exportTransactionMetrics(const QString &fileName) const;
+    // Writes the trace ring buffer to fileName, or to the configured trace file if empty
+    bool dumpTrace(const QString &fileName = QString()) const;
+
+    // Maintenance window, pressure and batching state of the update scheduler
+    QVariantMap updateSchedule() const;
+
+    // Versioned package IDs of updates which have been downloaded in the background
+    QStringList stagedPackages() const;
+
+signals:
+    // Emitted once per refresh with all package changes. The per-package signals
+    // of PlatformUpdateController are only emitted in addition if perPackageSignals is enabled.
+    // nymead doesn't connect to this signal, it relies on the per-package ones.
+    void packagesChanged(const PackageChangeset &changeset);
+
+
+    // Result of an enableRepository() call, emitted once the batch it was part of has been applied.
+    // Plugin-internal: nymead doesn't know this signal and sees the outcome through repositoryChanged().
+    void repositoryChangeFinished(const QString &repositoryId, bool success, const QString &error);
+
 private slots:
     void refreshFromPackageKit();
+    void applyRepositoryChanges();
+    void refreshPackages(const QStringList &packageNames);
 
 private:
+    void refreshCache(bool force);
+    void scheduleCacheRefresh();
+
+    class UpdatePlan {
+    public:
+        QSet<QString> requestedNames;
+        QHash<QString, QString> resolvedIds; // <packageName, packageId>
+        QHash<QString, QString> updateIds; // <packageName, packageId>
+        int upgradeStep = -1;
+        // updateIds are known already, skip looking them up
+        bool fromSimulation = false;
+
+        // Retry state
+        int attempt = 1;
+        bool refreshMetadata = false;
+        QHash<QString, QString> upgradeIds; // <packageName, packageId>
+        QSet<QString> finishedNames;
+        QList<PackageKit::Transaction::Error> errors;
+    };
+    void executeUpdatePlan(QSharedPointer<UpdatePlan> plan);
+    void retryUpdate(QSharedPointer<UpdatePlan> plan);
+    PackageKit::Transaction *createUpgradeTransaction(TransactionGraph *graph, QSharedPointer<UpdatePlan> plan);
+    PackageKit::Transaction *createUpgradeBatch(TransactionGraph *graph, QSharedPointer<UpdatePlan> plan, const QStringList &packageIds);
+
+    class UpdateInfo {
+    public:
+        QString packageId;
+        QString version;
+        QString summary;
+    };
+    class RefreshState {
+    public:
+        QHash<QString, Package> packages;
+        QHash<QString, UpdateInfo> updates; // <packageName, update>
+        QList<Repository> repositories;
+    };
+    void applyRepositories(const QList<Repository> &repositories);
+    void updateVirtualRepositories();
+    void collectPackage(RefreshState *state, PackageKit::Transaction::Info info, const QString &packageID, const QString &summary);
+
+    void stageUpdates();
+    bool startOfflineUpdate(const QStringList &packageNames);
+    void prepareOfflineUpdate(const QStringList &packageIds, bool trigger);
+    void triggerOfflineUpdate();
+    bool offlineUpdatePrepared(const QStringList &packageIds) const;
+    void simulateUpdates();
+    void fetchChangelogs();
+    void applyChangelog(const QString &packageName, const QVariantMap &details, PackageChangeset *changeset);
+    bool simulatedUpdateCurrent() const;
+    PackageKit::Transaction *createBackgroundTransaction(const std::function<PackageKit::Transaction*()> &factory);
+
     void trackTransaction(PackageKit::Transaction* transaction);
     void trackUpdateTransaction(PackageKit::Transaction* transaction);
+    void emitChangeset(const PackageChangeset &changeset);
+    void instrumentGraph(TransactionGraph *graph);
+    void trackProgress(TransactionGraph *graph, const QString &mainStep);
+    void gateGraph(TransactionGraph *graph, const QString &mainStep, const std::function<bool()> &hasWork);
+    void resumeHeldGraph();
+    void notifyUpdateRunning();
+    void exportDiagnosticsIfIdle();
 
+    void loadSettings();
+    void loadSnapshot();
+    void readNativePackages();
+    void saveSnapshot();
     void readDistro();
-    bool addRepoManually(const QString &repo);
+    bool setVirtualSource(const QString &repo, bool enabled, QString *error);
+    bool refreshRepositorySources();
 
 private:
     bool m_available = false;
-    QHash<QString, Package> m_packages;
-    QHash<QString, Repository> m_repositories;
+    PackageStore m_packageStore;
+    RepositoryStore m_repositories;
+    // Which repositories are offered as channels, e.g. Testing and Experimental
+    RepositoryChannelMatcher m_channelMatcher;
+    // The sources file virtual repositories are added to
+    RepositoryFileManager *m_repositoryFiles = nullptr;
+    bool m_targetedRepositoryRefresh = true;
+
+    // enableRepository() calls waiting to be applied, <repositoryId, enabled>
+    QHash<QString, bool> m_pendingRepositoryChanges;
+    QTimer *m_repositoryBatchTimer = nullptr;
+    bool m_repositoryBatchRunning = false;
 
     // Used to set the busy flag
     QList<PackageKit::Transaction*> m_runningTransactions;
     // Used to set the updateRunning flag
     QList<PackageKit::Transaction*> m_updateTransactions;
-
-    // libpackagekitqt5 < 1.0 has a bug and emits the finished singal twice on getPackages.
-    // We need to make sure we only handle it once. Could probably go away when everyone is upgraded
-    // to libpackagekitqt5 >= 1.0.
-    QList<PackageKit::Transaction*> m_unfinishedTransactions;
+    // Updates and removals held back by the update scheduler, resumed one at a time
+    QList<TransactionGraph*> m_heldGraphs;
+    // Last updateRunning state announced with updateRunningChanged()
+    bool m_updateRunning = false;
 
     QTimer *m_refreshTimer = nullptr;
+    CacheRefreshPolicy m_cacheRefreshPolicy;
+    // Set when the cache has been refreshed and the following package refresh should feed back into the policy.
+    // Only a refresh started after the cache refresh finished (a later scheduler generation) sees the new metadata.
+    bool m_cacheRefreshPending = false;
+    quint64 m_cacheRefreshGeneration = 0;
+
+    RefreshScheduler *m_refreshScheduler = nullptr;
+
+    TransactionRegistry *m_transactionRegistry = nullptr;
+    // If set, metrics are exported whenever all transactions are done
+    QString m_metricsExportFileName;
+
+    UpdateTracer *m_tracer = nullptr;
+    UpdateProgress *m_updateProgress = nullptr;
+    UpdateScheduler *m_updateScheduler = nullptr;
+    UpdateRetryPolicy m_retryPolicy;
+    QTimer *m_retryTimer = nullptr;
+    QSharedPointer<UpdatePlan> m_retryPlan;
+    QString m_traceFileName;
+
+    // Which packages we manage and whether we let PackageKit filter them (searchNames)
+    // or enumerate the entire package universe (getPackages) as older versions did.
+    PackageNameFilter m_nameFilter;
+    bool m_filteredQuery = true;
+    bool m_perPackageSignals = true;
+
+    // Versioned package IDs of the available updates as of the last refresh
+    QHash<QString, QString> m_updateIds; // <packageName, packageId>
+
+    // Download-only staging of updates in the background
+    bool m_stagingEnabled = false;
+    QPointer<PackageKit::Transaction> m_stagingTransaction;
+    bool m_offlineUpdatesEnabled = false;
+    QPointer<PackageKit::Transaction> m_offlinePrepareTransaction;
+    QSet<QString> m_offlinePreparingIds;
+    // Replaces the running preparation once it's cancelled
+    QStringList m_offlineQueuedIds;
+    bool m_offlineTriggerPending = false;
+    QSet<QString> m_stagedPackageIds;
+
+    // Simulated update of all managed packages, rerun after every refresh. startUpdate() reuses its package set.
+    bool m_simulationEnabled = true;
+    bool m_simulationRunning = false;
+    SimulatedUpdate m_simulatedUpdate;
+
+    // Refreshes only the packages changed by dpkg runs outside of PackageKit
+    bool m_dpkgWatcherEnabled = true;
+    bool m_nativeReaderEnabled = false;
+    DpkgStatusWatcher *m_dpkgStatusWatcher = nullptr;
+    // Set when the watcher reported packages changed outside of PackageKit, until PackageKit's notification about it
+    bool m_watcherChangePending = false;
+
+    // Details of the updates, for their changelogs
+    PackageDetailsCache *m_packageDetails = nullptr;
+
+    // Last known state, persisted after every successful refresh which changed it and loaded at startup
+    QString m_snapshotFileName;
+    quint64 m_snapshotPackageGeneration = 0;
+    quint64 m_snapshotRepositoryGeneration = 0;
 
     QString m_distro;
     QString m_component;
@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "updateprogress.h"
+#include "transactionregistry.h"
+
+UpdateProgress::UpdateProgress(QObject *parent):
+    QObject(parent)
+{
+    m_rateTimer = new QTimer(this);
+    m_rateTimer->setSingleShot(true);
+    m_rateTimer->setInterval(500);
+    connect(m_rateTimer, &QTimer::timeout, this, &UpdateProgress::flush);
+}
+
+int UpdateProgress::maximumRate() const
+{
+    return 1000 / m_rateTimer->interval();
+}
+
+void UpdateProgress::setMaximumRate(int maximumRate)
+{
+    m_rateTimer->setInterval(1000 / qBound(1, maximumRate, 1000));
+}
+
+int UpdateProgress::start(const QString &operation)
+{
+    Operation entry;
+    entry.name = operation;
+    entry.active = true;
+    entry.phase = "Planning";
+    int id = m_nextOperation++;
+    m_operations.insert(id, entry);
+    notify();
+    return id;
+}
+
+void UpdateProgress::attach(int operation, PackageKit::Transaction *transaction, int from, int to)
+{
+    connect(transaction, &PackageKit::Transaction::percentageChanged, this, [this, operation, transaction, from, to](){
+        update(operation, transaction, from, to);
+    });
+    connect(transaction, &PackageKit::Transaction::statusChanged, this, [this, operation, transaction, from, to](){
+        update(operation, transaction, from, to);
+    });
+    connect(transaction, &PackageKit::Transaction::speedChanged, this, [this, operation, transaction, from, to](){
+        update(operation, transaction, from, to);
+    });
+    connect(transaction, &PackageKit::Transaction::downloadSizeRemainingChanged, this, [this, operation, transaction, from, to](){
+        update(operation, transaction, from, to);
+    });
+}
+
+void UpdateProgress::finish(int operation, bool success)
+{
+    if (!m_operations.contains(operation)) {
+        return;
+    }
+    Operation entry = m_operations.take(operation);
+    entry.active = false;
+    if (success) {
+        entry.percentage = 100;
+    }
+    entry.phase = success ? "Finished" : "Failed";
+    entry.bytesRemaining = 0;
+    entry.speed = 0;
+    m_lastFinished = entry;
+
+    // The final state is always delivered right away
+    m_rateTimer->stop();
+    m_dirty = false;
+    emit progressChanged();
+    m_rateTimer->start();
+}
+
+bool UpdateProgress::active() const
+{
+    return !m_operations.isEmpty();
+}
+
+QVariantMap UpdateProgress::toVariantMap() const
+{
+    if (m_operations.isEmpty()) {
+        return m_lastFinished.toVariantMap();
+    }
+    QVariantMap map = m_operations.first().toVariantMap();
+    if (m_operations.count() > 1) {
+        QVariantList operations;
+        foreach (const Operation &operation, m_operations) {
+            operations.append(operation.toVariantMap());
+        }
+        map.insert("operations", operations);
+    }
+    return map;
+}
+
+QVariantMap UpdateProgress::Operation::toVariantMap() const
+{
+    QVariantMap map;
+    map.insert("active", active);
+    map.insert("operation", name);
+    map.insert("percentage", percentage);
+    map.insert("phase", phase);
+    map.insert("bytesRemaining", bytesRemaining);
+    map.insert("speed", speed);
+    return map;
+}
+
+void UpdateProgress::flush()
+{
+    if (!m_dirty) {
+        return;
+    }
+    m_dirty = false;
+    emit progressChanged();
+    m_rateTimer->start();
+}
+
+void UpdateProgress::update(int operation, PackageKit::Transaction *transaction, int from, int to)
+{
+    QMap<int, Operation>::iterator entry = m_operations.find(operation);
+    if (entry == m_operations.end()) {
+        return;
+    }
+
+    // PackageKit reports 101 if the percentage is unknown
+    uint percentage = transaction->percentage();
+    if (percentage <= 100) {
+        // Concurrent transactions and restarting backends must not make the overall progress go backwards
+        entry->percentage = qMax(entry->percentage, from + static_cast<int>((to - from) * percentage / 100));
+    }
+    entry->phase = TransactionRegistry::enumToString("Status", transaction->status());
+    entry->speed = transaction->speed();
+    entry->bytesRemaining = transaction->downloadSizeRemaining();
+    notify();
+}
+
+void UpdateProgress::notify()
+{
+    if (m_rateTimer->isActive()) {
+        m_dirty = true;
+        return;
+    }
+    m_dirty = false;
+    emit progressChanged();
+    m_rateTimer->start();
+}
@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef UPDATEPROGRESS_H
+#define UPDATEPROGRESS_H
+
+#include <QMap>
+#include <QObject>
+#include <QTimer>
+#include <QVariantMap>
+
+#include <Transaction>
+
+// Aggregates the progress of all transactions of an update or removal pipeline into one stream.
+//
+// Every pipeline is an operation of its own, so an update and a removal running at the same time
+// don't reset or finish each other. Each attached transaction covers a range of the operation's
+// percentage. Changes are coalesced and progressChanged() is emitted at most maximumRate times per
+// second for all operations together, no matter how often the backend reports progress.
+class UpdateProgress : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UpdateProgress(QObject *parent = nullptr);
+
+    int maximumRate() const;
+    void setMaximumRate(int maximumRate);
+
+    // Returns the ID of the new operation
+    int start(const QString &operation);
+    void attach(int operation, PackageKit::Transaction *transaction, int from, int to);
+    void finish(int operation, bool success);
+
+    // Whether any operation is running
+    bool active() const;
+
+    // The oldest running operation, or the last finished one if none is running. If several
+    // operations are running, all of them are listed in "operations".
+    QVariantMap toVariantMap() const;
+
+signals:
+    void progressChanged();
+
+private slots:
+    void flush();
+
+private:
+    class Operation {
+    public:
+        QString name;
+        bool active = false;
+        int percentage = 0;
+        QString phase;
+        qulonglong bytesRemaining = 0;
+        uint speed = 0; // bytes per second
+
+        QVariantMap toVariantMap() const;
+    };
+
+    void update(int operation, PackageKit::Transaction *transaction, int from, int to);
+    void notify();
+
+    QTimer *m_rateTimer = nullptr;
+    bool m_dirty = false;
+
+    int m_nextOperation = 1;
+    QMap<int, Operation> m_operations; // Running ones, by ID and thus in start order
+    Operation m_lastFinished;
+};
+
+#endif // UPDATEPROGRESS_H
@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "updateretrypolicy.h"
+
+#include <QRandomGenerator>
+#include <QSettings>
+
+void UpdateRetryPolicy::load(QSettings &settings)
+{
+    settings.beginGroup("Retry");
+    m_maximumAttempts = qMax(1, settings.value("maximumAttempts", m_maximumAttempts).toInt());
+    m_initialDelay = qMax<qint64>(1, settings.value("initialDelay", m_initialDelay).toLongLong());
+    m_maximumDelay = qMax(m_initialDelay, settings.value("maximumDelay", m_maximumDelay).toLongLong());
+    m_jitter = qBound(0.0, settings.value("jitter", m_jitter).toDouble(), 1.0);
+    settings.endGroup();
+}
+
+UpdateRetryPolicy::ErrorClass UpdateRetryPolicy::classify(PackageKit::Transaction::Error error)
+{
+    switch (error) {
+    case PackageKit::Transaction::ErrorNoNetwork:
+    case PackageKit::Transaction::ErrorRepoNotAvailable:
+    case PackageKit::Transaction::ErrorNoMoreMirrorsToTry:
+    case PackageKit::Transaction::ErrorCannotGetLock:
+    case PackageKit::Transaction::ErrorLockRequired:
+    case PackageKit::Transaction::ErrorCancelledPriority:
+        return ErrorClassTransient;
+    case PackageKit::Transaction::ErrorPackageDownloadFailed:
+    case PackageKit::Transaction::ErrorPackageNotFound:
+    case PackageKit::Transaction::ErrorUpdateNotFound:
+    case PackageKit::Transaction::ErrorPackageCorrupt:
+    case PackageKit::Transaction::ErrorPackageDatabaseChanged:
+    case PackageKit::Transaction::ErrorNoCache:
+    case PackageKit::Transaction::ErrorCannotFetchSources:
+        // A mirror in the middle of a sync, or packages superseded since our last refresh
+        return ErrorClassStaleMetadata;
+    default:
+        return ErrorClassPermanent;
+    }
+}
+
+int UpdateRetryPolicy::maximumAttempts() const
+{
+    return m_maximumAttempts;
+}
+
+qint64 UpdateRetryPolicy::delay(int retry) const
+{
+    qint64 delay = m_initialDelay;
+    for (int i = 1; i < retry && delay < m_maximumDelay; i++) {
+        delay *= 2;
+    }
+    delay = qMin(delay, m_maximumDelay);
+    double jitter = (QRandomGenerator::global()->generateDouble() * 2 - 1) * m_jitter;
+    return qMax<qint64>(1000, delay * 1000 * (1 + jitter));
+}
@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef UPDATERETRYPOLICY_H
+#define UPDATERETRYPOLICY_H
+
+#include <QtGlobal>
+
+#include <Transaction>
+
+class QSettings;
+
+// Decides whether and when a failed update is retried.
+//
+// Errors are transient (network, mirrors, locks), caused by stale metadata (packages vanished
+// from or changed on the mirror) or permanent (dependencies, disk space, signatures...). Only the
+// first two are retried, with exponential backoff plus random jitter. Stale metadata is refreshed
+// before the retry.
+class UpdateRetryPolicy
+{
+public:
+    enum ErrorClass {
+        ErrorClassTransient,
+        ErrorClassStaleMetadata,
+        ErrorClassPermanent
+    };
+
+    void load(QSettings &settings);
+
+    static ErrorClass classify(PackageKit::Transaction::Error error);
+
+    int maximumAttempts() const;
+    // ms to wait before the given retry, 1 being the first one
+    qint64 delay(int retry) const;
+
+private:
+    int m_maximumAttempts = 3;
+    qint64 m_initialDelay = 30;
+    qint64 m_maximumDelay = 10 * 60;
+    double m_jitter = 0.2;
+};
+
+#endif // UPDATERETRYPOLICY_H
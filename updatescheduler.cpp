@@ -0,0 +1,233 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "updatescheduler.h"
+
+#include <QFile>
+#include <QSettings>
+#include <QStringList>
+#include <QThread>
+#include <QTime>
+
+#include "loggingcategories.h"
+
+UpdateScheduler::UpdateScheduler(QObject *parent):
+    QObject(parent)
+{
+    m_pollTimer = new QTimer(this);
+    m_pollTimer->setInterval(15000);
+    connect(m_pollTimer, &QTimer::timeout, this, &UpdateScheduler::poll);
+}
+
+void UpdateScheduler::load(QSettings &settings)
+{
+    settings.beginGroup("UpdateScheduler");
+    m_windows.clear();
+    foreach (const QString &window, settings.value("maintenanceWindows").toStringList()) {
+        QTime start = QTime::fromString(window.section('-', 0, 0).trimmed(), "hh:mm");
+        QTime end = QTime::fromString(window.section('-', 1, 1).trimmed(), "hh:mm");
+        if (!start.isValid() || !end.isValid()) {
+            qCWarning(dcPlatformUpdate()) << "Ignoring invalid maintenance window" << window << "(expected hh:mm-hh:mm)";
+            continue;
+        }
+        Window w;
+        w.start = start.hour() * 60 + start.minute();
+        w.end = end.hour() * 60 + end.minute();
+        m_windows.append(w);
+    }
+    m_cpuPressureThreshold = settings.value("cpuPressureThreshold", m_cpuPressureThreshold).toDouble();
+    m_ioPressureThreshold = settings.value("ioPressureThreshold", m_ioPressureThreshold).toDouble();
+    m_loadThreshold = settings.value("loadThreshold", m_loadThreshold).toDouble();
+    m_maximumDeferral = settings.value("maximumDeferral", m_maximumDeferral).toInt();
+    m_lowPriority = settings.value("lowPriority", m_lowPriority).toBool();
+    m_batchSize = qMax(0, settings.value("batchSize", m_batchSize).toInt());
+    m_pollTimer->setInterval(qMax(1, settings.value("pollInterval", 15).toInt()) * 1000);
+    settings.endGroup();
+}
+
+bool UpdateScheduler::lowPriority() const
+{
+    return m_lowPriority;
+}
+
+int UpdateScheduler::batchSize() const
+{
+    return m_batchSize;
+}
+
+bool UpdateScheduler::inMaintenanceWindow(const QDateTime &time) const
+{
+    if (m_windows.isEmpty()) {
+        return true;
+    }
+    int minute = time.time().hour() * 60 + time.time().minute();
+    foreach (const Window &window, m_windows) {
+        if (window.start < window.end) {
+            if (minute >= window.start && minute < window.end) {
+                return true;
+            }
+        } else if (minute >= window.start || minute < window.end) {
+            // Spans midnight, or the whole day if start == end
+            return true;
+        }
+    }
+    return false;
+}
+
+bool UpdateScheduler::requestStart()
+{
+    QString reason = blockingReason();
+    if (reason.isEmpty()) {
+        m_pollTimer->stop();
+        m_pressureWait.invalidate();
+        setWaitReason(QString());
+        return true;
+    }
+    if (!m_pollTimer->isActive()) {
+        qCDebug(dcPlatformUpdate()) << "Holding back update:" << reason;
+        m_pollTimer->start();
+    }
+    setWaitReason(reason);
+    return false;
+}
+
+bool UpdateScheduler::waiting() const
+{
+    return !m_waitReason.isEmpty();
+}
+
+QString UpdateScheduler::waitReason() const
+{
+    return m_waitReason;
+}
+
+QVariantMap UpdateScheduler::status() const
+{
+    QVariantMap status;
+    status.insert("waiting", waiting());
+    status.insert("waitReason", m_waitReason);
+    status.insert("inMaintenanceWindow", inMaintenanceWindow(QDateTime::currentDateTime()));
+    status.insert("cpuPressure", readPressure("/proc/pressure/cpu"));
+    status.insert("ioPressure", readPressure("/proc/pressure/io"));
+    status.insert("loadPerCpu", readLoadPerCpu());
+    status.insert("lowPriority", m_lowPriority);
+    status.insert("batchSize", m_batchSize);
+    return status;
+}
+
+QString UpdateScheduler::blockingReason()
+{
+    if (!inMaintenanceWindow(QDateTime::currentDateTime())) {
+        return "Outside of maintenance window";
+    }
+
+    QString reason;
+    if (!pressureBlocking(&reason)) {
+        return QString();
+    }
+    if (!m_pressureWait.isValid()) {
+        m_pressureWait.start();
+    } else if (m_pressureWait.elapsed() > m_maximumDeferral * 1000LL) {
+        qCDebug(dcPlatformUpdate()) << "Held back update for" << m_maximumDeferral << "seconds already. Starting despite" << reason;
+        return QString();
+    }
+    return reason;
+}
+
+bool UpdateScheduler::pressureBlocking(QString *reason) const
+{
+    if (m_cpuPressureThreshold > 0) {
+        double pressure = readPressure("/proc/pressure/cpu");
+        if (pressure > m_cpuPressureThreshold) {
+            *reason = QString("CPU pressure %1% above %2%").arg(pressure).arg(m_cpuPressureThreshold);
+            return true;
+        }
+    }
+    if (m_ioPressureThreshold > 0) {
+        double pressure = readPressure("/proc/pressure/io");
+        if (pressure > m_ioPressureThreshold) {
+            *reason = QString("I/O pressure %1% above %2%").arg(pressure).arg(m_ioPressureThreshold);
+            return true;
+        }
+    }
+    if (m_loadThreshold > 0) {
+        double load = readLoadPerCpu();
+        if (load > m_loadThreshold) {
+            *reason = QString("Load per CPU %1 above %2").arg(load).arg(m_loadThreshold);
+            return true;
+        }
+    }
+    return false;
+}
+
+void UpdateScheduler::poll()
+{
+    QString reason = blockingReason();
+    if (!reason.isEmpty()) {
+        setWaitReason(reason);
+        return;
+    }
+    qCDebug(dcPlatformUpdate()) << "Resuming update";
+    m_pollTimer->stop();
+    m_pressureWait.invalidate();
+    setWaitReason(QString());
+    emit ready();
+}
+
+void UpdateScheduler::setWaitReason(const QString &reason)
+{
+    if (m_waitReason != reason) {
+        m_waitReason = reason;
+        emit waitingChanged();
+    }
+}
+
+double UpdateScheduler::readPressure(const QString &fileName)
+{
+    // some avg10=1.23 avg60=0.50 avg300=0.10 total=123456
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) {
+        return -1;
+    }
+    QByteArray line = file.readLine();
+    if (!line.startsWith("some ")) {
+        return -1;
+    }
+    foreach (const QByteArray &field, line.simplified().split(' ')) {
+        if (field.startsWith("avg10=")) {
+            return field.mid(6).toDouble();
+        }
+    }
+    return -1;
+}
+
+double UpdateScheduler::readLoadPerCpu()
+{
+    QFile file("/proc/loadavg");
+    if (!file.open(QFile::ReadOnly)) {
+        return -1;
+    }
+    return file.readLine().split(' ').value(0).toDouble() / qMax(1, QThread::idealThreadCount());
+}
@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef UPDATESCHEDULER_H
+#define UPDATESCHEDULER_H
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+#include <QVariantMap>
+
+class QSettings;
+
+// Decides when the install steps of an update may run, so they don't compete with nymea's
+// automation engine for CPU and I/O.
+//
+// Steps only start within the configured maintenance windows and while the CPU and I/O pressure
+// (PSI, /proc/pressure) and the load stay below their thresholds, if any are configured. Pressure
+// can only delay a step for maximumDeferral seconds, after that it starts anyway. PackageKit can't
+// pause a running transaction, so large update sets can be split into batches which are gated
+// individually.
+class UpdateScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UpdateScheduler(QObject *parent = nullptr);
+
+    void load(QSettings &settings);
+
+    // Run update transactions with low CPU and I/O priority
+    bool lowPriority() const;
+    // Maximum number of packages per upgrade transaction, 0 for no batching
+    int batchSize() const;
+
+    bool inMaintenanceWindow(const QDateTime &time) const;
+
+    // Returns true if a step may start now. Otherwise ready() is emitted once it may.
+    bool requestStart();
+
+    bool waiting() const;
+    QString waitReason() const;
+    QVariantMap status() const;
+
+signals:
+    void ready();
+    void waitingChanged();
+
+private:
+    class Window {
+    public:
+        int start = 0; // minutes since midnight
+        int end = 0;
+    };
+
+    QString blockingReason();
+    bool pressureBlocking(QString *reason) const;
+    void poll();
+    void setWaitReason(const QString &reason);
+
+    // "some avg10" of a PSI file, -1 if the kernel doesn't provide it
+    static double readPressure(const QString &fileName);
+    static double readLoadPerCpu();
+
+    QList<Window> m_windows;
+    double m_cpuPressureThreshold = 0;
+    double m_ioPressureThreshold = 0;
+    double m_loadThreshold = 0;
+    int m_maximumDeferral = 30 * 60;
+    bool m_lowPriority = false;
+    int m_batchSize = 0;
+
+    QTimer *m_pollTimer = nullptr;
+    QElapsedTimer m_pressureWait;
+    QString m_waitReason;
+};
+
+#endif // UPDATESCHEDULER_H
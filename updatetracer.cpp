@@ -0,0 +1,211 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "updatetracer.h"
+#include "transactionregistry.h"
+#include "loggingcategories.h"
+
+#include <QCoreApplication>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QSharedPointer>
+
+UpdateTracer::UpdateTracer(QObject *parent):
+    QObject(parent)
+{
+    m_clock.start();
+}
+
+bool UpdateTracer::enabled() const
+{
+    return m_enabled;
+}
+
+void UpdateTracer::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+    if (!m_enabled) {
+        m_buffer.clear();
+        m_openSpans.clear();
+        m_next = 0;
+    }
+}
+
+int UpdateTracer::capacity() const
+{
+    return m_capacity;
+}
+
+void UpdateTracer::setCapacity(int capacity)
+{
+    m_capacity = qMax(1, capacity);
+    m_buffer.clear();
+    m_next = 0;
+}
+
+quint64 UpdateTracer::beginSpan(const QString &name, const QString &category, const QVariantMap &args)
+{
+    if (!m_enabled) {
+        return 0;
+    }
+    Event event;
+    event.name = name;
+    event.category = category;
+    event.start = m_clock.nsecsElapsed() / 1000;
+    event.args = args;
+    quint64 span = m_nextSpan++;
+    m_openSpans.insert(span, event);
+    return span;
+}
+
+void UpdateTracer::endSpan(quint64 span, const QVariantMap &args)
+{
+    if (!m_openSpans.contains(span)) {
+        return;
+    }
+    Event event = m_openSpans.take(span);
+    event.duration = m_clock.nsecsElapsed() / 1000 - event.start;
+    for (QVariantMap::const_iterator it = args.constBegin(); it != args.constEnd(); ++it) {
+        event.args.insert(it.key(), it.value());
+    }
+    record(event);
+}
+
+void UpdateTracer::traceTransaction(PackageKit::Transaction *transaction, const QString &name, const QString &category)
+{
+    if (!m_enabled) {
+        return;
+    }
+
+    quint64 span = beginSpan(name, category);
+    QSharedPointer<quint64> phaseSpan(new quint64(0));
+    QSharedPointer<int> lastStatus(new int(-1));
+
+    connect(transaction, &PackageKit::Transaction::statusChanged, this, [this, transaction, category, phaseSpan, lastStatus](){
+        int status = transaction->status();
+        if (status == *lastStatus) {
+            return;
+        }
+        *lastStatus = status;
+        endSpan(*phaseSpan);
+        *phaseSpan = beginSpan(TransactionRegistry::enumToString("Status", status), category);
+    });
+    connect(transaction, &PackageKit::Transaction::errorCode, this, [this, span](PackageKit::Transaction::Error error, const QString &details){
+        if (m_openSpans.contains(span)) {
+            m_openSpans[span].args.insert("error", QString("%1: %2").arg(TransactionRegistry::enumToString("Error", error)).arg(details));
+        }
+    });
+    connect(transaction, &PackageKit::Transaction::finished, this, [this, span, phaseSpan](PackageKit::Transaction::Exit status){
+        endSpan(*phaseSpan);
+        *phaseSpan = 0;
+        QVariantMap args;
+        args.insert("exit", TransactionRegistry::enumToString("Exit", status));
+        endSpan(span, args);
+    });
+}
+
+QByteArray UpdateTracer::toJson() const
+{
+    QVariantList traceEvents;
+
+    // Oldest first. Once the ring buffer wrapped, the oldest entry is the one to be overwritten next.
+    int count = m_buffer.count();
+    int first = count < m_capacity ? 0 : m_next;
+    for (int i = 0; i < count; i++) {
+        traceEvents.append(toTraceEvent(m_buffer.at((first + i) % count)));
+    }
+
+    // Spans still running are exported up to now
+    qint64 now = m_clock.nsecsElapsed() / 1000;
+    foreach (const Event &openEvent, m_openSpans) {
+        Event event = openEvent;
+        event.duration = now - event.start;
+        event.args.insert("unfinished", true);
+        traceEvents.append(toTraceEvent(event));
+    }
+
+    // Name the tracks after their categories
+    foreach (const QString &category, m_tracks.keys()) {
+        QVariantMap metadata;
+        metadata.insert("name", "thread_name");
+        metadata.insert("ph", "M");
+        metadata.insert("pid", QCoreApplication::applicationPid());
+        metadata.insert("tid", m_tracks.value(category));
+        QVariantMap args;
+        args.insert("name", category);
+        metadata.insert("args", args);
+        traceEvents.append(metadata);
+    }
+
+    QVariantMap trace;
+    trace.insert("traceEvents", traceEvents);
+    trace.insert("displayTimeUnit", "ms");
+    return QJsonDocument::fromVariant(trace).toJson(QJsonDocument::Compact);
+}
+
+bool UpdateTracer::dump(const QString &fileName) const
+{
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly) || file.write(toJson()) < 0 || !file.commit()) {
+        qCWarning(dcPlatformUpdate()) << "Failed to dump update trace to" << fileName << ":" << file.errorString();
+        return false;
+    }
+    qCDebug(dcPlatformUpdate()) << "Update trace written to" << fileName;
+    return true;
+}
+
+void UpdateTracer::record(const Event &event)
+{
+    if (m_buffer.count() < m_capacity) {
+        m_buffer.append(event);
+    } else {
+        m_buffer[m_next] = event;
+    }
+    m_next = (m_next + 1) % m_capacity;
+}
+
+QVariantMap UpdateTracer::toTraceEvent(const Event &event) const
+{
+    QVariantMap traceEvent;
+    traceEvent.insert("name", event.name);
+    traceEvent.insert("cat", event.category);
+    traceEvent.insert("ph", "X");
+    traceEvent.insert("ts", event.start);
+    traceEvent.insert("dur", event.duration);
+    traceEvent.insert("pid", QCoreApplication::applicationPid());
+    traceEvent.insert("tid", track(event.category));
+    if (!event.args.isEmpty()) {
+        traceEvent.insert("args", event.args);
+    }
+    return traceEvent;
+}
+
+int UpdateTracer::track(const QString &category) const
+{
+    if (!m_tracks.contains(category)) {
+        m_tracks.insert(category, m_tracks.count() + 1);
+    }
+    return m_tracks.value(category);
+}
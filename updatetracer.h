@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright (C) 2013 - 2024, nymea GmbH
+* Copyright (C) 2024 - 2025, chargebyte austria GmbH
+*
+* This file is part of nymea-update-plugin-packagekit.
+*
+* nymea-update-plugin-packagekit is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* nymea-update-plugin-packagekit is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with nymea-update-plugin-packagekit. If not, see <https://www.gnu.org/licenses/>.
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef UPDATETRACER_H
+#define UPDATETRACER_H
+
+#include <QObject>
+#include <QHash>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QVariantMap>
+
+#include <Transaction>
+
+// Opt-in tracing of the update pipeline.
+//
+// Spans are kept in a bounded ring buffer and can be dumped in the Chrome trace event format,
+// which can be loaded into chrome://tracing or ui.perfetto.dev. Each category is put on its own
+// track so concurrent transactions show up next to each other.
+class UpdateTracer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UpdateTracer(QObject *parent = nullptr);
+
+    bool enabled() const;
+    void setEnabled(bool enabled);
+
+    int capacity() const;
+    void setCapacity(int capacity);
+
+    // Returns 0 if tracing is disabled. Ending span 0 is a no-op.
+    quint64 beginSpan(const QString &name, const QString &category, const QVariantMap &args = QVariantMap());
+    void endSpan(quint64 span, const QVariantMap &args = QVariantMap());
+
+    // Traces the transaction as a whole and each of its status phases (e.g. download, install) as child spans
+    void traceTransaction(PackageKit::Transaction *transaction, const QString &name, const QString &category);
+
+    QByteArray toJson() const;
+    bool dump(const QString &fileName) const;
+
+private:
+    class Event {
+    public:
+        QString name;
+        QString category;
+        qint64 start = 0; // µs
+        qint64 duration = -1; // µs, -1 while open
+        QVariantMap args;
+    };
+
+    void record(const Event &event);
+    QVariantMap toTraceEvent(const Event &event) const;
+    int track(const QString &category) const;
+
+    bool m_enabled = false;
+    QElapsedTimer m_clock;
+    QVector<Event> m_buffer;
+    int m_capacity = 4096;
+    int m_next = 0;
+
+    quint64 m_nextSpan = 1;
+    QHash<quint64, Event> m_openSpans;
+    mutable QHash<QString, int> m_tracks;
+};
+
+#endif // UPDATETRACER_H